@@ -0,0 +1,95 @@
+/*
+** arena.c
+**
+** growable memory arena implementations. See arena.h
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include "arena.h"
+
+static int arena_memlock = 0; /* bool */
+
+
+static inline size_t pageround(size_t size)
+{
+    size_t pagesize = (size_t) sysconf(_SC_PAGESIZE);
+
+    return (size + pagesize - 1) & ~(pagesize - 1);
+}
+
+
+int arena_init(struct arena * ap, size_t reserve)
+{
+    void * p;
+
+    ap->reserved = pageround(reserve ? reserve : 1);
+    ap->committed = 0;
+    /* PROT_NONE + MAP_NORESERVE: address space only, not accounted as memory */
+    p = mmap(NULL, ap->reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if( MAP_FAILED == p){
+        ap->base = NULL;
+        ap->reserved = 0;
+        return -1;
+    }
+    ap->base = (char *) p;
+    return 0;
+}
+
+
+int arena_free(struct arena * ap)
+{
+    if( NULL != ap->base){
+        munmap(ap->base, ap->reserved);
+    }
+    ap->base = NULL;
+    ap->reserved = 0;
+    ap->committed = 0;
+    return 0;
+}
+
+
+int arena_commit(struct arena * ap, size_t size)
+{
+    size_t newcommitted;
+
+    if( size <= ap->committed){
+        return 0;
+    }
+    newcommitted = pageround(size);
+    if( newcommitted > ap->reserved){
+        return -1;
+    }
+    if( 0 != mprotect(ap->base + ap->committed, newcommitted - ap->committed, PROT_READ | PROT_WRITE)){
+        return -1;
+    }
+    if( arena_memlock){
+        /* lock and prefault now, not at the first touch in the receiver */
+        if( 0 != mlock(ap->base + ap->committed, newcommitted - ap->committed)){
+            return -1;
+        }
+    }
+    ap->committed = newcommitted;
+    return 0;
+}
+
+
+void arena_setmemlock(int memlock)
+{
+    arena_memlock = memlock;
+}
@@ -0,0 +1,59 @@
+/*
+** arena.h
+**
+** growable memory arena definitions
+**
+**  An arena reserves a large address range at init (no memory is used for it),
+**  and commits (makes usable) its beginning step by step. The base address never changes,
+**  so pointers and indexes into the arena remain valid while it grows.
+**  Committed memory is zero filled. If memlock is switched on (after mlockall()), the newly
+**  committed pages are locked and prefaulted too, so they are as safe as the ones locked at startup.
+**
+** NOT multithrad safe. The caller must serialize commit() calls of the same arena.
+**
+**  functions:
+**      - init       the constructor: reserves the address range
+**      - free       the destructor
+**      - commit     make the first 'size' bytes usable. No error if already committed.
+**      - setmemlock global switch: lock the pages of the later commits.
+**  attributes:
+**      - base       the first byte of the arena
+**      - reserved   the maximal size
+**      - committed  the usable size
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <stdlib.h>
+
+struct arena {
+    char * base;
+    size_t reserved;
+    size_t committed;
+};
+
+
+int arena_init(struct arena * ap, size_t reserve);
+int arena_free(struct arena * ap);
+int arena_commit(struct arena * ap, size_t size);
+void arena_setmemlock(int memlock);
+
+#endif /* __ARENA_H */
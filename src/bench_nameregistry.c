@@ -0,0 +1,182 @@
+/*
+** bench_nameregistry.c
+**
+**  nameregistry contention benchmark: lookup throughput of concurrent readers while
+**  a churn thread removes and adds names continuously (like timetoforget and new clients do).
+**  Two modes: "locked" wraps every operation in one global mutex (the old packet path with
+**  global_addremove_lock), "lockfree" uses the lock-free find as the server does.
+**  Also checks that every lookup of a stable name returns its own ID.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "nameregistry.h"
+
+#define NAMELEN 192 /* hostname + text, like in the server */
+
+static struct nameregistry nr;
+static pthread_mutex_t biglock = PTHREAD_MUTEX_INITIALIZER;
+static int locked;        /* bool: mode */
+static volatile int stop; /* bool */
+static size_t stablenum;  /* names 0 <= i < stablenum are never removed */
+static char * names;      /* stablenum * 2 names */
+static int * ids;         /* ID of the stable names */
+static unsigned long errors;
+
+
+static void makename(char * name, size_t i)
+{
+    memset(name, 0, NAMELEN);
+    snprintf(name, NAMELEN, "host%lu.example.com", i);
+    snprintf(name + 64, NAMELEN - 64, "/var/lib/fslatency%lu", i);
+}
+
+
+static double now_sec(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+
+static void * reader(void * arg)
+{
+    unsigned long * count = (unsigned long *) arg;
+    unsigned int seed = (unsigned int)(size_t) count;
+    size_t i;
+    int id;
+
+    while( !stop){
+        i = rand_r(&seed) % stablenum;
+        if( locked){
+            pthread_mutex_lock(&biglock);
+        }
+        id = nameregistry_find(&nr, names + i * NAMELEN);
+        if( locked){
+            pthread_mutex_unlock(&biglock);
+        }
+        if( id != ids[i]){
+            __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+        }
+        (*count) ++;
+    }
+    return NULL;
+}
+
+
+static void * churner(void * arg)
+{
+    unsigned long * count = (unsigned long *) arg;
+    size_t i = 0;
+
+    while( !stop){
+        /* the churning names: stablenum <= X < 2*stablenum, half of them registered */
+        if( locked){
+            pthread_mutex_lock(&biglock);
+        }
+        nameregistry_remove(&nr, names + (stablenum + i) * NAMELEN);
+        nameregistry_add(&nr, names + (stablenum + (i + stablenum / 2) % stablenum) * NAMELEN);
+        if( locked){
+            pthread_mutex_unlock(&biglock);
+        }
+        i = (i + 1) % stablenum;
+        (*count) ++;
+    }
+    return NULL;
+}
+
+
+static void run(int readers, double seconds)
+{
+    pthread_t threads[readers + 1];
+    unsigned long counts[readers + 1];
+    unsigned long total = 0;
+    double t0;
+    int i;
+
+    stop = 0;
+    errors = 0;
+    for( i=0; i <= readers; i++){
+        counts[i] = 0;
+        pthread_create(threads + i, NULL, i < readers ? &reader : &churner, counts + i);
+    }
+    t0 = now_sec();
+    while( now_sec() - t0 < seconds){
+        nanosleep(&(struct timespec){0, 10000000}, NULL);
+    }
+    stop = 1;
+    for( i=0; i <= readers; i++){
+        pthread_join(threads[i], NULL);
+    }
+    t0 = now_sec() - t0;
+    for( i=0; i < readers; i++){
+        total += counts[i];
+    }
+    printf("%-8s readers: %d  lookups: %8.3f M/s  churn: %8.3f k/s  errors: %lu\n",
+        locked ? "locked" : "lockfree", readers, total / t0 / 1e6, counts[readers] / t0 / 1e3, errors);
+}
+
+
+int main(int argc, char * argv[])
+{
+    int readers;
+    double seconds;
+    size_t i;
+
+    if( argc != 4){
+        puts("Incorrect number of parameters. Usage:");
+        puts("  bench_nameregistry  <client_number> <reader_threads> <seconds>");
+        return 2;
+    }
+    stablenum = atol(argv[1]);
+    readers = atoi(argv[2]);
+    seconds = atof(argv[3]);
+
+    names = (char *) malloc(stablenum * 2 * NAMELEN);
+    ids = (int *) malloc(stablenum * sizeof(int));
+    if( 0 != nameregistry_init(&nr, stablenum * 2, NAMELEN)){
+        puts("Error: cannot init the registry");
+        return 2;
+    }
+    for( i=0; i < stablenum * 2; i++){
+        makename(names + i * NAMELEN, i);
+    }
+    for( i=0; i < stablenum; i++){
+        ids[i] = nameregistry_add(&nr, names + i * NAMELEN);
+    }
+    for( i=0; i < stablenum / 2; i++){
+        nameregistry_add(&nr, names + (stablenum + i) * NAMELEN);
+    }
+    printf("bench_nameregistry %lu clients, %d readers + 1 churn thread, %.1f sec per mode\n", stablenum, readers, seconds);
+    for( locked = 1; locked >= 0; locked --){
+        run(readers, seconds);
+        if( errors){
+            printf("Error: %lu wrong lookups\n", errors);
+            return 2;
+        }
+    }
+    return 0;
+}
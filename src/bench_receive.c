@@ -0,0 +1,243 @@
+/*
+** bench_receive.c
+**
+**  per-packet CPU cost of the receive path, over a loopback UDP socket.
+**  "copy": recv() one packet into a struct messageblock, copy every datablock out, convert it.
+**          (the receive path before msgview.h)
+**  "view": recvmmsg() a batch, validate and convert the new datablocks in place through msgview.h.
+**          (the receive path of the server)
+**  "auth": like view, the packets have the MAC trailer, and it is checked first (--authkeyfile)
+**  Every packet carries one new datablock and repeats the 7 previous ones, like the agent does.
+**  Only the draining of the already queued packets is timed, not the sending.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#define _GNU_SOURCE 1 /* recvmmsg */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "datablock.h"
+#include "msgview.h"
+#include "siphash.h"
+
+#define BATCH 32
+
+struct compactblock { /* like the storedblock of the server */
+    uint32_t measurementcount;
+    float min, max, sumx, sumxx;
+};
+
+static struct compactblock ring[64];
+static unsigned int ringpos;
+static struct timespec laststart;
+
+
+static double now_sec(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+
+static inline int timespec_gt(const struct timespec *left, const struct timespec *right)
+{
+    return left->tv_sec > right->tv_sec || (left->tv_sec == right->tv_sec && left->tv_nsec > right->tv_nsec);
+}
+
+
+/* the old way: the whole packet on the stack, every datablock copied out before the compare */
+static int drain_copy(int fd, int packets)
+{
+    struct messageblock mb;
+    struct datablock db;
+    struct compactblock * cbp;
+    int i, j;
+    int good = 0;
+
+    for( i=0; i < packets; i++){
+        if( sizeof(mb) != recv(fd, &mb, sizeof(mb), 0)){
+            continue;
+        }
+        if( FSLATENCY_VERSION_MAJOR != mb.major || FSLATENCY_VERSION_MINOR != mb.minor
+            || 0 != memcmp(mb.magic, FSLATENCY_MAGIC, FSLATENCY_MAGIC_LEN)){
+            continue;
+        }
+        for( j = FSLATENCY_DATABLOCKARRAY_LEN - 1; j >= 0; j--){
+            db = mb.datablockarray[j];
+            if( timespec_gt(&(db.starttime), &laststart)){
+                cbp = ring + (ringpos++ % 64);
+                cbp->measurementcount = db.measurementcount;
+                cbp->min = db.min;
+                cbp->max = db.max;
+                cbp->sumx = db.sumx;
+                cbp->sumxx = db.sumxx;
+                laststart = db.starttime;
+            }
+        }
+        good ++;
+    }
+    return good;
+}
+
+
+/* the new way: a batch per syscall, the new datablocks straight from the receive buffer.
+   key: check the MAC trailer too (NULL: no trailer) */
+static int drain_view(int fd, int packets, const uint8_t * key)
+{
+    static unsigned char buffers[BATCH][sizeof(struct messageblock) + FSLATENCY_MAC_LEN + 1];
+    struct mmsghdr msgs[BATCH];
+    struct iovec iovecs[BATCH];
+    struct timespec start;
+    struct compactblock * cbp;
+    const unsigned char * p;
+    int n, i, j;
+    int good = 0;
+    int received = 0;
+
+    memset(msgs, 0, sizeof(msgs));
+    for( i=0; i < BATCH; i++){
+        iovecs[i].iov_base = buffers[i];
+        iovecs[i].iov_len = sizeof(buffers[i]);
+        msgs[i].msg_hdr.msg_iov = iovecs + i;
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while( received < packets){
+        n = recvmmsg(fd, msgs, packets - received < BATCH ? packets - received : BATCH, MSG_WAITFORONE, NULL);
+        if( n <= 0){
+            break;
+        }
+        received += n;
+        for( i=0; i < n; i++){
+            p = buffers[i];
+            if( NULL != key){
+                if( !msgview_valid(p, msgs[i].msg_len - FSLATENCY_MAC_LEN)
+                    || siphash24(p, sizeof(struct messageblock), key) != msgview_mac(p)){
+                    continue;
+                }
+            } else if( !msgview_valid(p, msgs[i].msg_len)){
+                continue;
+            }
+            for( j = FSLATENCY_DATABLOCKARRAY_LEN - 1; j >= 0; j--){
+                msgview_start(p, j, &start);
+                if( timespec_gt(&start, &laststart)){
+                    cbp = ring + (ringpos++ % 64);
+                    cbp->measurementcount = msgview_count(p, j);
+                    cbp->min = msgview_min(p, j);
+                    cbp->max = msgview_max(p, j);
+                    cbp->sumx = msgview_sumx(p, j);
+                    cbp->sumxx = msgview_sumxx(p, j);
+                    laststart = start;
+                }
+            }
+            good ++;
+        }
+    }
+    return good;
+}
+
+
+int main(int argc, char * argv[])
+{
+    int rounds, r, mode, i, j, burst;
+    time_t seconds = 1000;
+    int rfd, sfd;
+    int rcvbuf = 16 * 1024 * 1024;
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    struct {
+        struct messageblock mb;
+        uint64_t mac;
+    } __attribute__ ((packed)) packet;
+    struct messageblock * mbp = &packet.mb;
+    uint8_t key[SIPHASH_KEY_LEN] = "bench key 012345";
+    double t, total[3] = {0.0, 0.0, 0.0};
+    int good[3] = {0, 0, 0};
+    static const char * modename[3] = {"copy", "view", "auth"};
+
+    if( argc != 3){
+        puts("Incorrect number of parameters. Usage:");
+        puts("  bench_receive  <packets_per_burst> <rounds>");
+        return 2;
+    }
+    burst = atoi(argv[1]);
+    rounds = atoi(argv[2]);
+
+    rfd = socket(AF_INET, SOCK_DGRAM, 0);
+    sfd = socket(AF_INET, SOCK_DGRAM, 0);
+    setsockopt(rfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if( 0 != bind(rfd, (struct sockaddr *) &addr, sizeof(addr)) || 0 != getsockname(rfd, (struct sockaddr *) &addr, &addrlen)){
+        perror("Error: cannot bind");
+        return 2;
+    }
+
+    memset(&packet, 0, sizeof(packet));
+    memcpy(mbp->magic, FSLATENCY_MAGIC, FSLATENCY_MAGIC_LEN);
+    mbp->major = FSLATENCY_VERSION_MAJOR;
+    mbp->minor = FSLATENCY_VERSION_MINOR;
+    strcpy(mbp->hostname, "bench.example.com");
+
+    for( r=0; r < rounds; r++){
+        for( mode=0; mode < 3; mode++){
+            for( i=0; i < burst; i++){
+                /* like an agent: one new datablock per packet, the 7 older ones are repeated */
+                seconds ++;
+                for( j=0; j < FSLATENCY_DATABLOCKARRAY_LEN; j++){
+                    mbp->datablockarray[j] = (struct datablock) {10, {seconds - j, 0}, {seconds - j + 1, 0}, -0.5, 0.5, 0.1, 1.0};
+                }
+                if( 2 == mode){ /* like an agent with --authkeyfile */
+                    packet.mac = siphash24(mbp, sizeof(struct messageblock), key);
+                    sendto(sfd, &packet, sizeof(packet), 0, (struct sockaddr *) &addr, sizeof(addr));
+                } else {
+                    sendto(sfd, mbp, sizeof(struct messageblock), 0, (struct sockaddr *) &addr, sizeof(addr));
+                }
+            }
+            t = now_sec();
+            switch( mode){
+                case 0:
+                    good[mode] += drain_copy(rfd, burst);
+                    break;
+                case 1:
+                    good[mode] += drain_view(rfd, burst, NULL);
+                    break;
+                default:
+                    good[mode] += drain_view(rfd, burst, key);
+            }
+            total[mode] += now_sec() - t;
+        }
+    }
+    printf("bench_receive %d packets x %d rounds\n", burst, rounds);
+    for( mode=0; mode < 3; mode++){
+        printf("%-5s %8.1f nsec/packet  (processed: %d)\n", modename[mode],
+            total[mode] * 1e9 / ((double) burst * rounds), good[mode]);
+    }
+    close(rfd);
+    close(sfd);
+    return 0;
+}
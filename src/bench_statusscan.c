@@ -0,0 +1,140 @@
+/*
+** bench_statusscan.c
+**
+**  statusscan kernels microbenchmark: scan time per 100k clients for every implementation
+**  the CPU supports. Also checks that all implementations give the same verdicts.
+**  threshold is the meanstd detector pass, bounds is the pass of the precalculated (mad) bounds.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "statusscan.h"
+
+static const char * implname[] = { "scalar", "sse2", "avx2" };
+
+
+static double now_sec(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+
+static double * randomarray(size_t n, double base, double range)
+{
+    double * a = (double *) malloc(n * sizeof(double));
+    size_t i;
+
+    for( i=0; i < n; i++){
+        a[i] = base + range * (random() / (double) RAND_MAX);
+    }
+    return a;
+}
+
+
+int main(int argc, char * argv[])
+{
+    size_t n, i;
+    int rounds, r, impl;
+    uint32_t * alarm;
+    uint8_t * verdict;
+    uint8_t * reference;
+    unsigned int counts[STATUSSCAN_COUNTERS];
+    struct statusscan_window w;
+    struct statusscan_total total;
+    double * lo;
+    double * hi;
+    double t0, tcount, tthreshold, tbounds;
+
+    if( argc != 3){
+        puts("Incorrect number of parameters. Usage:");
+        puts("  bench_statusscan  <client_number> <rounds>");
+        return 2;
+    }
+    n = atol(argv[1]);
+    rounds = atoi(argv[2]);
+
+    /* realistic-ish data: 600 measurements per window, ln(ms) around 0, some outliers and alarms */
+    alarm = (uint32_t *) malloc(n * sizeof(uint32_t));
+    verdict = (uint8_t *) malloc(n);
+    reference = (uint8_t *) malloc(2 * n);  /* threshold and bounds */
+    for( i=0; i < n; i++){
+        alarm[i] = (0 == random() % 20) ? (1u << (random() % 4)) : 0;
+    }
+    w.sumN = randomarray(n, 500.0, 100.0);
+    w.sumx = randomarray(n, -50.0, 100.0);
+    w.sumxx = randomarray(n, 600.0, 200.0);
+    w.winmin = randomarray(n, -3.0, 1.0);
+    w.winmax = randomarray(n, 2.0, 3.0);
+    w.lastmin = randomarray(n, -3.0, 1.0);
+    w.lastmax = randomarray(n, 0.0, 30.0);
+    for( i=0; i < n; i += 7){
+        w.sumN[i] = 0.0; /* empty slots */
+    }
+    lo = randomarray(n, -3.5, 1.0);
+    hi = randomarray(n, 20.0, 5.0);
+
+    printf("bench_statusscan %lu clients %d rounds\n", n, rounds);
+    for( impl = STATUSSCAN_SCALAR; impl <= STATUSSCAN_AVX2; impl++){
+        if( -1 == statusscan_select(impl)){
+            printf("%-7s not supported by this CPU\n", implname[impl]);
+            continue;
+        }
+        t0 = now_sec();
+        for( r=0; r < rounds; r++){
+            statusscan_countalarms(alarm, n, counts);
+        }
+        tcount = now_sec() - t0;
+        t0 = now_sec();
+        for( r=0; r < rounds; r++){
+            statusscan_threshold(&w, n, 15.0, 60.0, verdict, &total);
+        }
+        tthreshold = now_sec() - t0;
+        if( STATUSSCAN_SCALAR == impl){
+            memcpy(reference, verdict, n);
+        } else if( 0 != memcmp(reference, verdict, n)){
+            printf("Error: %s verdicts differ from the scalar ones\n", implname[impl]);
+            return 2;
+        }
+        t0 = now_sec();
+        for( r=0; r < rounds; r++){
+            statusscan_bounds(&w, lo, hi, n, verdict);
+        }
+        tbounds = now_sec() - t0;
+        printf("%-7s countalarms: %8.1f usec/100k clients  threshold: %8.1f usec/100k clients  bounds: %8.1f usec/100k clients  (alarmed:%u verdictsum:%.0f)\n",
+            implname[impl],
+            tcount / rounds / n * 100000 * 1e6,
+            tthreshold / rounds / n * 100000 * 1e6,
+            tbounds / rounds / n * 100000 * 1e6,
+            counts[0], total.sumN);
+        if( STATUSSCAN_SCALAR == impl){
+            memcpy(reference + n, verdict, n);
+        } else if( 0 != memcmp(reference + n, verdict, n)){
+            printf("Error: %s bounds verdicts differ from the scalar ones\n", implname[impl]);
+            return 2;
+        }
+    }
+    return 0;
+}
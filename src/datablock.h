@@ -68,7 +68,8 @@ static inline void datablock_print(const struct datablock * d)
 #define FSLATENCY_HOSTNAME_LEN 64u
 #define FSLATENCY_TEXT_LEN 64u
 #define FSLATENCY_VERSION_MAJOR 0u
-#define FSLATENCY_VERSION_MINOR 1u
+#define FSLATENCY_VERSION_MINOR 3u
+#define FSLATENCY_VERSION_MINOR_OLDEST 1u  /* the data processor accepts 0.1 too, see msgview_valid() */
 #define FSLATENCY_DATABLOCKARRAY_LEN 8u
 #define FSLATENCY_EXTREMEBIGINTERVAL  1000000000.0  /* 31year must be enought for disk latency measurements :-) */
 
@@ -80,8 +81,15 @@ struct messageblock {
     char text[FSLATENCY_TEXT_LEN];
     struct timespec precision;
     struct datablock datablockarray[FSLATENCY_DATABLOCKARRAY_LEN];
+    /* the end of a 0.1 packet. The new fields are appended, so the old ones never move */
+    uint16_t schedpolicy;  /* of the measuring thread: SCHED_OTHER 0, SCHED_FIFO 1, SCHED_RR 2 (since 0.2) */
+    uint16_t schedprio;
+    uint64_t sequence;     /* of the packet, from 1, see the loss accounting of the data processor (since 0.3) */
 };
 
+/* optional trailer (--authkeyfile): the SipHash-2-4 MAC of the messageblock, see siphash.h */
+#define FSLATENCY_MAC_LEN 8u
+
 
 #pragma pack(pop)
 #endif /* __DATABLOCK_H */
@@ -0,0 +1,225 @@
+/*
+** detector.c
+**
+** latency outlier detector implementations. See detector.h
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <math.h>
+#include "detector.h"
+
+static const char * const detectornames[] = { "meanstd", "mad", NULL };
+
+
+int detector_parse(const char * name)
+{
+    int i;
+
+    for( i=0; NULL != detectornames[i]; i++){
+        if( 0 == strcmp(name, detectornames[i])){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+const char * detector_name(int detector)
+{
+    return detectornames[detector];
+}
+
+
+/* the k-th smallest of v[0..n-1] (the selection of N. Wirth). Reorders v. */
+static float select_kth(float * v, long n, long k)
+{
+    long left = 0, right = n - 1;
+    long i, j;
+    float pivot, tmp;
+
+    while( left < right){
+        pivot = v[k];
+        i = left;
+        j = right;
+        do {
+            while( v[i] < pivot){
+                i ++;
+            }
+            while( pivot < v[j]){
+                j --;
+            }
+            if( i <= j){
+                tmp = v[i];
+                v[i] = v[j];
+                v[j] = tmp;
+                i ++;
+                j --;
+            }
+        } while( i <= j);
+        if( j < k){
+            left = i;
+        }
+        if( k < i){
+            right = j;
+        }
+    }
+    return v[k];
+}
+
+
+/* the lower median for even n: a window of datablocks has no natural middle */
+double detector_median(float * v, size_t n)
+{
+    if( 0 == n){
+        return NAN;
+    }
+    return select_kth(v, (long) n, (long) (n - 1) / 2);
+}
+
+
+void detector_mad(float * v, size_t n, double * median, double * mad)
+{
+    size_t i;
+
+    *median = detector_median(v, n);
+    for( i=0; i < n; i++){
+        v[i] = fabsf(v[i] - (float) *median);
+    }
+    *mad = detector_median(v, n);
+}
+
+
+/* same operations as the statusscan kernels */
+int detector_meanstd_bounds(double sumN, double sumx, double sumxx, double factor, double * lo, double * hi)
+{
+    double mean, std;
+
+    if( sumN < 2.0){
+        return -1;
+    }
+    mean = sumx / sumN;
+    std = sqrt((sumxx - sumx*mean)/(sumN-1.0));
+    *lo = mean - std * factor;
+    *hi = mean + std * factor;
+    return 0;
+}
+
+
+void detector_mad_bounds(float * mins, float * maxs, size_t n, double factor, double minscale, double * lo, double * hi)
+{
+    double median, mad;
+
+    detector_mad(mins, n, &median, &mad);
+    mad *= DETECTOR_MAD_SCALE;
+    *lo = median - factor * (mad > minscale ? mad : minscale);
+    detector_mad(maxs, n, &median, &mad);
+    mad *= DETECTOR_MAD_SCALE;
+    *hi = median + factor * (mad > minscale ? mad : minscale);
+}
+
+
+void drift_init(struct drift * dp)
+{
+    dp->baseline = dp->cusum = 0.0;
+    dp->n = 0;
+    dp->alarmed = 0;
+}
+
+
+int drift_update(struct drift * dp, double mean, double delta)
+{
+    double h = DRIFT_H_BLOCKS * delta / 2.0;
+
+    if( dp->n < DRIFT_WARMUP){
+        /* the plain mean of the first datablocks */
+        dp->n ++;
+        dp->baseline += (mean - dp->baseline) / dp->n;
+        return 0;
+    }
+    dp->cusum += mean - dp->baseline - delta / 2.0;
+    if( dp->cusum < 0.0){
+        dp->cusum = 0.0;
+    } else if( dp->cusum > 2.0 * h){
+        dp->cusum = 2.0 * h;  /* so it recovers in a few minutes */
+    }
+    dp->baseline += (mean - dp->baseline) / (1 << DRIFT_BASE_SHIFT);
+    if( dp->cusum > h){
+        dp->alarmed = 1;
+    } else if( dp->cusum < h / 2.0){
+        dp->alarmed = 0;
+    }
+    return dp->alarmed;
+}
+
+
+#define PROFILE_RESCALE 1e30  /* the weight grows to this in about 100 hours of datablocks */
+
+void profile_init(struct profile * pp)
+{
+    memset(pp->bin, 0, sizeof(pp->bin));
+    pp->total = 0.0;
+    pp->weight = 1.0;
+    pp->n = 0;
+}
+
+
+void profile_add(struct profile * pp, double x)
+{
+    int k = (int) floor((x - PROFILE_LOW) / PROFILE_BINWIDTH);
+    int i;
+
+    if( k < 0){
+        k = 0;
+    } else if( k >= PROFILE_BINS){
+        k = PROFILE_BINS - 1;
+    }
+    pp->bin[k] += (float) pp->weight;
+    pp->total += pp->weight;
+    /* the new ones weigh more instead of decaying the old ones: the same ratios */
+    pp->weight *= exp2(1.0 / PROFILE_HALFLIFE);
+    if( pp->weight > PROFILE_RESCALE){
+        for( i=0; i < PROFILE_BINS; i++){
+            pp->bin[i] = (float) (pp->bin[i] / pp->weight);
+        }
+        pp->total /= pp->weight;
+        pp->weight = 1.0;
+    }
+    if( pp->n < PROFILE_WARMUP){
+        pp->n ++;
+    }
+}
+
+
+double profile_quantile(const struct profile * pp, double q)
+{
+    double target = q * pp->total;
+    double sum = 0.0;
+    int i;
+
+    if( pp->n < PROFILE_WARMUP){
+        return PROFILE_NONE;
+    }
+    for( i=0; i < PROFILE_BINS - 1; i++){
+        if( sum + pp->bin[i] >= target){
+            break;
+        }
+        sum += pp->bin[i];
+    }
+    /* linear within the bin */
+    return PROFILE_LOW + PROFILE_BINWIDTH * (i + (pp->bin[i] > 0.0 ? (target - sum) / pp->bin[i] : 0.0));
+}
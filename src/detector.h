@@ -0,0 +1,116 @@
+/*
+** detector.h
+**
+** latency outlier detector definitions (statistical alarmer of the data processor)
+**
+**  A detector gives the bounds of the latest datablock of a client from its rolling window,
+**  in ln(millisec) space: an alarm is raised if the min of the latest datablock is below lo
+**  (ALARM_STATISTICALALARM_LOW) or its max is above hi (ALARM_STATISTICALALARM_HIGH).
+**
+**  - meanstd  mean +- factor * standard deviation of all measurements of the window.
+**             From the sums, O(1), but the long tail of the latency inflates the deviation,
+**             and the single pass formula loses precision.
+**  - mad      median +- factor * MAD of the datablock minimums (lo) and maximums (hi) of the window.
+**             MAD is the median absolute deviation, scaled to the standard deviation of a normal
+**             distribution (DETECTOR_MAD_SCALE), and at least minscale. A few extreme datablocks
+**             move neither the median nor the MAD, and the latest max is compared to the earlier maxes,
+**             not to the mean of all measurements. O(n) with quickselect, so the data processor
+**             recalculates the bounds only every few datablocks.
+**
+**  The drift detector finds a slow degradation, that raises the window (and so the bounds above) with itself:
+**  a one-sided CUSUM of the datablock means over a slow baseline (exponential moving average, about
+**  an hour). cusum = max(0, cusum + mean - baseline - delta/2), the alarm is on over DRIFT_H_BLOCKS * delta/2
+**  and off under the half of it. delta is ln of the latency ratio to be found, so a sustained 2x latency
+**  (delta = ln 2) alarms after about DRIFT_H_BLOCKS datablocks, a 3x creep over ten minutes in about 7 minutes,
+**  while a few seconds of 10x latency (the job of the detectors above) does not. O(1) per datablock.
+**
+**  The profile is the long term memory of a client, beyond the rolling window: an exponentially decayed
+**  histogram of the datablock maximums, PROFILE_BINS bins of PROFILE_BINWIDTH over ln(millisec)
+**  (the ends collect everything outside), with a half-life of PROFILE_HALFLIFE datablocks (about an hour).
+**  Instead of decaying every bin with each datablock, the weight of the new datablocks grows, and
+**  the bins are rescaled only when the weight gets too big (every few days): O(1) per datablock,
+**  sizeof(struct profile) per client. The quantile is interpolated within its bin, O(PROFILE_BINS).
+**
+** multithread safe: no state
+**
+**  functions:
+**      - parse          detector name -> DETECTOR_*, -1 if unknown
+**      - name           DETECTOR_* -> name
+**      - median         median of n values with quickselect. Reorders the values.
+**      - mad            median and median absolute deviation (not scaled). Reorders the values.
+**      - meanstd_bounds bounds from the sums of the window. Returns -1 if there is too little data.
+**      - mad_bounds     bounds from the datablock minimums and maximums of the window (both reordered).
+**      - drift_init     the constructor of the drift state of a client
+**      - drift_update   adds a datablock mean. Returns the alarm state (1: drifting up)
+**      - profile_init   the constructor of the profile of a client
+**      - profile_add    adds a datablock maximum
+**      - profile_quantile  the q quantile (0 < q < 1) of the profile in ln(ms).
+**                     PROFILE_NONE until PROFILE_WARMUP datablocks
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __DETECTOR_H
+#define __DETECTOR_H
+
+#include <stdlib.h>
+
+#define DETECTOR_MEANSTD 0
+#define DETECTOR_MAD 1
+
+#define DETECTOR_MAD_SCALE 1.4826   /* MAD * 1.4826 == sigma of a normal distribution */
+
+#define DRIFT_BASE_SHIFT 12    /* the baseline follows with 1/4096 per datablock: about an hour */
+#define DRIFT_WARMUP 300       /* datablocks of the baseline before any alarm */
+#define DRIFT_H_BLOCKS 60.0
+
+#define PROFILE_BINS 64
+#define PROFILE_BINWIDTH 0.25  /* ln(ms): a bin is 28% wide */
+#define PROFILE_LOW (-7.0)     /* ln(ms) of the lower edge of the first bin: 0.9 usec. The last one ends at 8.8 s */
+#define PROFILE_HALFLIFE 3600  /* datablocks */
+#define PROFILE_WARMUP 600     /* datablocks before the profile is used */
+#define PROFILE_NONE -1e9      /* the quantile of an immature profile: below everything, it never raises a bound */
+
+struct drift {
+    double baseline;  /* ln(ms) */
+    double cusum;
+    unsigned int n;   /* datablocks, up to DRIFT_WARMUP */
+    int alarmed;
+};
+
+struct profile {
+    float bin[PROFILE_BINS];
+    double total;     /* the sum of the bins */
+    double weight;    /* of the next datablock, grows by 2^(1/PROFILE_HALFLIFE) */
+    unsigned int n;   /* datablocks, up to PROFILE_WARMUP */
+};
+
+
+int detector_parse(const char * name);
+const char * detector_name(int detector);
+double detector_median(float * v, size_t n);
+void detector_mad(float * v, size_t n, double * median, double * mad);
+int detector_meanstd_bounds(double sumN, double sumx, double sumxx, double factor, double * lo, double * hi);
+void detector_mad_bounds(float * mins, float * maxs, size_t n, double factor, double minscale, double * lo, double * hi);
+void drift_init(struct drift * dp);
+int drift_update(struct drift * dp, double mean, double delta);
+void profile_init(struct profile * pp);
+void profile_add(struct profile * pp, double x);
+double profile_quantile(const struct profile * pp, double q);
+
+#endif /* __DETECTOR_H */
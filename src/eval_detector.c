@@ -0,0 +1,304 @@
+/*
+** eval_detector.c
+**
+**  offline evaluation of the latency outlier detectors (see detector.h): replays recorded datablocks
+**  through the rolling window of every client, like the data processor, and counts the alarms of
+**  both detectors on the normal and on the incident datablocks.
+**
+**  The record is text, one datablock per line, in the order of arrival:
+**      client count min max sumx sumxx [label]
+**  in ln(millisec) space, like the --recordfile of the data processor. label 1 marks an incident
+**  (a real storage problem), 0 or nothing a normal datablock: an alarm on it is a false alarm.
+**  --generate writes a synthetic record: clients with long tailed latency, some noisy ones,
+**  and rare incidents: a few seconds with 10x latency, or a single hanging operation.
+**  With a profilequantile (like the --profilequantile of the data processor), a high alarm needs
+**  the max of the datablock above that quantile of the long term profile of the client too.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "detector.h"
+
+#define MEASUREMENTS 10  /* per datablock, like the agent */
+
+struct block {
+    unsigned int count;
+    float min, max, sumx, sumxx;
+};
+
+struct client {
+    struct block * ring;
+    int start, len;
+    double sumN, sumx, sumxx;  /* of the window */
+    double madlo, madhi;       /* the precalculated bounds of the mad detector */
+    int age;                   /* datablocks since the bounds were calculated */
+    int alarmed[2];            /* by detector: the previous datablock raised an alarm */
+    struct profile profile;    /* the long term memory, see detector.h */
+};
+
+struct result {
+    unsigned long falseblocks;  /* alarmed normal datablocks */
+    unsigned long falsealarms;  /* alarm episodes starting on a normal datablock */
+    unsigned long hitblocks;    /* alarmed incident datablocks */
+    unsigned long incidents;    /* incidents with at least one alarmed datablock */
+    double seconds;             /* in the detector */
+};
+
+
+static double now_sec(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+
+static double gauss(void)
+{
+    double u = (random() + 1.0) / (RAND_MAX + 2.0);
+    double v = random() / (RAND_MAX + 1.0);
+
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+
+static double uniform(double from, double to)
+{
+    return from + (to - from) * (random() / (RAND_MAX + 1.0));
+}
+
+
+static int generate(int clients, int blocks, unsigned int seed)
+{
+    double * mu = (double *) malloc(clients * sizeof(double));
+    double * sigma = (double *) malloc(clients * sizeof(double));
+    double * tail = (double *) malloc(clients * sizeof(double));
+    int * incident = (int *) calloc(clients, sizeof(int));
+    double x, min, max, sumx, sumxx;
+    int b, c, m, hang;
+
+    srandom(seed);
+    for( c=0; c < clients; c++){
+        mu[c] = uniform(-1.0, 2.0);          /* 0.4 - 7 msec */
+        sigma[c] = uniform(0.1, 0.5);
+        tail[c] = (0 == c % 10) ? 0.02 : 0.002;  /* every 10th one is a noisy neighbour */
+    }
+    for( b=0; b < blocks; b++){
+        for( c=0; c < clients; c++){
+            hang = 0;
+            if( 0 == incident[c] && uniform(0.0, 1.0) < 0.0005){
+                if( random() % 2){
+                    incident[c] = 3 + random() % 8;  /* slow storage for 3-10 seconds */
+                } else {
+                    hang = 1;  /* one operation hangs */
+                }
+            }
+            min = 1e9; max = -1e9; sumx = sumxx = 0.0;
+            for( m=0; m < MEASUREMENTS; m++){
+                x = mu[c] + sigma[c] * gauss();
+                if( uniform(0.0, 1.0) < tail[c]){
+                    x -= 1.5 * log(uniform(0.0, 1.0) + 1e-12);  /* exponential tail: rare 5-20x ones */
+                }
+                if( incident[c]){
+                    x += 2.3 + 0.5 * gauss();  /* 10x */
+                }
+                if( hang && 0 == m){
+                    x = mu[c] + uniform(4.0, 8.0);  /* 50-3000x */
+                }
+                min = x < min ? x : min;
+                max = x > max ? x : max;
+                sumx += x;
+                sumxx += x * x;
+            }
+            printf("%d %d %f %f %f %f %d\n", c, MEASUREMENTS, min, max, sumx, sumxx, (incident[c] || hang) ? 1 : 0);
+            if( incident[c]){
+                incident[c] --;
+            }
+        }
+    }
+    return 0;
+}
+
+
+/* the verdict of detector d on the latest datablock: 1 if alarmed */
+static int check(int d, struct client * cp, const struct block * bp, int window, double minimumcount,
+                 double meanstdfactor, double madfactor, double minscale, int refresh, double profilequantile,
+                 float * mins, float * maxs)
+{
+    double lo, hi;
+    int i, n;
+
+    if( cp->sumN <= minimumcount){
+        return 0;
+    }
+    if( DETECTOR_MEANSTD == d){
+        detector_meanstd_bounds(cp->sumN, cp->sumx, cp->sumxx, meanstdfactor, &lo, &hi);
+    } else {
+        if( ++ cp->age >= refresh){
+            for( i=0, n=0; i < cp->len; i++){
+                if( 0 != cp->ring[(cp->start + i) % window].count){ /* like mad_bounds() of the data processor */
+                    mins[n] = cp->ring[(cp->start + i) % window].min;
+                    maxs[n] = cp->ring[(cp->start + i) % window].max;
+                    n ++;
+                }
+            }
+            detector_mad_bounds(mins, maxs, n, madfactor, minscale, &cp->madlo, &cp->madhi);
+            cp->age = 0;
+        }
+        lo = cp->madlo;
+        hi = cp->madhi;
+    }
+    if( 0.0 != profilequantile && PROFILE_NONE != profile_quantile(&(cp->profile), profilequantile)
+        && hi < profile_quantile(&(cp->profile), profilequantile)){
+        hi = profile_quantile(&(cp->profile), profilequantile);
+    }
+    return bp->min < lo || bp->max > hi;
+}
+
+
+int main(int argc, char * argv[])
+{
+    FILE * fp;
+    char line[256];
+    struct client * clients = NULL;
+    int nclients = 0;
+    struct client * cp;
+    struct block b;
+    struct block * slot;
+    struct result res[2];
+    int window, refresh, c, label, n, d, alarmed;
+    int * inincident = NULL;  /* by client: the incident was already alarmed by detector bit */
+    unsigned long normalblocks = 0, incidentblocks = 0, incidents = 0;
+    double minimumcount, meanstdfactor, madfactor, minscale, profilequantile = 0.0, t0;
+    float * mins;
+    float * maxs;
+
+    if( 5 == argc && 0 == strcmp(argv[1], "--generate")){
+        return generate(atoi(argv[2]), atoi(argv[3]), (unsigned int) atoi(argv[4]));
+    }
+    if( argc != 8 && argc != 9){
+        puts("Incorrect number of parameters. Usage:");
+        puts("  eval_detector  <recordfile|-> <rollingwindow> <minimummeasurementcount> <latencythresholdfactor> <madthresholdfactor> <madminscale> <refresh> [profilequantile]");
+        puts("  eval_detector  --generate <clients> <datablocks_per_client> <seed>");
+        return 2;
+    }
+    fp = 0 == strcmp(argv[1], "-") ? stdin : fopen(argv[1], "r");
+    if( NULL == fp){
+        perror(argv[1]);
+        return 2;
+    }
+    window = atoi(argv[2]);
+    minimumcount = atof(argv[3]);
+    meanstdfactor = atof(argv[4]);
+    madfactor = atof(argv[5]);
+    minscale = atof(argv[6]);
+    refresh = atoi(argv[7]);
+    if( 9 == argc){
+        profilequantile = atof(argv[8]);
+    }
+    if( 2 > window || 1 > refresh || profilequantile < 0.0 || profilequantile >= 1.0){
+        puts("Error: invalid rollingwindow, refresh or profilequantile");
+        return 2;
+    }
+    mins = (float *) malloc(window * sizeof(float));
+    maxs = (float *) malloc(window * sizeof(float));
+    memset(res, 0, sizeof(res));
+
+    while( NULL != fgets(line, sizeof(line), fp)){
+        label = 0;
+        n = sscanf(line, "%d %u %f %f %f %f %d", &c, &b.count, &b.min, &b.max, &b.sumx, &b.sumxx, &label);
+        if( n < 6 || c < 0){
+            continue;
+        }
+        if( c >= nclients){
+            clients = (struct client *) realloc(clients, (c + 1) * sizeof(struct client));
+            inincident = (int *) realloc(inincident, (c + 1) * sizeof(int));
+            for( ; nclients <= c; nclients++){
+                memset(clients + nclients, 0, sizeof(struct client));
+                clients[nclients].ring = (struct block *) malloc(window * sizeof(struct block));
+                clients[nclients].age = refresh;  /* the first mature datablock calculates the bounds */
+                profile_init(&(clients[nclients].profile));
+                inincident[nclients] = -1;
+            }
+        }
+        cp = clients + c;
+        /* the window update of the data processor, from the float32 values */
+        if( cp->len == window){
+            slot = cp->ring + cp->start;
+            cp->sumN -= slot->count;
+            cp->sumx -= slot->sumx;
+            cp->sumxx -= slot->sumxx;
+            cp->start = (cp->start + 1) % window;
+        } else {
+            slot = cp->ring + (cp->start + cp->len) % window;
+            cp->len ++;
+        }
+        *slot = b;
+        cp->sumN += b.count;
+        cp->sumx += b.sumx;
+        cp->sumxx += b.sumxx;
+        if( 0 == b.count){
+            cp->age ++;  /* the refresh of the mad bounds counts it, like in the data processor */
+            continue;    /* it is the stuck alarm, not an outlier */
+        }
+
+        if( label){
+            incidentblocks ++;
+            if( -1 == inincident[c]){
+                incidents ++;
+                inincident[c] = 0;
+            }
+        } else {
+            normalblocks ++;
+            inincident[c] = -1;
+        }
+        for( d = DETECTOR_MEANSTD; d <= DETECTOR_MAD; d++){
+            t0 = now_sec();
+            alarmed = check(d, cp, &b, window, minimumcount, meanstdfactor, madfactor, minscale, refresh, profilequantile, mins, maxs);
+            res[d].seconds += now_sec() - t0;
+            if( alarmed && label){
+                res[d].hitblocks ++;
+                if( !(inincident[c] & (1 << d))){
+                    res[d].incidents ++;
+                    inincident[c] |= 1 << d;
+                }
+            } else if( alarmed){
+                res[d].falseblocks ++;
+                res[d].falsealarms += !cp->alarmed[d];
+            }
+            cp->alarmed[d] = alarmed;
+        }
+        profile_add(&(cp->profile), b.max);  /* after the check: the datablock is compared to the earlier ones */
+    }
+
+    printf("eval_detector: %d clients, %lu normal and %lu incident datablocks, %lu incidents\n",
+        nclients, normalblocks, incidentblocks, incidents);
+    for( d = DETECTOR_MEANSTD; d <= DETECTOR_MAD; d++){
+        printf("%-8s false alarms: %6lu (%lu datablocks, %.4f%%)  incidents detected: %lu of %lu (%lu datablocks)  %.3f usec/datablock\n",
+            detector_name(d), res[d].falsealarms, res[d].falseblocks, normalblocks ? 100.0 * res[d].falseblocks / normalblocks : 0.0,
+            res[d].incidents, incidents, res[d].hitblocks, (normalblocks + incidentblocks) ? res[d].seconds / (normalblocks + incidentblocks) * 1e6 : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+** fleet.c
+**
+** fleet-wide statistics implementations. See fleet.h
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <math.h>
+#include "fleet.h"
+
+
+void fleet_sketch_init(struct fleet_sketch * fsp)
+{
+    memset(fsp->bin, 0, sizeof(fsp->bin));
+    fsp->n = 0;
+}
+
+
+void fleet_sketch_add(struct fleet_sketch * fsp, double x)
+{
+    int k;
+
+    if( !(x >= FLEET_LOW)){ /* NaN too */
+        k = 0;
+    } else if( x >= FLEET_LOW + FLEET_BINS * FLEET_BINWIDTH){
+        k = FLEET_BINS - 1;
+    } else {
+        k = (int) ((x - FLEET_LOW) / FLEET_BINWIDTH);
+    }
+    fsp->bin[k] ++;
+    fsp->n ++;
+}
+
+
+void fleet_sketch_merge(struct fleet_sketch * fsp, const struct fleet_sketch * other)
+{
+    int i;
+
+    for( i=0; i < FLEET_BINS; i++){
+        fsp->bin[i] += other->bin[i];
+    }
+    fsp->n += other->n;
+}
+
+
+double fleet_sketch_quantile(const struct fleet_sketch * fsp, double q)
+{
+    double target = q * fsp->n;
+    uint64_t sum = 0;
+    int i;
+
+    if( 0 == fsp->n){
+        return 0.0;
+    }
+    for( i=0; i < FLEET_BINS - 1; i++){
+        if( sum + fsp->bin[i] >= target && 0 != fsp->bin[i]){
+            break;
+        }
+        sum += fsp->bin[i];
+    }
+    /* linear within the bin */
+    return FLEET_LOW + FLEET_BINWIDTH * (i + (fsp->bin[i] ? (target - sum) / fsp->bin[i] : 0.0));
+}
+
+
+void fleet_topk_init(struct fleet_topk * ftp, int k)
+{
+    ftp->k = k < FLEET_TOPK_MAX ? k : FLEET_TOPK_MAX;
+    ftp->n = 0;
+}
+
+
+/* moves the entry at i down to its place in the min-heap */
+static void sift_down(struct fleet_topk_entry * heap, int n, int i)
+{
+    struct fleet_topk_entry tmp;
+    int child;
+
+    while( (child = 2 * i + 1) < n){
+        if( child + 1 < n && heap[child + 1].score < heap[child].score){
+            child ++;
+        }
+        if( heap[i].score <= heap[child].score){
+            break;
+        }
+        tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+}
+
+
+void fleet_topk_offer(struct fleet_topk * ftp, int id, double score)
+{
+    struct fleet_topk_entry tmp;
+    int i, parent;
+
+    if( isnan(score)){
+        return; /* NaN */
+    }
+    if( ftp->n < ftp->k){
+        /* sift up */
+        i = ftp->n ++;
+        ftp->heap[i].score = score;
+        ftp->heap[i].id = id;
+        while( i > 0 && ftp->heap[(parent = (i - 1) / 2)].score > ftp->heap[i].score){
+            tmp = ftp->heap[i];
+            ftp->heap[i] = ftp->heap[parent];
+            ftp->heap[parent] = tmp;
+            i = parent;
+        }
+    } else if( ftp->k > 0 && score > ftp->heap[0].score){
+        ftp->heap[0].score = score;
+        ftp->heap[0].id = id;
+        sift_down(ftp->heap, ftp->n, 0);
+    }
+}
+
+
+int fleet_topk_sorted(const struct fleet_topk * ftp, struct fleet_topk_entry * out)
+{
+    struct fleet_topk_entry heap[FLEET_TOPK_MAX];
+    int n = ftp->n;
+    int i;
+
+    /* heapsort of a copy: the lowest one goes to the end */
+    memcpy(heap, ftp->heap, n * sizeof(struct fleet_topk_entry));
+    for( i = n - 1; i >= 0; i--){
+        out[i] = heap[0];
+        heap[0] = heap[i];
+        sift_down(heap, i, 0);
+    }
+    return n;
+}
@@ -0,0 +1,79 @@
+/*
+** fleet.h
+**
+** fleet-wide statistics definitions (the statistical pass of the data processor)
+**
+**  The sums of all measurements of all clients (see statusscan_threshold()) hide a single slow client.
+**  Once per pass, every client with enough measurements is added to
+**  - a sketch: the distribution of the window means of the clients. A histogram over ln(millisec)
+**    with FLEET_BINS bins of FLEET_BINWIDTH (5%, the ends collect everything outside), so a quantile
+**    is within 2.5% of the latency. Fixed size, and two sketches are merged by adding their bins.
+**  - a top-K: the K clients with the highest score (z-score), a min-heap of at most FLEET_TOPK_MAX
+**    entries. The root is the lowest of the top ones, a new client replaces it if it is higher.
+**  O(clients * log K) per pass.
+**
+** NOT multithread safe: one pass fills its own ones.
+**
+**  functions:
+**      - sketch_init      the constructor of an empty sketch
+**      - sketch_add       adds a value, ln(ms)
+**      - sketch_merge     adds the values of an other sketch
+**      - sketch_quantile  the q quantile (0 <= q <= 1), interpolated within its bin. 0.0 if empty
+**      - topk_init        the constructor, k <= FLEET_TOPK_MAX
+**      - topk_offer       keeps the id if its score is among the k highest, O(log k)
+**      - topk_sorted      the kept ones in decreasing score order into out. Returns their number.
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __FLEET_H
+#define __FLEET_H
+
+#include <stdint.h>
+
+#define FLEET_BINS 320
+#define FLEET_BINWIDTH 0.05  /* ln(ms) */
+#define FLEET_LOW (-7.0)     /* ln(ms) of the lower edge of the first bin: 0.9 usec. The last one ends at 8.8 s */
+#define FLEET_TOPK_MAX 16
+
+struct fleet_sketch {
+    uint32_t bin[FLEET_BINS];
+    uint64_t n;
+};
+
+struct fleet_topk_entry {
+    double score;
+    int id;
+};
+
+struct fleet_topk {
+    int k;
+    int n;
+    struct fleet_topk_entry heap[FLEET_TOPK_MAX];  /* heap[0] is the lowest */
+};
+
+
+void fleet_sketch_init(struct fleet_sketch * fsp);
+void fleet_sketch_add(struct fleet_sketch * fsp, double x);
+void fleet_sketch_merge(struct fleet_sketch * fsp, const struct fleet_sketch * other);
+double fleet_sketch_quantile(const struct fleet_sketch * fsp, double q);
+void fleet_topk_init(struct fleet_topk * ftp, int k);
+void fleet_topk_offer(struct fleet_topk * ftp, int id, double score);
+int fleet_topk_sorted(const struct fleet_topk * ftp, struct fleet_topk_entry * out);
+
+#endif /* __FLEET_H */
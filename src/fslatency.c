@@ -49,6 +49,8 @@
 #include <math.h>
 
 #include "datablock.h"
+#include "rtsched.h"
+#include "siphash.h"
 
 /*
 ** Cyclic buffer routines
@@ -144,6 +146,8 @@ static inline double diff_timespec_double(const struct timespec *endtime, const
 #define OPT_NOCHECKFS 5
 #define OPT_NOMEMLOCK 6
 #define OPT_DEBUG 7
+#define OPT_THREADSCHED 8
+#define OPT_AUTHKEYFILE 9
 #define OPT_VERSION 101
 
 struct option myoptions[] = {
@@ -155,6 +159,8 @@ struct option myoptions[] = {
  { "nocheckfs", 0, NULL, OPT_NOCHECKFS},  /* optional */
  { "nomemlock", 0, NULL, OPT_NOMEMLOCK},  /* optional */
  { "debug", 0, NULL, OPT_DEBUG},          /* optional */
+ { "threadsched", 1, NULL, OPT_THREADSCHED}, /* optional, repeatable */
+ { "authkeyfile", 1, NULL, OPT_AUTHKEYFILE}, /* optional */
  { "version", 0, NULL, OPT_VERSION},      /* optional */
  { NULL, 0, NULL, 0}
 };
@@ -166,16 +172,25 @@ static struct _opt {
     char * text;
     char * filename;
     char * hostname;
+    char * authkeyfile;
     unsigned int nocheckfs;
     unsigned int nomemlock;
     unsigned int debug;
+    struct rtsched threadsched;
 } opt;
 
+static uint8_t authkey[SIPHASH_KEY_LEN]; /* of --authkeyfile, read once by parse_opt() */
+
+/* for --threadsched */
+static const char * const threadnames[] = { "measuring", "datasender", NULL};
+
 
 void help()
 {
     puts("Usage: fslatency --serverip a.b.c.d [--serverport PORT] --file PATH");
-    puts("   [--text NAME] [--nocheckfs] [--nomemlock] [--debug] [--version]");
+    puts("   [--text NAME] [--threadsched NAME:POLICY:PRIO[:CPU]]... [--nocheckfs] [--nomemlock]");
+    puts("   [--authkeyfile PATH] [--debug] [--version]");
+    puts("   threads: measuring, datasender. policies: fifo, rr, other");
 }
 
 
@@ -194,15 +209,18 @@ static void init_opt(void)
         exit(3);
     }
 
+    opt.authkeyfile = NULL;
     opt.nocheckfs = 0; /*False*/
     opt.nomemlock = 0; /*False*/
     opt.debug = 0; /*False*/
+    opt.threadsched.n = 0;
 }
 
 
 static int parse_opt(int argc, char * argv[])
 {
     int optcode;
+    int i;
 
     /* parameter processing */
     /* --ip a.b.c.d --port PORT --text "FOO" --file  "path" */
@@ -224,6 +242,9 @@ static int parse_opt(int argc, char * argv[])
             case OPT_FILE:
                 opt.filename = strdup(optarg);
                 break;
+            case OPT_AUTHKEYFILE:
+                opt.authkeyfile = strdup(optarg);
+                break;
             case OPT_NOCHECKFS:
                 opt.nocheckfs = 1;
                 break;
@@ -233,6 +254,13 @@ static int parse_opt(int argc, char * argv[])
             case OPT_DEBUG:
                 opt.debug = 1;
                 break;
+            case OPT_THREADSCHED:
+                if( 0 != rtsched_add(&opt.threadsched, optarg, threadnames)){
+                    dprintf(2 /*stderr*/, "Error: invalid --threadsched \"%s\"\n", optarg);
+                    help();
+                    return 2;
+                }
+                break;
             case OPT_VERSION:
                 dprintf(2, "fslatency %d.%d. UDP version %d.%d\n", AGENT_VERSION_MAJOR, AGENT_VERSION_MINOR, FSLATENCY_VERSION_MAJOR, FSLATENCY_VERSION_MINOR);
                 exit(0);
@@ -259,6 +287,10 @@ static int parse_opt(int argc, char * argv[])
         dprintf(2 /*stderr*/, "Warning: too long --text. Truncated to %u char.\n", FSLATENCY_TEXT_LEN);
         //opt.text[FSLATENCY_TEXT_LEN] = 0;
     }
+    if( NULL != opt.authkeyfile && 0 != siphash_readkey(opt.authkeyfile, authkey)){
+        dprintf(2 /*stderr*/, "Error: cannot read the key (32 hex digits) from --authkeyfile \"%s\"\n", opt.authkeyfile);
+        return 2;
+    }
 
 
     if( opt.debug){
@@ -267,9 +299,14 @@ static int parse_opt(int argc, char * argv[])
         printf("    --serverport %s\n", opt.serverport);
         printf("    --text \"%s\"\n", opt.text);
         printf("    --file \"%s\"\n", opt.filename);
+        printf("    --authkeyfile %s\n", opt.authkeyfile);
         printf("    --nocheckfs %d\n", opt.nocheckfs);
         printf("    --nomemlock %d\n", opt.nomemlock);
         printf("    --debug %d\n", opt.debug);
+        for( i=0; i < opt.threadsched.n; i++){
+            printf("    --threadsched %s:%s:%d:%d\n", opt.threadsched.entry[i].name,
+                rtsched_policyname(opt.threadsched.entry[i].policy), opt.threadsched.entry[i].prio, opt.threadsched.entry[i].cpu);
+        }
         printf("  hostname %s\n", opt.hostname);
     }
 
@@ -341,6 +378,8 @@ int * measuring(int * fdp)
 struct datasenderarg {
     int socket;
     struct timespec precision;
+    int schedpolicy; /* of the measuring thread */
+    int schedprio;
 };
 
 int * datasender(struct datasenderarg * dsp)
@@ -350,6 +389,11 @@ int * datasender(struct datasenderarg * dsp)
     size_t i;
     struct datablock mydatablock;
     struct messageblock mymessageblock;
+    uint64_t mac;
+    uint64_t sequence = 0;
+    /* the messageblock and the optional MAC trailer, see --authkeyfile */
+    struct iovec iov[2] = { {&mymessageblock, sizeof(mymessageblock)}, {&mac, FSLATENCY_MAC_LEN}};
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = NULL == opt.authkeyfile ? 1 : 2};
     mydatablock.measurementcount =0;
     mydatablock.starttime.tv_sec = 0;
     mydatablock.starttime.tv_nsec = 0;
@@ -366,6 +410,8 @@ int * datasender(struct datasenderarg * dsp)
     mymessageblock.major = FSLATENCY_VERSION_MAJOR;
     mymessageblock.minor = FSLATENCY_VERSION_MINOR;
     mymessageblock.precision = dsp->precision;
+    mymessageblock.schedpolicy = dsp->schedpolicy;
+    mymessageblock.schedprio = dsp->schedprio;
     for(i=0; i < FSLATENCY_DATABLOCKARRAY_LEN; i++){
         mymessageblock.datablockarray[i] = mydatablock;
     }
@@ -424,7 +470,11 @@ int * datasender(struct datasenderarg * dsp)
         if( opt.debug){
             datablock_print( &mydatablock);
         }
-        retval = send(dsp->socket, &mymessageblock, sizeof(mymessageblock), MSG_NOSIGNAL);
+        mymessageblock.sequence = ++sequence;
+        if( NULL != opt.authkeyfile){
+            mac = siphash24(&mymessageblock, sizeof(mymessageblock), authkey);
+        }
+        retval = sendmsg(dsp->socket, &msg, MSG_NOSIGNAL);
         if( -1 == retval ){
             if( opt.debug){
                 perror("Warning: error in udp send()");
@@ -453,6 +503,7 @@ int main(int argc, char * argv[])
     struct datasenderarg dsarg;
     struct sockaddr_in clientsockstruct;
     pthread_t measuringthread, datasenderthread;
+    struct sched_param param;
 
     /* parameter processing */
     init_opt();
@@ -531,13 +582,20 @@ int main(int argc, char * argv[])
 
     /* starting threads */
 
-    retval = pthread_create(&measuringthread, NULL, (void * (*)(void *)) &measuring, &fd);
+    retval = rtsched_create(&opt.threadsched, "measuring", &measuringthread, (void * (*)(void *)) &measuring, &fd);
     if( 0 != retval){
         dprintf(2 /*stderr*/, "Error: cannot create measuring thread. Errno:%d\n", retval);
         return 2;
     }
+    /* the real one goes to the data processor, so it knows how far the latency numbers can be trusted */
+    retval = pthread_getschedparam(measuringthread, &(dsarg.schedpolicy), &param);
+    if( 0 != retval){
+        dsarg.schedpolicy = SCHED_OTHER;
+        param.sched_priority = 0;
+    }
+    dsarg.schedprio = param.sched_priority;
     if( opt.debug ){
-        printf("DEBUG measuring thread started\n");
+        printf("DEBUG measuring thread started, scheduling %s:%d\n", rtsched_policyname(dsarg.schedpolicy), dsarg.schedprio);
     }
 
     clock_getres(CLOCK_REALTIME, &(dsarg.precision));
@@ -545,8 +603,7 @@ int main(int argc, char * argv[])
         printf("DEBUG Time measuring precision: %ld nanoseconds\n", dsarg.precision.tv_nsec);
     }
     dsarg.socket = sfd;
-    retval = pthread_create(&datasenderthread,
-                            NULL,
+    retval = rtsched_create(&opt.threadsched, "datasender", &datasenderthread,
                             (void * (*)(void *)) &datasender,
                             &dsarg);
     if( 0 != retval){
@@ -38,6 +38,9 @@
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <sys/time.h>
 #include <pthread.h>
 #include <sys/vfs.h>
 #include <sys/mman.h>
@@ -47,9 +50,26 @@
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <math.h>
+#include <linux/filter.h>
+#include <linux/sock_diag.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 #include "datablock.h"
+#include "msgview.h"
+#include "arena.h"
 #include "nameregistry.h"
+#include "timerwheel.h"
+#include "statusscan.h"
+#include "logring.h"
+#include "rtsched.h"
+#include "siphash.h"
+#include "ratelimit.h"
+#include "detector.h"
+#include "fleet.h"
+#include "history.h"
+#include "rules.h"
+#include "slo.h"
 
 
 #ifdef DEBUG
@@ -92,8 +112,11 @@ static int my_pthread_mutex_init(pthread_mutex_t *mutex, const  pthread_mutexatt
 #define ALARM_NOALARM 0
 #define ALARM_STATISTICALALARM_LOW 1
 #define ALARM_STATISTICALALARM_HIGH 2
+#define ALARM_STATISTICALALARM_DRIFT 64  /* slow degradation, see drift_check() */
 #define ALARM_STATISTICALALARM_EMPTYDATABLOCK 4
 #define ALARM_UDPTIMEOUT 8
+#define ALARM_UDPTIMEOUT_NET 16   /* set beside ALARM_UDPTIMEOUT when the client is back, see seq_note() */
+#define ALARM_UDPTIMEOUT_STALL 32
 
 
 /*
@@ -117,16 +140,6 @@ static inline int timespec_gt(const struct timespec *left, const struct timespec
 }
 
 
-/*
-**  timespec_zero(left)
-**      return 1(true) if left is zero
-*/
-static inline int timespec_zero(const struct timespec *left)
-{
-    return ( left->tv_sec == 0) && (left->tv_nsec == 0);
-}
-
-
 /*
 ** command-line option processing.
 ** There is a static, global opt struct.
@@ -146,7 +159,31 @@ static inline int timespec_zero(const struct timespec *left)
 #define OPT_GRAPHITEBASE 12
 #define OPT_GRAPHITEIP 13
 #define OPT_GRAPHITEPORT 14
-
+#define OPT_CLIENTLIMIT 15
+#define OPT_AUTHKEYFILE 16
+#define OPT_SOURCERATE 17
+#define OPT_CLIENTRATE 18
+#define OPT_REGISTRATIONRATE 19
+#define OPT_SEGMENTPREFIX 20
+#define OPT_UDPTIMEOUTMIN 21
+#define OPT_UDPTIMEOUTMAX 22
+#define OPT_DETECTOR 23
+#define OPT_MADTHRESHOLDFACTOR 24
+#define OPT_MADMINSCALE 25
+#define OPT_RECORDFILE 26
+#define OPT_DRIFTFACTOR 27
+#define OPT_PROFILEQUANTILE 28
+#define OPT_GROUPBY 29
+#define OPT_GROUPQUORUM 30
+#define OPT_SLO 31
+#define OPT_HISTORYMB 32
+#define OPT_HEATMAP 33
+#define OPT_RULESFILE 34
+#define OPT_EVENTRATE 35
+
+#define OPT_THREADSCHED 96
+#define OPT_EVENTLOOP 97
+#define OPT_NOFILTER 98
 #define OPT_NOMEMLOCK 99
 #define OPT_DEBUG 100
 #define OPT_VERSION 101
@@ -156,61 +193,157 @@ struct option myoptions[] = {
  { "bind", 1, NULL, OPT_BIND},
  { "port", 1, NULL, OPT_PORT},
  { "maxclient", 1, NULL, OPT_MAXCLIENT},
+ { "clientlimit", 1, NULL, OPT_CLIENTLIMIT},
  { "timetoforget", 1, NULL, OPT_TIMETOFORGET},
  { "udptimeout", 1, NULL, OPT_UDPTIMEOUT},
+ { "udptimeoutmin", 1, NULL, OPT_UDPTIMEOUTMIN},
+ { "udptimeoutmax", 1, NULL, OPT_UDPTIMEOUTMAX},
  { "alarmtimeout", 1, NULL, OPT_ALARMTIMEOUT},
  { "statusperiod", 1, NULL, OPT_STATUSPERIOD},
  { "alarmstatusperiod", 1, NULL, OPT_ALARMSTATUSPERIOD},
  { "latencythresholdfactor", 1, NULL, OPT_LATENCYTHRESHOLDFACTOR},
+ { "detector", 1, NULL, OPT_DETECTOR},
+ { "madthresholdfactor", 1, NULL, OPT_MADTHRESHOLDFACTOR},
+ { "madminscale", 1, NULL, OPT_MADMINSCALE},
+ { "recordfile", 1, NULL, OPT_RECORDFILE},
+ { "driftfactor", 1, NULL, OPT_DRIFTFACTOR},
+ { "profilequantile", 1, NULL, OPT_PROFILEQUANTILE},
+ { "groupby", 1, NULL, OPT_GROUPBY},
+ { "groupquorum", 1, NULL, OPT_GROUPQUORUM},
+ { "slo", 1, NULL, OPT_SLO},
+ { "historymb", 1, NULL, OPT_HISTORYMB},
+ { "heatmap", 1, NULL, OPT_HEATMAP},
+ { "rulesfile", 1, NULL, OPT_RULESFILE},
+ { "eventrate", 1, NULL, OPT_EVENTRATE},
  { "rollingwindow", 1,  NULL, OPT_ROLLINGWINDOW},
  { "minimummeasurementcount", 1, NULL, OPT_MINIMUMMEASUREMENTCOUNT},
  { "graphitebase", 1, NULL, OPT_GRAPHITEBASE},
  { "graphiteip", 1, NULL, OPT_GRAPHITEIP},
  { "graphiteport", 1, NULL, OPT_GRAPHITEPORT},
+ { "authkeyfile", 1, NULL, OPT_AUTHKEYFILE},
+ { "sourcerate", 1, NULL, OPT_SOURCERATE},
+ { "clientrate", 1, NULL, OPT_CLIENTRATE},
+ { "registrationrate", 1, NULL, OPT_REGISTRATIONRATE},
+ { "segmentprefix", 1, NULL, OPT_SEGMENTPREFIX},
+ { "threadsched", 1, NULL, OPT_THREADSCHED},
+ { "eventloop", 0, NULL, OPT_EVENTLOOP},
+ { "nofilter", 0, NULL, OPT_NOFILTER},
  { "nomemlock", 0, NULL, OPT_NOMEMLOCK},
  { "debug", optional_argument , NULL, OPT_DEBUG},
  { "version", 0, NULL, OPT_VERSION},
  { NULL, 0, NULL, 0}
 };
 
+/* --groupby, see groups */
+#define GROUPBY_NONE 0
+#define GROUPBY_TEXT 1        /* the first word of the text */
+#define GROUPBY_HOSTPREFIX 2  /* the hostname before the first dot, without the trailing digits and - or _ */
+
+static const char * const groupbynames[] = { "none", "text", "hostprefix", NULL };
+
+/* --heatmap, see heatmap */
+#define HEATMAP_NONE 0
+#define HEATMAP_CLIENT 1
+#define HEATMAP_GROUP 2
+#define HEATMAP_BUCKETS 16
+#define HEATMAP_LOW_LOG2_US 6  /* the first bucket is up to 64 usec, the next ones double, the last is unlimited */
+
+static const char * const heatmapnames[] = { "none", "client", "group", NULL };
+
 
 static struct _opt {
     char * bind;
     unsigned short int port;
-    int maxclient;
+    int maxclient;   /* initial size of the client table, see clienttable_grow() */
+    int clientlimit; /* the client table never grows above */
     int timetoforget;
-    int udptimeout;
+    int udptimeout;       /* until the inter-arrival estimate of the client is ready, see iat_note() */
+    int udptimeoutmin;    /* the clamp of the adaptive udptimeout */
+    int udptimeoutmax;
     int alarmtimeout;
     int statusperiod;
     int alarmstatusperiod;
     double latencythresholdfactor;
+    int detector;         /* DETECTOR_MEANSTD or DETECTOR_MAD, see detector.h */
+    double madthresholdfactor;
+    double madminscale;   /* ln(ms), the lower limit of the scaled MAD */
+    char * recordfile;    /* the new datablocks are written here for eval_detector */
+    double driftfactor;   /* latency ratio of the drift alarm, 0: off */
+    double profilequantile; /* of the long term profile, the high alarm needs the max above it too. 0: off */
+    int groupby;          /* GROUPBY_*, see groups */
+    double groupquorum;   /* the part of the group for a group alarm */
+    double slo;           /* ms, a second (datablock) with a higher max is bad. 0: off. See slo.h */
+    int historymb;        /* the pool of the compressed history, 0: off. See history.h */
+    int heatmap;          /* HEATMAP_*, see heatmap */
+    char * rulesfile;     /* the detection profiles of the clients, see rules.h */
+    int eventrate;        /* alarm transition lines per second, 0: off. See alarm events */
     int rollingwindow;
     int minimummeasurementcount;
     char * graphitebase;
     char * graphiteip;
     unsigned short int graphiteport;
     struct sockaddr_in graphiteaddr;
+    char * authkeyfile;
+    int sourcerate;       /* packets/s per source address, 0: unlimited */
+    int clientrate;       /* packets/s per client */
+    int registrationrate; /* new clients/s */
+    int segmentprefix;    /* bits of the network segment of the lost clients report */
+    struct rtsched threadsched;
+    unsigned int eventloop;
+    unsigned int nofilter;
     unsigned int nomemlock;
     unsigned int debug;
 } opt;
 
+static uint8_t authkey[SIPHASH_KEY_LEN]; /* of --authkeyfile, read once by parse_opt() */
+static int recordfd = -1; /* --recordfile, opened by parse_opt() */
+static struct rules rulesdb; /* the profiles of --rulesfile and the command line, read once by parse_opt() */
+
+/* for --threadsched. The receiver is the main thread */
+static const char * const threadnames[] = { "receiver", "timer", "statistical", "alarmstatus", "normalstatus",
+                                            "graphite", "logwriter", "history", NULL};
+
 
 static void init_opt(void)
 {
     opt.bind = "0.0.0.0";
     opt.port = 57005;
     opt.maxclient = 509;
+    opt.clientlimit = 65521;
     opt.timetoforget = 600;
     opt.udptimeout = 3;
+    opt.udptimeoutmin = 1;
+    opt.udptimeoutmax = 10;
     opt.statusperiod = 300;
     opt.alarmstatusperiod = 1;
     opt.alarmtimeout = 8;
     opt.latencythresholdfactor = 15.0;
+    opt.detector = DETECTOR_MEANSTD;
+    opt.madthresholdfactor = 12.0;
+    opt.madminscale = 0.4;
+    opt.recordfile = NULL;
+    opt.driftfactor = 2.0;
+    opt.profilequantile = 0.0;
+    opt.groupby = GROUPBY_NONE;
+    opt.groupquorum = 0.5;
+    opt.slo = 0.0;
+    opt.historymb = 0;
+    opt.heatmap = HEATMAP_NONE;
+    opt.rulesfile = NULL;
+    opt.eventrate = 0;
     opt.rollingwindow = 60;
     opt.minimummeasurementcount = 60;
     opt.graphitebase = NULL;
     opt.graphiteip = NULL;
     opt.graphiteport = 2003;
+    opt.authkeyfile = NULL;
+    opt.sourcerate = 1000;
+    opt.clientrate = 5;
+    opt.registrationrate = 100;
+    opt.segmentprefix = 24;
+    opt.threadsched.n = 0;
+    opt.eventloop = 0; /*False*/
+    opt.nofilter = 0; /*False*/
     opt.nomemlock = 0; /*False*/
     opt.debug = 0; /*False*/
 }
@@ -219,17 +352,30 @@ static void init_opt(void)
 void help()
 {   /*   "01234567890123456789012345678901234567890123456789012345678901234567890123456789" */
     puts("Usage: fslatency_server [--bind a.b.c.d] [--port PORT] [--maxclient 509]");
-    puts("   [--timetoforget 600] [--udptimeout 3] [--alarmstatusperiod 1]");
+    puts("   [--clientlimit 65521] [--timetoforget 600] [--udptimeout 3] [--udptimeoutmin 1] [--udptimeoutmax 10]");
+    puts("   [--alarmstatusperiod 1]");
     puts("   [--statusperiod 300] [--alarmtimeout 8] [--latencythresholdfactor 15.0]");
+    puts("   [--detector meanstd|mad] [--madthresholdfactor 12.0] [--madminscale 0.4] [--recordfile PATH]");
+    puts("   [--driftfactor 2.0]");
+    puts("   [--profilequantile 0] [--groupby none|text|hostprefix] [--groupquorum 0.5] [--slo 0]");
+    puts("   [--historymb 0] [--heatmap none|client|group] [--rulesfile PATH] [--eventrate 0]");
     puts("   [--rollingwindow 60] [--minimummeasurementcount 60]");
     puts("   [--graphitebase metric.path.base --graphiteip 1.2.3.4 [--graphiteport 2003]]");
-    puts("   [--nomemlock] [--debug[=1]] [--version]");
+    puts("   [--sourcerate 1000] [--clientrate 5] [--registrationrate 100] [--segmentprefix 24]");
+    puts("   [--authkeyfile PATH] [--threadsched NAME:POLICY:PRIO[:CPU]]... [--eventloop]");
+    puts("   [--nofilter] [--nomemlock]");
+    puts("   [--debug[=1]] [--version]");
+    puts("   threads: receiver, timer, statistical, alarmstatus, normalstatus, graphite, logwriter, history");
+    puts("   policies: fifo, rr, other");
 }
 
 
 static int parse_opt(int argc, char * argv[])
 {
+    struct rules_profile profile;
     int optcode;
+    int retval;
+    int i;
 
     /* parameter processing */
     /* --ip a.b.c.d --port PORT --text "FOO" --file  "path" */
@@ -248,12 +394,21 @@ static int parse_opt(int argc, char * argv[])
             case OPT_MAXCLIENT:
                 opt.maxclient = atoi(optarg);
                 break;
+            case OPT_CLIENTLIMIT:
+                opt.clientlimit = atoi(optarg);
+                break;
             case OPT_TIMETOFORGET:
                 opt.timetoforget = atoi(optarg);
                 break;
             case OPT_UDPTIMEOUT:
                 opt.udptimeout = atoi(optarg);
                 break;
+            case OPT_UDPTIMEOUTMIN:
+                opt.udptimeoutmin = atoi(optarg);
+                break;
+            case OPT_UDPTIMEOUTMAX:
+                opt.udptimeoutmax = atoi(optarg);
+                break;
             case OPT_ALARMTIMEOUT:
                 opt.alarmtimeout = atoi(optarg);
                 break;
@@ -266,6 +421,51 @@ static int parse_opt(int argc, char * argv[])
             case OPT_LATENCYTHRESHOLDFACTOR:
                 opt.latencythresholdfactor =  atof(optarg);
                 break;
+            case OPT_DETECTOR:
+                opt.detector = detector_parse(optarg);
+                break;
+            case OPT_MADTHRESHOLDFACTOR:
+                opt.madthresholdfactor = atof(optarg);
+                break;
+            case OPT_MADMINSCALE:
+                opt.madminscale = atof(optarg);
+                break;
+            case OPT_RECORDFILE:
+                opt.recordfile = strdup(optarg);
+                break;
+            case OPT_DRIFTFACTOR:
+                opt.driftfactor = atof(optarg);
+                break;
+            case OPT_PROFILEQUANTILE:
+                opt.profilequantile = atof(optarg);
+                break;
+            case OPT_GROUPBY:
+                for( opt.groupby = 0; NULL != groupbynames[opt.groupby] && 0 != strcmp(optarg, groupbynames[opt.groupby]); opt.groupby ++){
+                    ;
+                }
+                if( NULL == groupbynames[opt.groupby]){
+                    dprintf(2 /*stderr*/, "Error: invalid groupby (none, text or hostprefix)\n");
+                    return 2;
+                }
+                break;
+            case OPT_GROUPQUORUM:
+                opt.groupquorum = atof(optarg);
+                break;
+            case OPT_SLO:
+                opt.slo = atof(optarg);
+                break;
+            case OPT_HISTORYMB:
+                opt.historymb = atoi(optarg);
+                break;
+            case OPT_HEATMAP:
+                for( opt.heatmap = 0; NULL != heatmapnames[opt.heatmap] && 0 != strcmp(optarg, heatmapnames[opt.heatmap]); opt.heatmap ++){
+                    ;
+                }
+                if( NULL == heatmapnames[opt.heatmap]){
+                    dprintf(2 /*stderr*/, "Error: invalid heatmap (none, client or group)\n");
+                    return 2;
+                }
+                break;
             case OPT_ROLLINGWINDOW:
                 opt.rollingwindow = atoi(optarg);
                 break;
@@ -281,6 +481,40 @@ static int parse_opt(int argc, char * argv[])
             case OPT_GRAPHITEPORT:
                 opt.graphiteport = atoi(optarg);
                 break;
+            case OPT_THREADSCHED:
+                if( 0 != rtsched_add(&opt.threadsched, optarg, threadnames)){
+                    dprintf(2 /*stderr*/, "Error: invalid --threadsched \"%s\"\n", optarg);
+                    help();
+                    return 2;
+                }
+                break;
+            case OPT_AUTHKEYFILE:
+                opt.authkeyfile = strdup(optarg);
+                break;
+            case OPT_RULESFILE:
+                opt.rulesfile = strdup(optarg);
+                break;
+            case OPT_EVENTRATE:
+                opt.eventrate = atoi(optarg);
+                break;
+            case OPT_SOURCERATE:
+                opt.sourcerate = atoi(optarg);
+                break;
+            case OPT_CLIENTRATE:
+                opt.clientrate = atoi(optarg);
+                break;
+            case OPT_REGISTRATIONRATE:
+                opt.registrationrate = atoi(optarg);
+                break;
+            case OPT_SEGMENTPREFIX:
+                opt.segmentprefix = atoi(optarg);
+                break;
+            case OPT_EVENTLOOP:
+                opt.eventloop = 1;
+                break;
+            case OPT_NOFILTER:
+                opt.nofilter = 1;
+                break;
             case OPT_NOMEMLOCK:
                 opt.nomemlock = 1;
                 break;
@@ -306,18 +540,26 @@ static int parse_opt(int argc, char * argv[])
         dprintf(2 /*stderr*/, "Error: invalid port number\n");
         return 2;
     }
-    if( 0 == opt.maxclient){
+    if( 0 >= opt.maxclient){
         dprintf(2 /*stderr*/, "Error: invalid maxclient number\n");
         return 2;
     }
-    if( (3 > opt.timetoforget) || (opt.udptimeout >= opt.timetoforget)) {
-        dprintf(2 /*stderr*/, "Error: invalid timetoforget number (min 3 and must be greather than udptimeout)\n");
+    if( opt.maxclient > opt.clientlimit || 1048573 < opt.clientlimit){
+        dprintf(2 /*stderr*/, "Error: invalid clientlimit number (min maxclient, max 1048573)\n");
+        return 2;
+    }
+    if( (3 > opt.timetoforget) || (opt.udptimeout >= opt.timetoforget) || (opt.udptimeoutmax >= opt.timetoforget)) {
+        dprintf(2 /*stderr*/, "Error: invalid timetoforget number (min 3 and must be greather than udptimeout and udptimeoutmax)\n");
         return 2;
     }
     if( 2 > opt.udptimeout){
         dprintf(2 /*stderr*/, "Error: invalid udptimeout number (min 2)\n");
         return 2;
     }
+    if( 1 > opt.udptimeoutmin || opt.udptimeoutmin > opt.udptimeout || opt.udptimeout > opt.udptimeoutmax){
+        dprintf(2 /*stderr*/, "Error: invalid udptimeoutmin or udptimeoutmax number (1 <= udptimeoutmin <= udptimeout <= udptimeoutmax)\n");
+        return 2;
+    }
     if( 0 == opt.alarmtimeout){
         dprintf(2 /*stderr*/, "Error: invalid alarmtimeout number\n");
         return 2;
@@ -334,8 +576,40 @@ static int parse_opt(int argc, char * argv[])
         dprintf(2 /*stderr*/, "Error: invalid latencythresholdfactor value (must be positive float)\n");
         return 2;
     }
-    if( 8 > opt.rollingwindow){
-        dprintf(2 /*stderr*/, "Error: invalid rollingwindow number. Min 8.\n");
+    if( -1 == opt.detector){
+        dprintf(2 /*stderr*/, "Error: invalid detector (meanstd or mad)\n");
+        return 2;
+    }
+    if( 0.0 >= opt.madthresholdfactor || 0.0 > opt.madminscale){
+        dprintf(2 /*stderr*/, "Error: invalid madthresholdfactor or madminscale value (must be positive float)\n");
+        return 2;
+    }
+    if( 0.0 != opt.driftfactor && 1.0 >= opt.driftfactor){
+        dprintf(2 /*stderr*/, "Error: invalid driftfactor value (greater than 1.0, or 0: off)\n");
+        return 2;
+    }
+    if( 0.0 > opt.profilequantile || 1.0 <= opt.profilequantile){
+        dprintf(2 /*stderr*/, "Error: invalid profilequantile value (0 - 1, 0: off)\n");
+        return 2;
+    }
+    if( 0.0 >= opt.groupquorum || 1.0 < opt.groupquorum){
+        dprintf(2 /*stderr*/, "Error: invalid groupquorum value (0 - 1)\n");
+        return 2;
+    }
+    if( 0.0 > opt.slo){
+        dprintf(2 /*stderr*/, "Error: invalid slo value (ms, 0: off)\n");
+        return 2;
+    }
+    if( 0 > opt.historymb || 65536 < opt.historymb){
+        dprintf(2 /*stderr*/, "Error: invalid historymb value. Max 65536, 0: off.\n");
+        return 2;
+    }
+    if( NULL != opt.recordfile && -1 == (recordfd = open(opt.recordfile, O_WRONLY | O_CREAT | O_APPEND, 0644))){
+        dprintf(2 /*stderr*/, "Error: cannot open --recordfile \"%s\". Errno:%d\n", opt.recordfile, errno);
+        return 2;
+    }
+    if( 8 > opt.rollingwindow || 65535 < opt.rollingwindow){
+        dprintf(2 /*stderr*/, "Error: invalid rollingwindow number. Min 8, max 65535.\n");
         return 2;
     }
     if( (opt.rollingwindow-1) *9 < opt.minimummeasurementcount){
@@ -348,6 +622,44 @@ static int parse_opt(int argc, char * argv[])
     if( NULL == opt.graphitebase && NULL != opt.graphiteip){
         dprintf(2 /*stderr*/, "Warning: you should not specify --graphiteip when no graphite base string (--graphitebase)\n");
     }
+    if( HEATMAP_NONE != opt.heatmap && NULL == opt.graphitebase){
+        dprintf(2 /*stderr*/, "Error: the heatmap is sent to graphite, it needs --graphitebase\n");
+        return 2;
+    }
+    if( HEATMAP_GROUP == opt.heatmap && GROUPBY_NONE == opt.groupby){
+        dprintf(2 /*stderr*/, "Error: --heatmap group needs --groupby\n");
+        return 2;
+    }
+    if( 0 > opt.eventrate){
+        dprintf(2 /*stderr*/, "Error: invalid eventrate (0: off)\n");
+        return 2;
+    }
+    if( 0 > opt.sourcerate || 0 > opt.clientrate || 0 > opt.registrationrate){
+        dprintf(2 /*stderr*/, "Error: invalid sourcerate, clientrate or registrationrate (0: unlimited)\n");
+        return 2;
+    }
+    if( 0 > opt.segmentprefix || 32 < opt.segmentprefix){
+        dprintf(2 /*stderr*/, "Error: invalid segmentprefix number (0-32)\n");
+        return 2;
+    }
+    if( NULL != opt.authkeyfile && 0 != siphash_readkey(opt.authkeyfile, authkey)){
+        dprintf(2 /*stderr*/, "Error: cannot read the key (32 hex digits) from --authkeyfile \"%s\"\n", opt.authkeyfile);
+        return 2;
+    }
+    profile.latencythresholdfactor = opt.latencythresholdfactor;
+    profile.madthresholdfactor = opt.madthresholdfactor;
+    profile.minimummeasurementcount = opt.minimummeasurementcount;
+    profile.rollingwindow = opt.rollingwindow;
+    rules_init(&rulesdb, &profile);
+    if( NULL != opt.rulesfile && 0 != (retval = rules_read(&rulesdb, opt.rulesfile))){
+        if( 0 > retval){
+            dprintf(2 /*stderr*/, "Error: cannot open --rulesfile \"%s\"\n", opt.rulesfile);
+        } else {
+            dprintf(2 /*stderr*/, "Error: invalid rule in --rulesfile \"%s\" line %d (or more than %d rules)\n",
+                opt.rulesfile, retval, RULES_MAX - 1);
+        }
+        return 2;
+    }
 
 
 
@@ -356,16 +668,49 @@ static int parse_opt(int argc, char * argv[])
         dprintf(2, "    --bind                    %s\n", opt.bind);
         dprintf(2, "    --port                    %u\n", opt.port);
         dprintf(2, "    --maxclient               %d\n", opt.maxclient);
+        dprintf(2, "    --clientlimit             %d\n", opt.clientlimit);
         dprintf(2, "    --timetoforget            %d\n", opt.timetoforget);
         dprintf(2, "    --udptimeout              %d\n", opt.udptimeout);
+        dprintf(2, "    --udptimeoutmin           %d\n", opt.udptimeoutmin);
+        dprintf(2, "    --udptimeoutmax           %d\n", opt.udptimeoutmax);
         dprintf(2, "    --alarmtimeout            %d\n", opt.alarmtimeout);
         dprintf(2, "    --statusperiod            %d\n", opt.statusperiod);
         dprintf(2, "    --alarmstatusperiod       %d\n", opt.alarmstatusperiod);
         dprintf(2, "    --latencythresholdfactor  %f\n", opt.latencythresholdfactor);
+        dprintf(2, "    --detector                %s\n", detector_name(opt.detector));
+        dprintf(2, "    --madthresholdfactor      %f\n", opt.madthresholdfactor);
+        dprintf(2, "    --madminscale             %f\n", opt.madminscale);
+        dprintf(2, "    --recordfile              %s\n", opt.recordfile);
+        dprintf(2, "    --driftfactor             %f\n", opt.driftfactor);
+        dprintf(2, "    --profilequantile         %f\n", opt.profilequantile);
+        dprintf(2, "    --groupby                 %s\n", groupbynames[opt.groupby]);
+        dprintf(2, "    --groupquorum             %f\n", opt.groupquorum);
+        dprintf(2, "    --slo                     %f\n", opt.slo);
+        dprintf(2, "    --historymb               %d\n", opt.historymb);
+        dprintf(2, "    --heatmap                 %s\n", heatmapnames[opt.heatmap]);
+        dprintf(2, "    --rulesfile               %s\n", opt.rulesfile);
+        dprintf(2, "    --eventrate               %d\n", opt.eventrate);
+        for( i=1; i < rulesdb.n; i++){
+            dprintf(2, "        profile %d: %s %.*s latencythresholdfactor=%f madthresholdfactor=%f"
+                " minimummeasurementcount=%d rollingwindow=%d\n", i, RULES_HOST == rulesdb.prefix[i].field ? "host" : "text",
+                (int) rulesdb.prefix[i].len, rulesdb.prefix[i].prefix, rulesdb.profile[i].latencythresholdfactor,
+                rulesdb.profile[i].madthresholdfactor, rulesdb.profile[i].minimummeasurementcount, rulesdb.profile[i].rollingwindow);
+        }
         dprintf(2, "    --rollingwindow           %d\n", opt.rollingwindow);
         dprintf(2, "    --graphitebase            %s\n", opt.graphitebase);
         dprintf(2, "    --graphiteip              %s\n", opt.graphiteip);
         dprintf(2, "    --graphiteport            %u\n", opt.graphiteport);
+        dprintf(2, "    --authkeyfile             %s\n", opt.authkeyfile);
+        dprintf(2, "    --sourcerate              %d\n", opt.sourcerate);
+        dprintf(2, "    --clientrate              %d\n", opt.clientrate);
+        dprintf(2, "    --registrationrate        %d\n", opt.registrationrate);
+        dprintf(2, "    --segmentprefix           %d\n", opt.segmentprefix);
+        for( i=0; i < opt.threadsched.n; i++){
+            dprintf(2, "    --threadsched             %s:%s:%d:%d\n", opt.threadsched.entry[i].name,
+                rtsched_policyname(opt.threadsched.entry[i].policy), opt.threadsched.entry[i].prio, opt.threadsched.entry[i].cpu);
+        }
+        dprintf(2, "    --eventloop %d\n", opt.eventloop);
+        dprintf(2, "    --nofilter %d\n", opt.nofilter);
         dprintf(2, "    --nomemlock %d\n", opt.nomemlock);
         dprintf(2, "    --debug %d\n", opt.debug);
     }
@@ -374,6 +719,46 @@ static int parse_opt(int argc, char * argv[])
 }
 
 
+/*
+** logdb: the output of the threads (status lines, Info, Notice, Warning and DEBUG lines)
+**   The lines are formatted into a lock-free ring, and the logwriter thread writes them out.
+**   Nobody blocks on a slow stdout or stderr, even under a lock: if the ring is full, the line
+**   is dropped and counted (logdrops in the status lines). The startup messages of main() are
+**   written directly.
+*/
+
+#define LOGRING_CAPACITY 1024  /* records of 512 bytes */
+
+static struct logring logdb;
+
+#define logprintf(fd, ...) logring_printf(&logdb, (fd), __VA_ARGS__)
+
+
+/*
+** loglist_append
+**   appends an entry of a list to a status line of len characters in a LOGRING_TEXTLEN buffer,
+**   if the line still fits in a log record with its newline. If not, the line gets " ..." and -1
+**   is returned: the list is cut between two entries, not in the middle of one.
+*/
+#define LOGLIST_MORE " ..."
+
+static int loglist_append(char * line, int * len, const char * entry)
+{
+    size_t entrylen = strlen(entry);
+
+    if( *len + entrylen + sizeof(LOGLIST_MORE) + 1 > LOGRING_TEXTLEN){ /* + the newline, the \0 is in sizeof */
+        if( *len + sizeof(LOGLIST_MORE) < LOGRING_TEXTLEN){
+            memcpy(line + *len, LOGLIST_MORE, sizeof(LOGLIST_MORE));
+            *len += sizeof(LOGLIST_MORE) - 1;
+        }
+        return -1;
+    }
+    memcpy(line + *len, entry, entrylen + 1);
+    *len += entrylen;
+    return 0;
+}
+
+
 /*
 ** databases: namedb and statusdb
 **   some static global variables and functions
@@ -393,671 +778,2934 @@ static pthread_cond_t global_alarmstatus_cond;  /* see alarmstatus_loop() */
 static pthread_cond_t global_normalstatus_cond; /* see normalstatus_loop() */
 
 
-#define RINGBUFFER_ENTRY_TYPE struct datablock
-#include "ringbuffer.inc"  /* ringbuffer.inc is a C surce code that implements a template typed ringbuffer */
+/*
+** storedblock: the compact form of a datablock in the rolling window of a client.
+**   Only the aggregates of the alarmer, in float32: 20 bytes instead of the 72 of struct datablock.
+**   The start time is kept only for the newest one (statusentry.laststart), that is enough to order
+**   the incoming datablocks.
+*/
+struct storedblock {
+    uint32_t measurementcount;
+    float min;
+    float max;
+    float sumx;
+    float sumxx;
+};
 
 
+/*
+** statusentry
+**   the rolling window of the client is a ring of opt.rollingwindow storedblocks in ringdb,
+**   at the offset msgid * opt.rollingwindow. See window_add()
+*/
 struct statusentry {
-    uint32_t alarm;
-    struct timespec lastalarmtime;
-    struct timespec lastarrival;
-    struct ringbuffer datablockbuffer;
     pthread_mutex_t mutex;
+    struct timespec laststart; /* starttime of the newest datablock in the window */
+    uint16_t start;            /* the oldest storedblock of the ring */
+    uint16_t len;              /* number of storedblocks in the ring */
+    int alarmcounted; /* bool: this entry is counted in global_alarmedclients */
+    uint16_t schedpolicy; /* of the measuring thread of the agent, see sched_note() */
+    uint16_t schedprio;
+    uint64_t lastseq;     /* the highest sequence number, see seq_note() */
+    uint64_t seqmask;     /* bit i: lastseq - i arrived */
+    unsigned long lost;   /* packets, since the client was added */
+    unsigned long reordered;
+    uint64_t windowseq;   /* start of the lossy check */
+    unsigned int windowlost;
+    uint32_t iatmean;     /* packet inter-arrival time, ticks * 8, see iat_note() */
+    uint32_t iatdev;      /* mean deviation of it, ticks * 4 */
+    uint32_t iatsamples;
+    uint32_t udptimeout;  /* the current udptimeout of the client in ticks */
+    uint16_t boundsage;   /* datablocks since the mad bounds were calculated, see mad_bounds() */
+    uint8_t rule;         /* the detection profile in rulesdb, set when the client is added */
+    struct tokenbucket eventbucket; /* of the alarm events, see alarm_event() */
+    uint32_t eventsuppressed;  /* alarm events of the client dropped by the limits since its last one */
+    struct drift drift;   /* see drift_check() */
+    struct profile profile; /* the datablock maximums of hours, see window_add() and statistical_alarmer() */
+    int group;            /* in groupdb, GROUP_NONE if none. See groups */
+    struct slo slo;       /* the good and bad seconds of the last hour and day, see window_add() */
+    struct history_writer history; /* see history_note() */
+    uint16_t heatmap[HEATMAP_BUCKETS]; /* datablocks by max latency since the last graphite period, see heatmap */
+    uint64_t grouphit;    /* 1 + the second its starting alarm was counted in its group */
 };
 
 
 static struct statusentry * statusdb;
 
 
-static void statusentry_init(struct statusentry * sep)
+/*
+** hotdb: the hot per-client fields in structure-of-arrays layout, indexed by msgid.
+**   written under the lock of the statusdb entry. The scan loops (statistical alarmer,
+**   status reports, graphite) read these arrays without lock via the statusscan kernels.
+*/
+static struct {
+    uint32_t * alarm;
+    uint64_t * lastarrival;  /* timer tick of the last packet. 0 == empty slot */
+    struct statusscan_window window;  /* rolling window statistics, see window_add() */
+    uint8_t * verdict;       /* scratch array of the statistical alarmer */
+    uint32_t * srcaddr;      /* IPv4 source address of the last packet (network order), see lost_segments() */
+    double * boundlo;        /* bounds of the mad detector, see mad_bounds() */
+    double * boundhi;
+} hotdb;
+
+
+/*
+** timers: timerdb
+**   every client has TIMER_KINDS timers in a single timer wheel. timer id = msgid * TIMER_KINDS + kind
+**   the receiver re-arms the udptimeout and timetoforget timers on each packet,
+**   alarm_set() re-arms the alarmsilencer timer. See timer_loop()
+*/
+
+#define TIMER_TICK_MS 100  /* timer resolution */
+#define TIMER_UDPTIMEOUT 0
+#define TIMER_TIMETOFORGET 1
+#define TIMER_ALARMSILENCER 2
+#define TIMER_KINDS 3
+
+static struct timerwheel timerdb;
+
+/* number of clients with an armed alarmsilencer timer. global alarm status is cleared when it drops to 0 */
+static int global_alarmedclients; /* under global_alarmstatus_lock */
+
+
+static inline uint64_t timer_now(void)
 {
-    int retval;
+    struct timespec now;
 
-    sep->alarm = ALARM_NOALARM;
-    sep->lastalarmtime =  (struct timespec) {0,0};
-    sep->lastarrival = (struct timespec) {0,0};
-    pthread_mutex_init(&(sep->mutex), 0);
-    retval = ringbuffer_init(&(sep->datablockbuffer), opt.rollingwindow);
-    if( 0 != retval ){
-        dprintf(2 /*stderr*/, "Error: no mem for datablock buffer\n");
-        exit(2);
-    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000) / TIMER_TICK_MS;
 }
 
+static inline void timer_arm_ticks(int msgid, int kind, uint64_t now, uint64_t ticks)
+{
+    timerwheel_arm(&timerdb, (size_t) msgid * TIMER_KINDS + kind, now + ticks);
+}
 
-static void statusentry_clear(struct statusentry * sep)
+static inline void timer_arm(int msgid, int kind, uint64_t now, int seconds)
 {
-    pthread_mutex_lock(&(sep->mutex));
-    sep->alarm = ALARM_NOALARM;
-    sep->lastalarmtime =  (struct timespec) {0,0};
-    sep->lastarrival = (struct timespec) {0,0};
-    ringbuffer_clear(&(sep->datablockbuffer));
-    pthread_mutex_unlock(&(sep->mutex));
+    timer_arm_ticks(msgid, kind, now, (uint64_t) seconds * 1000 / TIMER_TICK_MS);
 }
 
+static inline int timer_isarmed(int msgid, int kind)
+{
+    return timerwheel_isarmed(&timerdb, (size_t) msgid * TIMER_KINDS + kind);
+}
 
-int init_databases(size_t clientnum)
+static inline void timer_cancelall(int msgid)
 {
-    int retval;
-    int i;
+    int kind;
 
-    /* dirty and guick hack. Since the hostname and the text come directly after each other, they can be used as one. */
-    retval = nameregistry_init(&namedb, clientnum, FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN);
-    if( 0 != retval){
-        if( opt.debug){
-            dprintf(2 /*stderr*/, "Error: cannot allocate memory for namedb\n");
-        }
-        return -1;
-    }
-    statusdb = (struct statusentry *) malloc(clientnum * sizeof(struct statusentry));
-    if( NULL == statusdb){
-        if( opt.debug){
-            dprintf(2 /*stderr*/, "Error: cannot allocate memory for statusdb\n");
-        }
-        return -1;
+    for( kind=0; kind < TIMER_KINDS; kind++){
+        timerwheel_cancel(&timerdb, (size_t) msgid * TIMER_KINDS + kind);
     }
-    for(i=0; i< clientnum; i++){
-        statusentry_init( statusdb+i );
-    }
-
-    global_alarmstatus = 0;
-    pthread_mutex_init(&global_addremove_lock, 0);
-    pthread_mutex_init(&global_alarmstatus_lock, 0);
-    pthread_cond_init(&global_alarmstatus_cond, 0);
-    pthread_cond_init(&global_normalstatus_cond, 0);
-    return 0;
 }
 
 
-/*
-** it mus be call under the lock of statusdb entry!
-**  both the alarmstatus of statusdb's entry and the global alarmstatus set here.
-**  the global one unset in the alarmsilencer_loop()
-*/
-static inline void alarm_set(int msgid, const unsigned int alarm_name)
+/* a client leaves the alarmed state. If it was the last one, the global alarm status is cleared. */
+static void alarmedclients_dec(void)
 {
-    //dprintf(2, "DEBUG alarm_set(%d, %d) begin\n", msgid, alarm_name);
-    statusdb[msgid].alarm |= alarm_name;
-    clock_gettime(CLOCK_REALTIME, &(statusdb[msgid].lastalarmtime));
-    if( opt.debug >1){
-        dprintf(2, "DEBUG alarm set for msgid=%d global_alarmstatus=%d\n", msgid, global_alarmstatus);
-    }
     pthread_mutex_lock(&global_alarmstatus_lock);
-    if( !global_alarmstatus){
-        if( opt.debug){
-            dprintf(2, "DEBUG Global alarm status set. msgid=%d alarm_name=%d\n", msgid, alarm_name);
-        }
-        global_alarmstatus = 1;
-        pthread_cond_signal(&global_alarmstatus_cond);
+    global_alarmedclients --;
+    if( 0 == global_alarmedclients && global_alarmstatus){
+        logprintf(2, "Info: global status set to normal.\n");
+        global_alarmstatus = 0;
+        pthread_cond_signal(&global_normalstatus_cond);
     }
     pthread_mutex_unlock(&global_alarmstatus_lock);
-    //dprintf(2, "DEBUG alarm_set(%d, %d) end\n", msgid, alarm_name);
 }
 
-static inline void alarm_unset(int msgid, const unsigned int alarm_name)
-{
-    statusdb[msgid].alarm &= ~alarm_name;
-}
 
-static inline void alarm_clear(int msgid)
+static void hotdb_clear(int msgid)
 {
-    statusdb[msgid].alarm = ALARM_NOALARM;
-    statusdb[msgid].lastalarmtime = (struct timespec) {0,0};
+    hotdb.alarm[msgid] = ALARM_NOALARM;
+    hotdb.lastarrival[msgid] = 0;
+    hotdb.window.sumN[msgid] = 0.0;
+    hotdb.window.sumx[msgid] = 0.0;
+    hotdb.window.sumxx[msgid] = 0.0;
+    hotdb.window.winmin[msgid] = FSLATENCY_EXTREMEBIGINTERVAL;
+    hotdb.window.winmax[msgid] = -FSLATENCY_EXTREMEBIGINTERVAL;
+    hotdb.window.lastmin[msgid] = FSLATENCY_EXTREMEBIGINTERVAL;
+    hotdb.window.lastmax[msgid] = -FSLATENCY_EXTREMEBIGINTERVAL;
+    hotdb.verdict[msgid] = 0;
+    hotdb.srcaddr[msgid] = 0;
+    hotdb.boundlo[msgid] = -FSLATENCY_EXTREMEBIGINTERVAL;
+    hotdb.boundhi[msgid] = FSLATENCY_EXTREMEBIGINTERVAL;
 }
 
+
+static struct storedblock * ringdb; /* opt.rollingwindow storedblocks per client, see clienttable_grow() */
+static struct tokenbucket * clientbuckets; /* --clientrate, the receiver only. See flood protection */
+static uint32_t (*heatmapcounts)[HEATMAP_BUCKETS]; /* --heatmap client, the graphite thread only. See heatmap */
+
+
 /*
-**  alarmer threads
-**
-**
-**
+** mad_bounds
+**   the bounds of the mad detector (--detector mad) from the datablock minimums and maximums
+**   of the rolling window. It is O(rollingwindow), so it is recalculated only every MAD_REFRESH
+**   datablocks (the median of the window moves slowly), and in every datablock until the client
+**   has enough measurements. The empty datablocks (stuck agent) have no min and max, they are left out.
+**   The statistical alarmer compares the latest datablock to these bounds, see statusscan_bounds().
+**   Must be called under the lock of statusdb entry!
 */
 
+#define MAD_REFRESH 10
 
-struct statnumbers {
-    double minx, maxx, sumx, sumxx, mean, std;
-    uint64_t sumN;
-};
-
+static float * madmins; /* opt.rollingwindow each, the receiver only. See init_databases() */
+static float * madmaxs;
 
-static void statnumbers_init( struct statnumbers * snp)
+static void mad_bounds(int msgid)
 {
-    snp->minx = FSLATENCY_EXTREMEBIGINTERVAL;
-    snp->maxx = -FSLATENCY_EXTREMEBIGINTERVAL;
-    snp->mean = snp->std = snp->sumx = snp->sumxx = 0.0;
-    snp->sumN = 0;
+    struct statusentry * sep = statusdb + msgid;
+    struct storedblock * ring = ringdb + (size_t) msgid * opt.rollingwindow;
+    struct storedblock * sbp;
+    size_t n = 0;
+    size_t i;
+
+    if( hotdb.window.sumN[msgid] <= rulesdb.profile[sep->rule].minimummeasurementcount){
+        hotdb.boundlo[msgid] = -FSLATENCY_EXTREMEBIGINTERVAL;
+        hotdb.boundhi[msgid] = FSLATENCY_EXTREMEBIGINTERVAL;
+        return;
+    }
+    for( i=0; i < sep->len; i++){
+        sbp = ring + (i + sep->start) % opt.rollingwindow;
+        if( 0 != sbp->measurementcount){
+            madmins[n] = sbp->min;
+            madmaxs[n] = sbp->max;
+            n ++;
+        }
+    }
+    detector_mad_bounds(madmins, madmaxs, n, rulesdb.profile[sep->rule].madthresholdfactor, opt.madminscale,
+                        hotdb.boundlo + msgid, hotdb.boundhi + msgid);
+    sep->boundsage = 0;
 }
 
 
-static struct statnumbers global_stat;
-static pthread_mutex_t global_stat_lock = PTHREAD_MUTEX_INITIALIZER;
-
+/*
+** history (--historymb): the per second min/max/mean (ln(ms)) of the clients in a compressed pool
+**   of fixed size, see history.h. Written by the receiver in window_add(), read by the query thread
+**   (history_loop()), both under history_lock. A client is found by the siphash of its name with
+**   a constant key (only a spread, not a MAC), so a forgotten and readded client continues its history.
+*/
+static struct history historydb;
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
+static const uint8_t historykey[SIPHASH_KEY_LEN];
 
-static inline double standard_deviation(uint64_t sumN, double sumx, double sumxx){
-        return sqrt((sumxx - sumx*sumx/(double)sumN)/(sumN-1.0));
+/* name: the hostname and the text, zero padded */
+static inline uint64_t history_key(const void * name)
+{
+    return siphash24(name, FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN, historykey);
 }
 
 
-static int statistical_alarmer(int msgid, struct statnumbers * csp)
+/* must be called under the lock of the statusdb entry */
+static void history_note(int msgid, const struct storedblock * sbp)
 {
-    /* csp: cumulative statnumbers pointer */
+    struct statusentry * sep = statusdb + msgid;
+    float value[HISTORY_VALUES];
+
+    if( 0 == sbp->measurementcount){ /* an empty one (stuck agent) */
+        value[0] = value[1] = value[2] = NAN;
+    } else {
+        value[0] = sbp->min;
+        value[1] = sbp->max;
+        value[2] = sbp->sumx / sbp->measurementcount;
+    }
+    pthread_mutex_lock(&history_lock);
+    history_add(&historydb, &(sep->history), (uint32_t) sep->laststart.tv_sec, value);
+    pthread_mutex_unlock(&history_lock);
+}
 
-    struct ringbuffer * rbp;
-    struct datablock * dbp;
-    int i;
-    struct statnumbers stat;
 
-    statnumbers_init(&stat);
+/* the bucket of the max of the datablock, an empty one (stuck agent) is in the last. See heatmap */
+static inline void heatmap_note(struct statusentry * sep, const struct storedblock * sbp)
+{
+    int b = HEATMAP_BUCKETS - 1;
 
-    pthread_mutex_lock(&(statusdb[msgid].mutex));
-    /* rbp RingBufferPointer points to the ringbuffer of current msgid */
-    rbp = &(statusdb[msgid].datablockbuffer);
-    if( 0 == rbp->len){ /* empty */
-        pthread_mutex_unlock(&(statusdb[msgid].mutex));
-        return 0;
+    if( 0 != sbp->measurementcount){
+        b = (int) ceil((sbp->max + log(1000.0)) / M_LN2) - HEATMAP_LOW_LOG2_US; /* ln(ms) -> log2(usec) */
+        b = b < 0 ? 0 : b > HEATMAP_BUCKETS - 1 ? HEATMAP_BUCKETS - 1 : b;
     }
-
-    /* calculate statnumbers for this msgid */
-    for(i =0; i < rbp->len; i++){
-        /* dbp DatBlockPointer points to the the curent datablock of current msgid */
-        dbp = &(rbp->buffer[(i + rbp->start) % rbp->bufferlen]);
-        if( dbp->min <= FSLATENCY_EXTREMEBIGINTERVAL){
-            stat.sumN += dbp->measurementcount;
-            if( dbp->min < stat.minx){
-                stat.minx = dbp->min;
-            }
-            if( dbp->max > stat.maxx){
-                stat.maxx = dbp->max;
-            }
-            stat.sumx += dbp->sumx;
-            stat.sumxx += dbp->sumxx;
-        }else{
-            if(opt.debug){
-                /* program flow error, please ignore */
-                dprintf(2, "DEBUG empty datablock arrived for statisctic alarmer.\n");
-            }
-        }
+    if( UINT16_MAX != sep->heatmap[b]){
+        sep->heatmap[b] ++;
     }
+}
 
-    /* update cumulative_stat that is thread-local*/
 
-    csp->sumN += stat.sumN;
-    csp->sumx += stat.sumx;
-    csp->sumxx += stat.sumxx;
-    if( csp->minx > stat.minx){
-        csp->minx = stat.minx;
-    }
-    if( csp->maxx < stat.maxx){
-        csp->maxx = stat.maxx;
-    }
+/* the minutes of the SLO accounting: monotonic, like the timers */
+static inline uint32_t slo_minute(void)
+{
+    return (uint32_t) (timer_now() * TIMER_TICK_MS / 60000);
+}
 
-    /* after the loop, dbp points to the last datablock. Max/min check only for last datablock*/
-    if( stat.sumN > opt.minimummeasurementcount){
-        stat.mean = stat.sumx / stat.sumN;
-        stat.std = standard_deviation(stat.sumN, stat.sumx, stat.sumxx);
-        if( opt.debug > 1){
-            dprintf(2, "DEBUG statistic msgid=%d sumN=%lu [%f < min=%f max=%f < %f] avg=%f std=%f\n", msgid, stat.sumN,
-            stat.mean - stat.std * opt.latencythresholdfactor, stat.minx, stat.maxx,
-            stat.mean + stat.std * opt.latencythresholdfactor, stat.mean, stat.std);
+
+/*
+** window_add
+**   adds the blockindex-th datablock of the received packet p to the rolling window of the client, and maintains the window statistics
+**   in hotdb incrementally. Must be called under the lock of statusdb entry!
+**   The sums are updated in O(1). The min/max is rescanned only if the dropped datablock held it.
+**   The sums are updated from the stored (float32) values, so removing a block subtracts exactly what was added.
+*/
+static void window_add(int msgid, const unsigned char * p, int blockindex)
+{
+    struct statusentry * sep = statusdb + msgid;
+    struct storedblock * ring = ringdb + (size_t) msgid * opt.rollingwindow;
+    struct storedblock * oldp;
+    struct storedblock * newp;
+    int rescan = 0;
+    size_t i;
+
+    /* the ring holds opt.rollingwindow, the window of the profile of the client may be shorter */
+    if( sep->len >= rulesdb.profile[sep->rule].rollingwindow){ /* the oldest will be dropped */
+        oldp = ring + sep->start;
+        hotdb.window.sumN[msgid] -= oldp->measurementcount;
+        hotdb.window.sumx[msgid] -= oldp->sumx;
+        hotdb.window.sumxx[msgid] -= oldp->sumxx;
+        rescan = (oldp->min <= hotdb.window.winmin[msgid]) || (oldp->max >= hotdb.window.winmax[msgid]);
+        sep->start = (sep->start + 1) % opt.rollingwindow;
+        sep->len --;
+    }
+    newp = ring + (sep->start + sep->len) % opt.rollingwindow;
+    sep->len ++;
+    /* straight from the receive buffer to the ring */
+    newp->measurementcount = (uint32_t) msgview_count(p, blockindex);
+    newp->min = (float) msgview_min(p, blockindex);
+    newp->max = (float) msgview_max(p, blockindex);
+    newp->sumx = (float) msgview_sumx(p, blockindex);
+    newp->sumxx = (float) msgview_sumxx(p, blockindex);
+    msgview_start(p, blockindex, &(sep->laststart));
+    /* the previous latest one: the profile is the past of the datablock checked by statistical_alarmer() */
+    if( sep->len > 1){
+        oldp = ring + (sep->start + sep->len - 2) % opt.rollingwindow;
+        if( 0 != oldp->measurementcount){ /* an empty one (stuck agent) has no max */
+            profile_add(&(sep->profile), oldp->max);
         }
-        if( dbp->min < (stat.mean - stat.std * opt.latencythresholdfactor)){
-            alarm_set(msgid, ALARM_STATISTICALALARM_LOW);
-        } else {
-            alarm_unset(msgid, ALARM_STATISTICALALARM_LOW);
+    }
+    hotdb.window.lastmin[msgid] = newp->min;
+    hotdb.window.lastmax[msgid] = newp->max;
+    if( rescan){
+        /* recalculate everything from the ring, so the rounding errors of the sums do not accumulate */
+        hotdb.window.sumN[msgid] = hotdb.window.sumx[msgid] = hotdb.window.sumxx[msgid] = 0.0;
+        hotdb.window.winmin[msgid] = FSLATENCY_EXTREMEBIGINTERVAL;
+        hotdb.window.winmax[msgid] = -FSLATENCY_EXTREMEBIGINTERVAL;
+        for( i=0; i < sep->len; i++){
+            oldp = ring + (i + sep->start) % opt.rollingwindow;
+            hotdb.window.sumN[msgid] += oldp->measurementcount;
+            hotdb.window.sumx[msgid] += oldp->sumx;
+            hotdb.window.sumxx[msgid] += oldp->sumxx;
+            if( oldp->min < hotdb.window.winmin[msgid]){
+                hotdb.window.winmin[msgid] = oldp->min;
+            }
+            if( oldp->max > hotdb.window.winmax[msgid]){
+                hotdb.window.winmax[msgid] = oldp->max;
+            }
         }
-        if( dbp->max > (stat.mean + stat.std * opt.latencythresholdfactor)){
-            alarm_set(msgid, ALARM_STATISTICALALARM_HIGH);
-        } else {
-            alarm_unset(msgid, ALARM_STATISTICALALARM_HIGH);
+    } else {
+        hotdb.window.sumN[msgid] += newp->measurementcount;
+        hotdb.window.sumx[msgid] += newp->sumx;
+        hotdb.window.sumxx[msgid] += newp->sumxx;
+        if( newp->min < hotdb.window.winmin[msgid]){
+            hotdb.window.winmin[msgid] = newp->min;
         }
-
-
-    }else{
-        if( opt.debug > 1){
-            dprintf(2, "DEBUG statistic (low on N) msgid=%d sumN=%lu min=%f max=%f \n", msgid, stat.sumN, stat.minx, stat.maxx);
+        if( newp->max > hotdb.window.winmax[msgid]){
+            hotdb.window.winmax[msgid] = newp->max;
         }
     }
-    pthread_mutex_unlock(&(statusdb[msgid].mutex));
-    return 0;
+    if( DETECTOR_MAD == opt.detector
+        && (++ sep->boundsage >= MAD_REFRESH || FSLATENCY_EXTREMEBIGINTERVAL == hotdb.boundhi[msgid])){
+        mad_bounds(msgid);
+    }
+    if( 0.0 != opt.driftfactor && 0 != newp->measurementcount){ /* an empty one (stuck agent) has no mean */
+        drift_update(&(sep->drift), newp->sumx / newp->measurementcount, log(opt.driftfactor));
+    }
+    if( 0.0 != opt.slo){
+        slo_add(&(sep->slo), slo_minute(), 0 == newp->measurementcount || newp->max > log(opt.slo));
+    }
+    if( 0 != opt.historymb){
+        history_note(msgid, newp);
+    }
+    if( HEATMAP_NONE != opt.heatmap){
+        heatmap_note(sep, newp);
+    }
+    if( -1 != recordfd){
+        logprintf(recordfd, "%d %u %f %f %f %f\n", msgid, newp->measurementcount, newp->min, newp->max, newp->sumx, newp->sumxx);
+    }
 }
 
 
-static void * statistical_alarmer_loop( void * arg)
-{
-    int msgid;
-    struct statnumbers cumulative_stat;
-
-    while(1){
-        statnumbers_init(&cumulative_stat);  /* zero it */
-        for(msgid = 0; msgid < opt.maxclient; msgid++){
-            statistical_alarmer(msgid, &cumulative_stat);  /* note: there is a room for performance tunning */
-        }
+/*
+** the scheduling of the agents: their latency numbers include the scheduling jitter of
+** the measuring thread, unless it runs with a realtime policy (fifo, rr).
+** global_rtclients: the number of such clients, for the status lines
+*/
+static int global_rtclients; /* __atomic */
 
-        pthread_mutex_lock(&global_stat_lock);
-        global_stat = cumulative_stat;
-        global_stat.mean = global_stat.sumx / (double)global_stat.sumN;
-        global_stat.std = standard_deviation(global_stat.sumN, global_stat.sumx, global_stat.sumxx);
-        pthread_mutex_unlock(&global_stat_lock);
-        sleep(1);
-    }
-    return NULL;
+static inline int sched_isrt(uint16_t policy)
+{
+    return SCHED_FIFO == policy || SCHED_RR == policy;
 }
 
 
-
-static void * udptimeout_loop( void * arg)
+/* must be called under the lock of the statusdb entry */
+static void sched_note(int msgid, const unsigned char * p)
 {
-    int msgid;
-    struct timespec deadline;
+    struct statusentry * sep = statusdb + msgid;
+    uint16_t policy = msgview_schedpolicy(p);
 
-    while(1){
-        clock_gettime(CLOCK_REALTIME, &deadline);
-        deadline.tv_sec -= opt.udptimeout;
-        for(msgid = 0; msgid < opt.maxclient; msgid++){
-            /* some quickie without lock */
-            if( timespec_zero(&(statusdb[msgid].lastarrival))){ /* empty slot*/
-                continue;
-            }
-            if( timespec_gt(&(statusdb[msgid].lastarrival), &deadline)){ /*fresh*/
-                continue;
-            }
-            /*set alarm for this*/
-            if( opt.debug >1){
-                dprintf(2, "DEBUG udptimeout, msgid=%d\n", msgid);
-            }
-            pthread_mutex_lock(&(statusdb[msgid].mutex));
-            clock_gettime(CLOCK_REALTIME, &deadline);
-            deadline.tv_sec -= opt.udptimeout;
-            if( timespec_gt(&(statusdb[msgid].lastarrival), &deadline)){ /*fresh*/
-                alarm_unset(msgid, ALARM_UDPTIMEOUT);
-                pthread_mutex_unlock(&(statusdb[msgid].mutex));
-                continue;
-            }
-            alarm_set(msgid, ALARM_UDPTIMEOUT);
-            pthread_mutex_unlock(&(statusdb[msgid].mutex));
-        }/* end for msgid*/
-        sleep(1);
-    } /* end while 1*/
-    return NULL;
+    if( sched_isrt(policy) != sched_isrt(sep->schedpolicy)){
+        __atomic_add_fetch(&global_rtclients, sched_isrt(policy) ? 1 : -1, __ATOMIC_RELAXED);
+    }
+    sep->schedpolicy = policy;
+    sep->schedprio = msgview_schedprio(p);
 }
 
 
 /*
-** housekeeping threads: timetoforget_loop, alarmsilencer_loop
-**
+** adaptive udptimeout: iat_note()
+**   every client is timed out at its own bound, from the inter-arrival times of its packets,
+**   like the retransmission timeout of TCP (RFC 6298, in fixed point): mean + 1/8 (sample - mean),
+**   deviation + 1/4 (|sample - mean| - deviation). The bound is 2 * mean + 4 * deviation,
+**   so a single lost packet and the usual jitter do not raise an alarm. It is clamped to
+**   --udptimeoutmin .. --udptimeoutmax. Until IAT_WARMUP samples the client is timed out at --udptimeout.
+**   Unlike TCP, after the warmup the deviation decays 4 times slower than it rises, so the rare long gaps
+**   of a congested link are remembered, and its lost alarm does not flap after every gap.
+**   A sample is cut at twice the current bound, so a long outage does not inflate the estimate.
 */
 
-static void * timetoforget_loop( void * arg)
-{
-    int msgid;
-    struct timespec deadline;
-    int retval;
-    char buff[FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN];
+#define IAT_WARMUP 8
 
+static inline void iat_clear(struct statusentry * sep)
+{
+    sep->iatmean = sep->iatdev = sep->iatsamples = 0;
+    sep->udptimeout = (uint32_t) opt.udptimeout * 1000 / TIMER_TICK_MS;
+}
+
+
+/* must be called under the lock of the statusdb entry, before the lastarrival is updated. Returns the new bound in ticks */
+static uint32_t iat_note(struct statusentry * sep, uint64_t lastarrival, uint64_t rectick)
+{
+    uint32_t sample;
+    uint32_t err;
+    uint32_t bound;
+
+    sample = rectick - lastarrival < 2 * sep->udptimeout ? (uint32_t) (rectick - lastarrival) : 2 * sep->udptimeout;
+    if( 0 == sep->iatsamples){
+        sep->iatmean = sample * 8;
+        sep->iatdev = sample * 2;  /* sample / 2 */
+    } else {
+        /* |sample - mean| * 4, the scale of iatdev */
+        err = (sample * 8 > sep->iatmean ? sample * 8 - sep->iatmean : sep->iatmean - sample * 8) / 2;
+        if( err > sep->iatdev || sep->iatsamples < IAT_WARMUP){
+            sep->iatdev = sep->iatdev - sep->iatdev / 4 + err / 4;
+        } else {
+            sep->iatdev -= (sep->iatdev - err) / 16;
+        }
+        sep->iatmean = sep->iatmean - sep->iatmean / 8 + sample;
+    }
+    sep->iatsamples ++;
+    if( sep->iatsamples < IAT_WARMUP){
+        return sep->udptimeout;
+    }
+    bound = sep->iatmean / 4 + sep->iatdev;
+    if( bound < (uint32_t) opt.udptimeoutmin * 1000 / TIMER_TICK_MS){
+        bound = (uint32_t) opt.udptimeoutmin * 1000 / TIMER_TICK_MS;
+    } else if( bound > (uint32_t) opt.udptimeoutmax * 1000 / TIMER_TICK_MS){
+        bound = (uint32_t) opt.udptimeoutmax * 1000 / TIMER_TICK_MS;
+    }
+    sep->udptimeout = bound;
+    return bound;
+}
+
+
+/*
+** groups: --groupby
+**   clients on the same datastore stall together. Every client belongs to the group of its key (see GROUPBY_*),
+**   the keys are in groupdb (at most GROUP_MAX groups), their counters in groups[] at the same id.
+**   group_note() counts the clients of the group whose high latency or stuck alarm starts, in aligned seconds.
+**   If the ones of this and the previous second reach --groupquorum of the members (at least 2 clients),
+**   the group is alarmed for --alarmtimeout seconds, with a Notice when it starts. See group_alarms_print()
+**   group_lock: after the lock of the statusdb entry.
+*/
+
+#define GROUP_MAX 4096
+#define GROUP_KEY_LEN 64
+#define GROUP_NONE -1
+#define GROUP_ALARMS (ALARM_STATISTICALALARM_HIGH | ALARM_STATISTICALALARM_EMPTYDATABLOCK)
+
+struct groupentry {
+    unsigned int members;
+    uint64_t second;          /* of hits[0] */
+    unsigned int hits[2];     /* clients with a starting alarm in second and in second - 1 */
+    uint64_t alarmuntil;      /* second */
+    unsigned int alarmhits;   /* at the last quorum */
+};
+
+static struct nameregistry groupdb;
+static struct groupentry groups[GROUP_MAX];
+static pthread_mutex_t group_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static inline uint64_t group_second(void)
+{
+    return timer_now() * TIMER_TICK_MS / 1000;
+}
+
+
+/* the key of the client into key (GROUP_KEY_LEN, zero padded). Returns -1 if it has none */
+static int group_key(const unsigned char * p, char * key)
+{
+    const char * src;
+    size_t len, i;
+
+    memset(key, 0, GROUP_KEY_LEN);
+    if( GROUPBY_TEXT == opt.groupby){
+        src = msgview_text(p);
+        len = FSLATENCY_TEXT_LEN < GROUP_KEY_LEN ? FSLATENCY_TEXT_LEN : GROUP_KEY_LEN;
+        for( i=0; i < len && '\0' != src[i] && ' ' != src[i]; i++){
+            key[i] = src[i];
+        }
+    } else {
+        src = msgview_hostname(p);
+        len = FSLATENCY_HOSTNAME_LEN < GROUP_KEY_LEN ? FSLATENCY_HOSTNAME_LEN : GROUP_KEY_LEN;
+        for( i=0; i < len && '\0' != src[i] && '.' != src[i]; i++){
+            key[i] = src[i];
+        }
+        while( i > 0 && key[i - 1] >= '0' && key[i - 1] <= '9'){
+            key[-- i] = '\0';
+        }
+        while( i > 0 && ('-' == key[i - 1] || '_' == key[i - 1])){
+            key[-- i] = '\0';
+        }
+    }
+    return '\0' == key[0] ? -1 : 0;
+}
+
+
+/* a new client joins its group. Must be called under the lock of the statusdb entry */
+static void group_join(int msgid, const unsigned char * p)
+{
+    static int warned; /* once */
+    char key[GROUP_KEY_LEN];
+    int id;
+
+    if( GROUPBY_NONE == opt.groupby || -1 == group_key(p, key)){
+        return;
+    }
+    pthread_mutex_lock(&group_lock);
+    id = nameregistry_findadd(&groupdb, key);
+    if( -1 != id){
+        if( 0 == groups[id].members){
+            memset(groups + id, 0, sizeof(struct groupentry));
+        }
+        groups[id].members ++;
+        statusdb[msgid].group = id;
+    }
+    pthread_mutex_unlock(&group_lock);
+    if( -1 == id && !__atomic_exchange_n(&warned, 1, __ATOMIC_RELAXED)){
+        logprintf(2 /*stderr*/, "Warning: too many groups (%d), the new ones are not grouped. msgid=%d group=%.*s\n",
+            GROUP_MAX, msgid, GROUP_KEY_LEN, key);
+    }
+}
+
+
+/* must be called under the lock of the statusdb entry */
+static void group_leave(struct statusentry * sep)
+{
+    if( GROUP_NONE == sep->group){
+        return;
+    }
+    pthread_mutex_lock(&group_lock);
+    if( 0 == -- groups[sep->group].members){
+        nameregistry_removebyid(&groupdb, sep->group);
+    }
+    pthread_mutex_unlock(&group_lock);
+    sep->group = GROUP_NONE;
+    sep->grouphit = 0;
+}
+
+
+/* a GROUP_ALARMS alarm of the client starts. Must be called under the lock of the statusdb entry */
+static void group_note(int msgid)
+{
+    struct statusentry * sep = statusdb + msgid;
+    struct groupentry * gp = groups + sep->group;
+    uint64_t second = group_second();
+    unsigned int hits, members, quorum;
+    char key[GROUP_KEY_LEN];
+    int alarmstart = 0;
+
+    if( sep->grouphit >= second){
+        return; /* already counted in this or the previous second */
+    }
+    sep->grouphit = second + 1;
+    pthread_mutex_lock(&group_lock);
+    if( second != gp->second){
+        gp->hits[1] = (second == gp->second + 1) ? gp->hits[0] : 0;
+        gp->hits[0] = 0;
+        gp->second = second;
+    }
+    gp->hits[0] ++;
+    hits = gp->hits[0] + gp->hits[1];
+    members = gp->members;
+    quorum = (unsigned int) ceil(opt.groupquorum * members);
+    if( hits >= quorum && hits >= 2){
+        alarmstart = gp->alarmuntil <= second;
+        gp->alarmuntil = second + opt.alarmtimeout;
+        gp->alarmhits = hits;
+        if( alarmstart){
+            nameregistry_getbyid(&groupdb, sep->group, key);
+        }
+    }
+    pthread_mutex_unlock(&group_lock);
+    if( alarmstart){
+        logprintf(2 /*stderr*/, "Notice: group alarm, %.*s: %u/%u clients high latency or stuck within 2 s\n",
+            GROUP_KEY_LEN, key, hits, members);
+    }
+}
+
+
+#define GROUP_TOP 8  /* listed in the ALARM status */
+
+/* the number of the alarmed groups, and the first GROUP_TOP of them into ids, hits and members (if not NULL) */
+static unsigned int group_alarms(int * ids, unsigned int * hits, unsigned int * members)
+{
+    uint64_t second = group_second();
+    unsigned int n = 0;
+    int id;
+
+    if( GROUPBY_NONE == opt.groupby){
+        return 0;
+    }
+    pthread_mutex_lock(&group_lock);
+    for( id=0; id < GROUP_MAX; id++){
+        if( 0 == groups[id].members || groups[id].alarmuntil <= second){
+            continue;
+        }
+        if( NULL != ids && n < GROUP_TOP){
+            ids[n] = id;
+            hits[n] = groups[id].alarmhits;
+            members[n] = groups[id].members;
+        }
+        n ++;
+    }
+    pthread_mutex_unlock(&group_lock);
+    return n;
+}
+
+
+static void statusentry_init(struct statusentry * sep)
+{
+    sep->alarmcounted = 0;
+    sep->schedpolicy = sep->schedprio = 0;
+    sep->lastseq = sep->seqmask = sep->windowseq = 0;
+    sep->lost = sep->reordered = 0;
+    sep->windowlost = 0;
+    iat_clear(sep);
+    sep->boundsage = 0;
+    sep->rule = 0;         /* set when the client is added */
+    memset(&(sep->eventbucket), 0, sizeof(sep->eventbucket)); /* full */
+    sep->eventsuppressed = 0;
+    drift_init(&(sep->drift));
+    profile_init(&(sep->profile));
+    slo_init(&(sep->slo));
+    history_writer_init(&(sep->history), 0); /* the key is set when the client is added */
+    memset(sep->heatmap, 0, sizeof(sep->heatmap));
+    sep->group = GROUP_NONE;
+    sep->grouphit = 0;
+    sep->start = sep->len = 0;
+    sep->laststart.tv_sec = sep->laststart.tv_nsec = 0;
+    pthread_mutex_init(&(sep->mutex), 0);
+}
+
+
+/* must be called under the lock of the statusdb entry */
+static void statusentry_clear(struct statusentry * sep)
+{
+    timer_cancelall(sep - statusdb);
+    if( sep->alarmcounted){
+        alarmedclients_dec();
+    }
+    sep->alarmcounted = 0;
+    if( sched_isrt(sep->schedpolicy)){
+        __atomic_sub_fetch(&global_rtclients, 1, __ATOMIC_RELAXED);
+    }
+    sep->schedpolicy = sep->schedprio = 0;
+    sep->lastseq = sep->seqmask = sep->windowseq = 0;
+    sep->lost = sep->reordered = 0;
+    sep->windowlost = 0;
+    iat_clear(sep);
+    sep->boundsage = 0;
+    sep->rule = 0;         /* set when the client is added */
+    memset(&(sep->eventbucket), 0, sizeof(sep->eventbucket)); /* full */
+    sep->eventsuppressed = 0;
+    drift_init(&(sep->drift));
+    profile_init(&(sep->profile));
+    slo_init(&(sep->slo));
+    history_writer_init(&(sep->history), 0); /* the key is set when the client is added */
+    memset(sep->heatmap, 0, sizeof(sep->heatmap));
+    group_leave(sep);
+    hotdb_clear(sep - statusdb);
+    sep->start = sep->len = 0;
+    sep->laststart.tv_sec = sep->laststart.tv_nsec = 0;
+}
+
+
+/*
+** client table: statusdb, hotdb and the datablock rings, all indexed by msgid
+**   every array has its own arena, reserved for opt.clientlimit clients at startup.
+**   The table grows in CLIENTCHUNK steps, see clienttable_grow(). The arenas never move,
+**   so a msgid held by any thread remains valid while the table grows.
+**   The scan loops visit only the first clienttable_size entries.
+*/
+
+#define CLIENTCHUNK 256
+
+static struct clientarray {
+    void ** pointer;
+    size_t elemsize;
+    struct arena arena;
+} clientarrays[] = {
+    { (void **) &statusdb, sizeof(struct statusentry)},
+    { (void **) &hotdb.alarm, sizeof(uint32_t)},
+    { (void **) &hotdb.lastarrival, sizeof(uint64_t)},
+    { (void **) &hotdb.window.sumN, sizeof(double)},
+    { (void **) &hotdb.window.sumx, sizeof(double)},
+    { (void **) &hotdb.window.sumxx, sizeof(double)},
+    { (void **) &hotdb.window.winmin, sizeof(double)},
+    { (void **) &hotdb.window.winmax, sizeof(double)},
+    { (void **) &hotdb.window.lastmin, sizeof(double)},
+    { (void **) &hotdb.window.lastmax, sizeof(double)},
+    { (void **) &hotdb.verdict, sizeof(uint8_t)},
+    { (void **) &hotdb.srcaddr, sizeof(uint32_t)},
+    { (void **) &hotdb.boundlo, sizeof(double)},
+    { (void **) &hotdb.boundhi, sizeof(double)},
+    { (void **) &clientbuckets, sizeof(struct tokenbucket)},
+    { (void **) &heatmapcounts, 0}, /* elemsize is set in init_databases() */
+    { (void **) &ringdb, 0}, /* elemsize is set in init_databases() */
+};
+
+#define CLIENTARRAYS (sizeof(clientarrays) / sizeof(clientarrays[0]))
+
+static size_t clienttable_size; /* written under clienttable_lock, read with __atomic_load_n() */
+static pthread_mutex_t clienttable_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static inline size_t clienttable_getsize(void)
+{
+    return __atomic_load_n(&clienttable_size, __ATOMIC_ACQUIRE);
+}
+
+
+/*
+** clienttable_grow
+**   makes room for at least newsize clients (rounded up to CLIENTCHUNK, maximum opt.clientlimit).
+**   The new entries are initialized before the new size is published, and the namedb is grown last,
+**   so no msgid is given out for an uninitialized entry.
+**   return 0 if the table has newsize entries, -1 if not (limit reached or no memory)
+*/
+static int clienttable_grow(size_t newsize)
+{
+    size_t oldsize;
+    size_t i;
+
+    pthread_mutex_lock(&clienttable_lock);
+    oldsize = clienttable_size;
+    if( newsize <= oldsize){
+        pthread_mutex_unlock(&clienttable_lock);
+        return 0;
+    }
+    newsize = (newsize + CLIENTCHUNK - 1) / CLIENTCHUNK * CLIENTCHUNK;
+    if( newsize > opt.clientlimit){
+        newsize = opt.clientlimit;
+    }
+    if( newsize <= oldsize){
+        pthread_mutex_unlock(&clienttable_lock);
+        return -1;
+    }
+    for( i=0; i < CLIENTARRAYS; i++){
+        if( 0 != arena_commit(&(clientarrays[i].arena), newsize * clientarrays[i].elemsize)){
+            pthread_mutex_unlock(&clienttable_lock);
+            return -1;
+        }
+    }
+    for( i=oldsize; i < newsize; i++){
+        statusentry_init(statusdb + i);
+        hotdb_clear(i);
+    }
+    if( 0 != timerwheel_grow(&timerdb, newsize * TIMER_KINDS)){
+        pthread_mutex_unlock(&clienttable_lock);
+        return -1;
+    }
+    /* the names last: a new msgid is used only when its entries are ready. The size is published
+       only when all of them are grown, so a failed grow is tried again by the next call */
+    if( 0 != nameregistry_grow(&namedb, newsize)){
+        pthread_mutex_unlock(&clienttable_lock);
+        return -1;
+    }
+    __atomic_store_n(&clienttable_size, newsize, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&clienttable_lock);
+    if( opt.debug){
+        logprintf(2, "DEBUG client table grown from %lu to %lu\n", oldsize, newsize);
+    }
+    return 0;
+}
+
+
+int init_databases(size_t clientnum)
+{
+    int retval;
+    size_t i;
+
+    /* dirty and guick hack. Since the hostname and the text come directly after each other, they can be used as one. */
+    retval = nameregistry_init_growable(&namedb, 0, opt.clientlimit, FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN);
+    if( 0 != retval){
+        if( opt.debug){
+            dprintf(2 /*stderr*/, "Error: cannot allocate memory for namedb\n");
+        }
+        return -1;
+    }
+    if( GROUPBY_NONE != opt.groupby && 0 != nameregistry_init(&groupdb, GROUP_MAX, GROUP_KEY_LEN)){
+        if( opt.debug){
+            dprintf(2 /*stderr*/, "Error: cannot allocate memory for groupdb\n");
+        }
+        return -1;
+    }
+    if( 0 != opt.historymb && 0 != history_init(&historydb, (size_t) opt.historymb * 1024 * 1024)){
+        if( opt.debug){
+            dprintf(2 /*stderr*/, "Error: cannot allocate memory for historydb\n");
+        }
+        return -1;
+    }
+    retval = timerwheel_init_growable(&timerdb, 0, (size_t) opt.clientlimit * TIMER_KINDS, timer_now());
+    if( 0 != retval){
+        if( opt.debug){
+            dprintf(2 /*stderr*/, "Error: cannot allocate memory for timerdb\n");
+        }
+        return -1;
+    }
+    madmins = (float *) malloc(opt.rollingwindow * sizeof(float));
+    madmaxs = (float *) malloc(opt.rollingwindow * sizeof(float));
+    if( NULL == madmins || NULL == madmaxs){
+        if( opt.debug){
+            dprintf(2 /*stderr*/, "Error: cannot allocate memory for the mad detector\n");
+        }
+        return -1;
+    }
+    clientarrays[CLIENTARRAYS - 2].elemsize = HEATMAP_CLIENT == opt.heatmap ? sizeof(heatmapcounts[0]) : 0;
+    clientarrays[CLIENTARRAYS - 1].elemsize = opt.rollingwindow * sizeof(struct storedblock);
+    for( i=0; i < CLIENTARRAYS; i++){
+        if( 0 != arena_init(&(clientarrays[i].arena), opt.clientlimit * clientarrays[i].elemsize)){
+            if( opt.debug){
+                dprintf(2 /*stderr*/, "Error: cannot reserve address space for statusdb\n");
+            }
+            return -1;
+        }
+        *(clientarrays[i].pointer) = clientarrays[i].arena.base; /* page aligned, good for the SIMD scans */
+    }
+    clienttable_size = 0;
+    if( 0 != clienttable_grow(clientnum)){
+        if( opt.debug){
+            dprintf(2 /*stderr*/, "Error: cannot allocate memory for statusdb\n");
+        }
+        return -1;
+    }
+    retval = statusscan_init();
+    if( opt.debug){
+        dprintf(2, "DEBUG status scan implementation: %s\n",
+            STATUSSCAN_AVX2 == retval ? "avx2" : STATUSSCAN_SSE2 == retval ? "sse2" : "scalar");
+    }
+
+    global_alarmstatus = 0;
+    global_alarmedclients = 0;
+    pthread_mutex_init(&global_addremove_lock, 0);
+    pthread_mutex_init(&global_alarmstatus_lock, 0);
+    pthread_cond_init(&global_alarmstatus_cond, 0);
+    pthread_cond_init(&global_normalstatus_cond, 0);
+    return 0;
+}
+
+
+/*
+** alarm events (--eventrate N)
+**   one line on stdout when an alarm bit of a client is set or cleared, with the client and the values
+**   that crossed the bound, e.g.
+**     2025-06-01T12:00:00+0200 EVENT set ltncyhi msgid=7 hostname=esx12 text=/mnt max=812.000ms limit=35.120ms
+**   The lines go through the log ring, so the caller never waits for the output. They are limited
+**   per client (EVENT_CLIENT_PER_MINUTE) and overall (--eventrate per second): an incident of thousands
+**   of clients costs at most N lines a second. The dropped ones are counted (eventdrops), and the next
+**   line of the client tells how many of its events were suppressed.
+*/
+
+#define EVENT_CLIENT_PER_MINUTE 6  /* and the burst of a client */
+
+static const struct {
+    unsigned int alarm;
+    const char * name;
+    const char * values;  /* format of value and limit */
+} alarmevents[] = {
+    { ALARM_STATISTICALALARM_LOW, "ltncylo", " min=%.3fms limit=%.3fms"},
+    { ALARM_STATISTICALALARM_HIGH, "ltncyhi", " max=%.3fms limit=%.3fms"},
+    { ALARM_STATISTICALALARM_DRIFT, "drift", " mean=%.3fms baseline=%.3fms"},
+    { ALARM_STATISTICALALARM_EMPTYDATABLOCK, "stuck", ""},
+    { ALARM_UDPTIMEOUT, "lost", " silence=%.1fs udptimeout=%.1fs"},
+    { ALARM_UDPTIMEOUT_NET, "lostnet", " silence=%.1fs udptimeout=%.1fs"},
+    { ALARM_UDPTIMEOUT_STALL, "loststall", " silence=%.1fs udptimeout=%.1fs"},
+    { 0, NULL, NULL}
+};
+
+static struct ratelimit eventlimit;        /* --eventrate, see init_ratelimits() */
+static struct ratelimit eventclientlimit;  /* per minute */
+static struct sharedbucket eventbucket;    /* of all clients, lock-free: every thread that sets or clears alarms */
+static unsigned long global_eventdrops;    /* __atomic */
+
+
+/*
+** the event of the changed alarm bits of the client. value and limit: NAN if not known.
+** Must be called under the lock of statusdb entry (the bucket of the client)
+*/
+static void alarm_event(int msgid, unsigned int changed, int set, double value, double limit)
+{
+    struct statusentry * sep = statusdb + msgid;
+    char name[FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN];
+    char timebuff[TIMEFORMAT_LEN];
+    char values[64];
+    char suppressed[32];
+    uint64_t now;
+    time_t tmp;
+    struct tm tm;
+    int pass;
+    int i;
+
+    if( 0 == opt.eventrate || 0 == changed){
+        return;
+    }
+    for( i=0; NULL != alarmevents[i].name; i++){
+        if( !(changed & alarmevents[i].alarm)){
+            continue;
+        }
+        now = timer_now();
+        pass = ratelimit_take(&eventclientlimit, &(sep->eventbucket), now);
+        if( pass){
+            pass = ratelimit_take_shared(&eventlimit, &eventbucket, now);
+        }
+        if( !pass || -1 == nameregistry_getbyid(&namedb, msgid, name)){
+            sep->eventsuppressed ++;
+            __atomic_add_fetch(&global_eventdrops, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        values[0] = suppressed[0] = '\0';
+        if( !isnan(value)){
+            snprintf(values, sizeof(values), alarmevents[i].values, value, limit);
+        }
+        if( 0 != sep->eventsuppressed){
+            snprintf(suppressed, sizeof(suppressed), " suppressed=%u", sep->eventsuppressed);
+            sep->eventsuppressed = 0;
+        }
+        tmp = time(NULL);
+        strftime(timebuff, sizeof(timebuff), TIMEFORMAT, localtime_r(&tmp, &tm));
+        logprintf(1, "%s EVENT %s %s msgid=%d hostname=%.*s text=%.*s%s%s\n", timebuff, set ? "set" : "clear",
+            alarmevents[i].name, msgid, FSLATENCY_HOSTNAME_LEN, name, FSLATENCY_TEXT_LEN, name + FSLATENCY_HOSTNAME_LEN,
+            values, suppressed);
+    }
+}
+
+
+/*
+** it mus be call under the lock of statusdb entry!
+**  both the alarmstatus of statusdb's entry and the global alarmstatus set here.
+**  (re)arms the alarmsilencer timer of the entry. The alarm is cleared in alarmsilencer_expired()
+*/
+static inline void alarm_set(int msgid, const unsigned int alarm_name, double value, double limit)
+{
+    //logprintf(2, "DEBUG alarm_set(%d, %d) begin\n", msgid, alarm_name);
+    if( (alarm_name & GROUP_ALARMS & ~hotdb.alarm[msgid]) && GROUP_NONE != statusdb[msgid].group){
+        group_note(msgid);
+    }
+    alarm_event(msgid, alarm_name & ~hotdb.alarm[msgid], 1, value, limit);
+    hotdb.alarm[msgid] |= alarm_name;
+    timer_arm(msgid, TIMER_ALARMSILENCER, timer_now(), opt.alarmtimeout);
+    if( opt.debug >1){
+        logprintf(2, "DEBUG alarm set for msgid=%d global_alarmstatus=%d\n", msgid, global_alarmstatus);
+    }
+    pthread_mutex_lock(&global_alarmstatus_lock);
+    if( !statusdb[msgid].alarmcounted){
+        statusdb[msgid].alarmcounted = 1;
+        global_alarmedclients ++;
+    }
+    if( !global_alarmstatus){
+        if( opt.debug){
+            logprintf(2, "DEBUG Global alarm status set. msgid=%d alarm_name=%d\n", msgid, alarm_name);
+        }
+        global_alarmstatus = 1;
+        pthread_cond_signal(&global_alarmstatus_cond);
+    }
+    pthread_mutex_unlock(&global_alarmstatus_lock);
+    //logprintf(2, "DEBUG alarm_set(%d, %d) end\n", msgid, alarm_name);
+}
+
+static inline void alarm_unset(int msgid, const unsigned int alarm_name, double value, double limit)
+{
+    alarm_event(msgid, alarm_name & hotdb.alarm[msgid], 0, value, limit);
+    hotdb.alarm[msgid] &= ~alarm_name;
+}
+
+static inline void alarm_clear(int msgid)
+{
+    alarm_event(msgid, hotdb.alarm[msgid], 0, NAN, NAN);
+    hotdb.alarm[msgid] = ALARM_NOALARM;
+}
+
+
+/*
+** drift_check
+**   the drift detector (see detector.h) is updated by window_add() with every new datablock,
+**   this turns its state into the ALARM_STATISTICALALARM_DRIFT bit, with a Notice when it starts.
+**   Must be called under the lock of the statusdb entry, after the datablocks of the packet are added.
+*/
+static void drift_check(int msgid, const unsigned char * p)
+{
+    struct statusentry * sep = statusdb + msgid;
+
+    if( sep->drift.alarmed){
+        if( !(hotdb.alarm[msgid] & ALARM_STATISTICALALARM_DRIFT)){
+            logprintf(2 /*stderr*/, "Notice: latency drift, the mean of the window is %.3f ms, the baseline is %.3f ms. msgid=%d hostname=%.*s text=%.*s\n",
+                exp(hotdb.window.sumx[msgid] / hotdb.window.sumN[msgid]), exp(sep->drift.baseline),
+                msgid, FSLATENCY_HOSTNAME_LEN, msgview_hostname(p), FSLATENCY_TEXT_LEN, msgview_text(p));
+        }
+        alarm_set(msgid, ALARM_STATISTICALALARM_DRIFT,
+            exp(hotdb.window.sumx[msgid] / hotdb.window.sumN[msgid]), exp(sep->drift.baseline));
+    } else {
+        alarm_unset(msgid, ALARM_STATISTICALALARM_DRIFT,
+            exp(hotdb.window.sumx[msgid] / hotdb.window.sumN[msgid]), exp(sep->drift.baseline));
+    }
+}
+
+/*
+** packet sequence numbers (since 0.3): seq_note()
+**   every agent numbers its packets from 1. A gap is counted as lost. A late packet within SEQ_WINDOW
+**   fills its gap back (lost - 1, reordered + 1), a repeated one is ignored. A sequence number
+**   SEQ_WINDOW or more behind is an agent restart: the counting goes on from there.
+**   A client losing more than SEQ_LOSSY of SEQ_WINDOW packets gets a Notice: its lost alarms are coming.
+**   A lost client (ALARM_UDPTIMEOUT) is classified when its packets come back: if the agent was sending
+**   during the silence (the sequence jumped), the network lost them (ALARM_UDPTIMEOUT_NET), if not,
+**   the agent or its VM was stalled (ALARM_UDPTIMEOUT_STALL).
+**   global_udplost, global_udpreordered: the sums for the status lines
+*/
+
+#define SEQ_WINDOW 64  /* bits of seqmask */
+#define SEQ_LOSSY 8
+
+static unsigned long global_udplost;      /* __atomic */
+static unsigned long global_udpreordered; /* __atomic */
+
+
+/* must be called under the lock of the statusdb entry, before the lastarrival is updated */
+static void seq_note(int msgid, const unsigned char * p, uint64_t rectick)
+{
+    struct statusentry * sep = statusdb + msgid;
+    uint64_t seq = msgview_sequence(p);
+    uint64_t gap, behind;
+    uint64_t silence; /* in ticks */
+
+    if( 0 == seq){
+        return; /* a 0.1 agent, no sequence */
+    }
+    if( seq > sep->lastseq){
+        gap = seq - sep->lastseq - 1;
+        sep->seqmask = gap + 1 < SEQ_WINDOW ? (sep->seqmask << (gap + 1)) | 1 : 1;
+        sep->lastseq = seq;
+        if( 0 != gap){
+            sep->lost += gap;
+            sep->windowlost += gap;
+            __atomic_add_fetch(&global_udplost, gap, __ATOMIC_RELAXED);
+        }
+        silence = rectick - hotdb.lastarrival[msgid];
+        if( (hotdb.alarm[msgid] & ALARM_UDPTIMEOUT) && silence >= sep->udptimeout){
+            /* back from lost. The agent sends one packet per second */
+            alarm_set(msgid, gap * 2 * 1000 >= silence * TIMER_TICK_MS ? ALARM_UDPTIMEOUT_NET : ALARM_UDPTIMEOUT_STALL,
+                silence * TIMER_TICK_MS / 1000.0, sep->udptimeout * TIMER_TICK_MS / 1000.0);
+            logprintf(2 /*stderr*/, "Notice: lost client is back after %.1f sec, %s. msgid=%d hostname=%.*s text=%.*s packets lost=%lu udptimeout=%.1f\n",
+                silence * TIMER_TICK_MS / 1000.0, gap * 2 * 1000 >= silence * TIMER_TICK_MS ? "the network lost its packets" : "it was not sending (stalled)",
+                msgid, FSLATENCY_HOSTNAME_LEN, msgview_hostname(p), FSLATENCY_TEXT_LEN, msgview_text(p), gap, sep->udptimeout * TIMER_TICK_MS / 1000.0);
+        }
+        if( seq - sep->windowseq >= SEQ_WINDOW){
+            if( sep->windowlost > SEQ_LOSSY){
+                logprintf(2 /*stderr*/, "Notice: lossy network, %u of the last %lu packets lost. msgid=%d hostname=%.*s text=%.*s\n",
+                    sep->windowlost, seq - sep->windowseq, msgid, FSLATENCY_HOSTNAME_LEN, msgview_hostname(p), FSLATENCY_TEXT_LEN, msgview_text(p));
+            }
+            sep->windowseq = seq;
+            sep->windowlost = 0;
+        }
+        return;
+    }
+    behind = sep->lastseq - seq;
+    if( behind >= SEQ_WINDOW){
+        /* the agent restarted */
+        sep->lastseq = sep->windowseq = seq;
+        sep->seqmask = 1;
+        sep->windowlost = 0;
+    } else if( !(sep->seqmask & ((uint64_t) 1 << behind))){
+        /* late, not lost */
+        sep->seqmask |= (uint64_t) 1 << behind;
+        if( sep->lost > 0){
+            sep->lost --;
+            __atomic_sub_fetch(&global_udplost, 1, __ATOMIC_RELAXED);
+        }
+        if( sep->windowlost > 0){
+            sep->windowlost --;
+        }
+        sep->reordered ++;
+        __atomic_add_fetch(&global_udpreordered, 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+/* the first packet of a new client. Must be called under the lock of the statusdb entry */
+static void seq_start(int msgid, const unsigned char * p)
+{
+    struct statusentry * sep = statusdb + msgid;
+
+    sep->lastseq = sep->windowseq = msgview_sequence(p);
+    sep->seqmask = 1;
+}
+
+/*
+**  alarmer threads
+**
+**
+**
+*/
+
+
+#define WORST_CLIENTS 5  /* in the ALARM lines and in graphite, see fleet_pass() */
+
+struct statnumbers {
+    double minx, maxx, sumx, sumxx, mean, std;
+    uint64_t sumN;
+    uint64_t clients;           /* of the fleet quantiles */
+    double p50, p90, p99;       /* of the window means of the clients */
+    int worstn;
+    struct fleet_topk_entry worst[WORST_CLIENTS];
+    double slo1h, slo24h;       /* compliance of all clients, percent. See slo_pass() */
+    int sloworstn;
+    struct fleet_topk_entry sloworst[WORST_CLIENTS];  /* score: the bad percent of the last hour */
+};
+
+
+static struct statnumbers global_stat;
+static pthread_mutex_t global_stat_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* same operations as in the statusscan kernels, so the exact check agrees with the vectorized one */
+static inline double standard_deviation(double sumN, double sumx, double sumxx){
+        return sqrt((sumxx - sumx*(sumx/sumN))/(sumN-1.0));
+}
+
+
+/*
+** statistical_alarmer
+**   the exact check of one client under its lock. The vectorized pass in statistical_alarmer_loop()
+**   reads hotdb without lock, so it only selects the clients to be checked here.
+**   The bounds are mean +- latencythresholdfactor * std (--detector meanstd), or the precalculated
+**   ones of mad_bounds() (--detector mad). With --profilequantile, hi is at least that quantile
+**   of the long term profile of the client: what was usual in the last hours does not alarm.
+**   The factor and the minimum count are of the detection profile of the client (--rulesfile),
+**   the vectorized pass selects with the lowest ones of all profiles.
+**   Max/min check only for last datablock.
+*/
+static void statistical_alarmer(int msgid)
+{
+    const struct rules_profile * pp;
+    double sumN, mean, std, lo, hi, profilehi;
+
+    pthread_mutex_lock(&(statusdb[msgid].mutex));
+    pp = rulesdb.profile + statusdb[msgid].rule;
+    sumN = hotdb.window.sumN[msgid];
+    if( sumN > pp->minimummeasurementcount){
+        if( DETECTOR_MAD == opt.detector){
+            lo = hotdb.boundlo[msgid];
+            hi = hotdb.boundhi[msgid];
+        } else {
+            mean = hotdb.window.sumx[msgid] / sumN;
+            std = standard_deviation(sumN, hotdb.window.sumx[msgid], hotdb.window.sumxx[msgid]);
+            lo = mean - std * pp->latencythresholdfactor;
+            hi = mean + std * pp->latencythresholdfactor;
+        }
+        if( 0.0 != opt.profilequantile){
+            profilehi = profile_quantile(&(statusdb[msgid].profile), opt.profilequantile);
+            if( PROFILE_NONE != profilehi && hi < profilehi){ /* an immature profile does not constrain */
+                hi = profilehi;
+            }
+        }
+        if( opt.debug > 1){
+            logprintf(2, "DEBUG statistic msgid=%d sumN=%.0f [%f < min=%f max=%f < %f] %s\n", msgid, sumN,
+            lo, hotdb.window.lastmin[msgid], hotdb.window.lastmax[msgid], hi, detector_name(opt.detector));
+        }
+        if( hotdb.window.lastmin[msgid] < lo){
+            alarm_set(msgid, ALARM_STATISTICALALARM_LOW, exp(hotdb.window.lastmin[msgid]), exp(lo));
+        } else {
+            alarm_unset(msgid, ALARM_STATISTICALALARM_LOW, exp(hotdb.window.lastmin[msgid]), exp(lo));
+        }
+        if( hotdb.window.lastmax[msgid] > hi){
+            alarm_set(msgid, ALARM_STATISTICALALARM_HIGH, exp(hotdb.window.lastmax[msgid]), exp(hi));
+        } else {
+            alarm_unset(msgid, ALARM_STATISTICALALARM_HIGH, exp(hotdb.window.lastmax[msgid]), exp(hi));
+        }
+    }else{
+        if( opt.debug > 1){
+            logprintf(2, "DEBUG statistic (low on N) msgid=%d sumN=%.0f min=%f max=%f \n", msgid, sumN,
+                hotdb.window.winmin[msgid], hotdb.window.winmax[msgid]);
+        }
+    }
+    pthread_mutex_unlock(&(statusdb[msgid].mutex));
+}
+
+
+/*
+** fleet_pass
+**   the distribution of the window means of the clients (the sums of all measurements hide a slow client),
+**   and the clients with the highest z-score: (lastmax - mean) / std of their own window, the value
+**   the meanstd detector checks. Only the clients with enough measurements. Reads hotdb without lock,
+**   like the scan kernels. The minimum count is the default one, not of the profile of the client,
+**   so the fleet is compared on the same footing. O(clients * log WORST_CLIENTS)
+*/
+static void fleet_pass(size_t size, struct fleet_sketch * fsp, struct fleet_topk * ftp)
+{
+    double sumN, std;
+    int msgid;
+
+    fleet_sketch_init(fsp);
+    fleet_topk_init(ftp, WORST_CLIENTS);
+    for(msgid = 0; msgid < size; msgid++){
+        sumN = hotdb.window.sumN[msgid];
+        if( sumN <= opt.minimummeasurementcount){
+            continue;
+        }
+        fleet_sketch_add(fsp, hotdb.window.sumx[msgid] / sumN);
+        std = standard_deviation(sumN, hotdb.window.sumx[msgid], hotdb.window.sumxx[msgid]);
+        if( std > 0.0){
+            fleet_topk_offer(ftp, msgid, (hotdb.window.lastmax[msgid] - hotdb.window.sumx[msgid] / sumN) / std);
+        }
+    }
+}
+
+
+/*
+** slo_pass
+**   the compliance of all clients (--slo), and the clients with the lowest compliance in the last hour,
+**   from the sums of their slo (see slo.h). Only the clients with at least SLO_MIN_SECONDS in the last hour
+**   are ranked. Reads the statusdb entries without lock: a sum may be a datablock behind.
+*/
+
+#define SLO_MIN_SECONDS 60
+
+static void slo_pass(size_t size, struct fleet_topk * ftp, double * slo1h, double * slo24h)
+{
+    const struct slo * sp;
+    uint64_t total1h = 0, bad1h = 0, total24h = 0, bad24h = 0;
+    int msgid;
+
+    fleet_topk_init(ftp, WORST_CLIENTS);
+    for(msgid = 0; msgid < size; msgid++){
+        sp = &(statusdb[msgid].slo);
+        total1h += sp->total1h;
+        bad1h += sp->bad1h;
+        total24h += sp->total24h;
+        bad24h += sp->bad24h;
+        if( sp->total1h >= SLO_MIN_SECONDS){
+            fleet_topk_offer(ftp, msgid, 100.0 - slo_compliance(sp->total1h, sp->bad1h));
+        }
+    }
+    *slo1h = slo_compliance(total1h, bad1h);
+    *slo24h = slo_compliance(total24h, bad24h);
+}
+
+
+/* once a minute (--slo): the compliance of all clients, and of the worst ones in the last hour and day */
+static void slo_print(void)
+{
+    struct fleet_topk_entry worst[WORST_CLIENTS];
+    char name[FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN];
+    char line[LOGRING_TEXTLEN];
+    char entry[FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN + 32];
+    char timebuff[TIMEFORMAT_LEN];
+    const struct slo * sp;
+    double slo1h, slo24h;
+    time_t tmp;
+    struct tm tm;
+    int n, i;
+    int len;
+
+    pthread_mutex_lock(&global_stat_lock);
+    slo1h = global_stat.slo1h;
+    slo24h = global_stat.slo24h;
+    n = global_stat.sloworstn;
+    memcpy(worst, global_stat.sloworst, n * sizeof(struct fleet_topk_entry));
+    pthread_mutex_unlock(&global_stat_lock);
+    tmp = time(NULL);
+    strftime(timebuff, sizeof(timebuff), TIMEFORMAT, localtime_r(&tmp, &tm));
+    len = snprintf(line, sizeof(line), "%s SLO %gms compliance 1h:%.3f%% 24h:%.3f%%, worst clients 1h/24h:",
+        timebuff, opt.slo, slo1h, slo24h);
+    for( i=0; i < n; i++){
+        if( -1 == nameregistry_getbyid(&namedb, worst[i].id, name)){
+            continue; /* forgotten meanwhile */
+        }
+        sp = &(statusdb[worst[i].id].slo);
+        snprintf(entry, sizeof(entry), " %.*s(%.*s):%.3f%%/%.3f%%", FSLATENCY_HOSTNAME_LEN, name,
+            FSLATENCY_TEXT_LEN, name + FSLATENCY_HOSTNAME_LEN, slo_compliance(sp->total1h, sp->bad1h),
+            slo_compliance(sp->total24h, sp->bad24h));
+        if( 0 != loglist_append(line, &len, entry)){
+            break;
+        }
+    }
+    logprintf(1, "%s\n", line);
+}
+
+
+/* one pass over all clients, once per second. See statistical_alarmer_loop() and eventloop() */
+static void statistical_alarmer_pass(void)
+{
+    int msgid;
+    size_t size;
+    struct statusscan_total total;
+    struct fleet_sketch sketch;
+    struct fleet_topk top, slotop;
+    double slo1h = 100.0, slo24h = 100.0;
+    static uint32_t slominute; /* of the last SLO line */
+
+    size = clienttable_getsize();
+    /* the lowest thresholds of the profiles: a superset, statistical_alarmer() checks with the own ones */
+    statusscan_threshold(&hotdb.window, size, rulesdb.min.latencythresholdfactor, rulesdb.min.minimummeasurementcount,
+                         hotdb.verdict, &total);
+    if( DETECTOR_MAD == opt.detector){
+        /* the sums of the threshold pass are still needed for the status lines */
+        statusscan_bounds(&hotdb.window, hotdb.boundlo, hotdb.boundhi, size, hotdb.verdict);
+    }
+    for(msgid = 0; msgid < size; msgid++){
+        /* only the suspicious and the already alarmed ones need the exact check */
+        if( hotdb.verdict[msgid] || (hotdb.alarm[msgid] & (ALARM_STATISTICALALARM_LOW | ALARM_STATISTICALALARM_HIGH))){
+            statistical_alarmer(msgid);
+        }
+    }
+    fleet_pass(size, &sketch, &top);
+    if( 0.0 != opt.slo){
+        slo_pass(size, &slotop, &slo1h, &slo24h);
+    }
+
+    pthread_mutex_lock(&global_stat_lock);
+    global_stat.sumN = (uint64_t) total.sumN;
+    global_stat.sumx = total.sumx;
+    global_stat.sumxx = total.sumxx;
+    global_stat.minx = total.minx;
+    global_stat.maxx = total.maxx;
+    global_stat.mean = global_stat.sumx / (double)global_stat.sumN;
+    global_stat.std = standard_deviation(global_stat.sumN, global_stat.sumx, global_stat.sumxx);
+    global_stat.clients = sketch.n;
+    global_stat.p50 = fleet_sketch_quantile(&sketch, 0.5);
+    global_stat.p90 = fleet_sketch_quantile(&sketch, 0.9);
+    global_stat.p99 = fleet_sketch_quantile(&sketch, 0.99);
+    global_stat.worstn = fleet_topk_sorted(&top, global_stat.worst);
+    if( 0.0 != opt.slo){
+        global_stat.slo1h = slo1h;
+        global_stat.slo24h = slo24h;
+        global_stat.sloworstn = fleet_topk_sorted(&slotop, global_stat.sloworst);
+    }
+    pthread_mutex_unlock(&global_stat_lock);
+    if( 0.0 != opt.slo && slo_minute() != slominute){
+        if( 0 != slominute){
+            slo_print(); /* not at the start, there is nothing to tell yet */
+        }
+        slominute = slo_minute();
+    }
+}
+
+
+static void * statistical_alarmer_loop( void * arg)
+{
+    while(1){
+        statistical_alarmer_pass();
+        sleep(1);
+    }
+    return NULL;
+}
+
+
+/*
+** count_alarms
+**   counts[0]: clients with any alarm. See alarmcount() for the others.
+*/
+static inline void count_alarms(unsigned int * counts)
+{
+    statusscan_countalarms(hotdb.alarm, clienttable_getsize(), counts);
+}
+
+static inline unsigned int alarmcount(const unsigned int * counts, const unsigned int alarm_name)
+{
+    return counts[1 + __builtin_ctz(alarm_name)];
+}
+
+
+
+/*
+** timer callbacks: udptimeout_expired, timetoforget_expired, alarmsilencer_expired
+**  called from timer_loop() without any lock held.
+**  A timer may be re-armed between its expiration and the callback (e.g. a packet arrives),
+**  so all of them check it again under the lock of the statusdb entry.
+*/
+
+static void udptimeout_expired(int msgid)
+{
+    pthread_mutex_lock(&(statusdb[msgid].mutex));
+    if( timer_isarmed(msgid, TIMER_UDPTIMEOUT) || 0 == hotdb.lastarrival[msgid]){
+        /* fresh packet arrived or client is forgotten meanwhile */
+        pthread_mutex_unlock(&(statusdb[msgid].mutex));
+        return;
+    }
+    if( opt.debug >1){
+        logprintf(2, "DEBUG udptimeout, msgid=%d\n", msgid);
+    }
+    alarm_set(msgid, ALARM_UDPTIMEOUT, (timer_now() - hotdb.lastarrival[msgid]) * TIMER_TICK_MS / 1000.0,
+        statusdb[msgid].udptimeout * TIMER_TICK_MS / 1000.0);
+    /* keep the alarm alive while the client is lost: check again a second later */
+    timer_arm(msgid, TIMER_UDPTIMEOUT, timer_now(), 1);
+    pthread_mutex_unlock(&(statusdb[msgid].mutex));
+}
+
+
+/*
+** the name is removed under the lock of the statusdb entry, so the receiver that found the msgid
+** before the removal sees the change when it gets the lock. See receiver_loop()
+*/
+static void timetoforget_expired(int msgid)
+{
+    int retval;
+    char buff[FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN];
+    unsigned long lost, reordered;
+
+    pthread_mutex_lock(&global_addremove_lock);
+    pthread_mutex_lock(&(statusdb[msgid].mutex));
+    /* the receiver may have re-armed it meanwhile */
+    if( timer_isarmed(msgid, TIMER_TIMETOFORGET)){
+        pthread_mutex_unlock(&(statusdb[msgid].mutex));
+        pthread_mutex_unlock(&global_addremove_lock);
+        return;
+    }
+    retval = nameregistry_getbyid(&namedb, msgid, buff);
+    lost = statusdb[msgid].lost;
+    reordered = statusdb[msgid].reordered;
+    /* clear it */
+    statusentry_clear(statusdb + msgid);
+    if( -1 != retval){
+        retval = nameregistry_removebyid(&namedb, msgid);
+    }
+    pthread_mutex_unlock(&(statusdb[msgid].mutex));
+    pthread_mutex_unlock(&global_addremove_lock);
+
+    /* formatting out of the locks */
+    if( -1 == retval){
+        logprintf(2 /*stderr*/, "Error: programing flow error: namedb does not contain an entry for statusdb msgid=%d\n. Clear this orphaned statusdb entry.\n", msgid);
+    } else {
+        logprintf(2 /*stderr*/, "Notice: timetoforget, client removed from database. msgid=%d hostname=%.*s text=%.*s packets lost=%lu reordered=%lu\n",
+        msgid, FSLATENCY_HOSTNAME_LEN, buff, FSLATENCY_TEXT_LEN, buff+FSLATENCY_HOSTNAME_LEN, lost, reordered);
+    }
+}
+
+
+static void alarmsilencer_expired(int msgid)
+/* only this function switches off alarms. All others just set. */
+{
+    pthread_mutex_lock(&(statusdb[msgid].mutex));
+    if( timer_isarmed(msgid, TIMER_ALARMSILENCER) || !statusdb[msgid].alarmcounted){
+        /* re-alarmed or forgotten meanwhile */
+        pthread_mutex_unlock(&(statusdb[msgid].mutex));
+        return;
+    }
+    if(opt.debug >1){
+        logprintf(2, "DEBUG alarm status cleared for msgid=%d\n", msgid);
+    }
+    alarm_clear(msgid);
+    statusdb[msgid].alarmcounted = 0;
+    alarmedclients_dec();
+    pthread_mutex_unlock(&(statusdb[msgid].mutex));
+}
+
+
+static void timer_expired(size_t id, void * arg)
+{
+    int msgid = (int)(id / TIMER_KINDS);
+
+    switch( id % TIMER_KINDS){
+        case TIMER_UDPTIMEOUT:
+            udptimeout_expired(msgid);
+            break;
+        case TIMER_TIMETOFORGET:
+            timetoforget_expired(msgid);
+            break;
+        case TIMER_ALARMSILENCER:
+            alarmsilencer_expired(msgid);
+            break;
+    }
+}
+
+
+/*
+** housekeeping thread: timer_loop
+**   advances the timer wheel in every tick. The cost depends on the number of expirations,
+**   not on the number of clients.
+**   It also grows the client table when less than half a chunk is free.
+*/
+
+/* one tick. See timer_loop() and eventloop() */
+static void timer_pass(void)
+{
+    timerwheel_advance(&timerdb, timer_now(), &timer_expired, NULL);
+    /* grow the client table before it is full, so the receiver does not wait for it */
+    if( namedb.used + CLIENTCHUNK / 2 >= clienttable_getsize()){
+        clienttable_grow(clienttable_getsize() + CLIENTCHUNK);
+    }
+}
+
+
+static void * timer_loop( void * arg)
+{
+    struct timespec next;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while(1){
+        next.tv_nsec += TIMER_TICK_MS * 1000000;
+        if( next.tv_nsec >= 1000000000){
+            next.tv_nsec -= 1000000000;
+            next.tv_sec ++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        timer_pass();
+    }
+    return NULL;
+}
+
+
+
+/*
+** flood protection: sourcedb, clientbuckets, registrationbucket
+**   token buckets in fixed memory, used by the receiver thread only (no locks, no atomics).
+**   The source address limit comes first: it is the cheapest, and bounds every later cost
+**   of a flooding host. The client limit bounds a duplicated or replayed stream of one client,
+**   the registration limit the new clients (a flood of unique hostname/text pairs from spoofed addresses).
+**   The burst of the registration bucket is --maxclient: the whole fleet can register at once after a restart.
+**   The shed packets are counted (shed in the status lines).
+*/
+
+#define SOURCEDB_SIZE 4096  /* buckets, 64 KiB */
+#define RATELIMIT_BURST_SEC 2
+
+static struct sourcelimit sourcedb;
+static struct ratelimit clientlimit;
+static struct ratelimit registrationlimit;
+static struct tokenbucket registrationbucket;
+
+static struct {
+    unsigned long source;
+    unsigned long client;
+    unsigned long registration;
+} global_shed; /* __atomic */
+
+
+static int init_ratelimits(void)
+{
+    uint32_t tickspersec = 1000 / TIMER_TICK_MS;
+
+    if( 0 != sourcelimit_init(&sourcedb, SOURCEDB_SIZE, opt.sourcerate, RATELIMIT_BURST_SEC * opt.sourcerate, tickspersec)){
+        return -1;
+    }
+    ratelimit_init(&clientlimit, opt.clientrate, RATELIMIT_BURST_SEC * opt.clientrate, tickspersec);
+    ratelimit_init(&registrationlimit, opt.registrationrate,
+        opt.maxclient > opt.registrationrate ? opt.maxclient : opt.registrationrate, tickspersec);
+    ratelimit_fill(&registrationlimit, &registrationbucket, timer_now());
+    ratelimit_init(&eventlimit, opt.eventrate, opt.eventrate, tickspersec);
+    ratelimit_init(&eventclientlimit, EVENT_CLIENT_PER_MINUTE, EVENT_CLIENT_PER_MINUTE, 60 * tickspersec); /* per minute */
+    return 0;
+}
+
+
+/*
+** packet authentication: auth_valid()
+**   with --authkeyfile every packet must end with the SipHash-2-4 MAC of the messageblock
+**   (FSLATENCY_MAC_LEN bytes, see siphash.h). It is checked before the namedb is touched:
+**   a forged packet cannot register or update a client. The wrong ones are dropped and counted
+**   (authdrops in the status lines). Without --authkeyfile the trailer is ignored, so the agents
+**   can get the key before the data processor.
+*/
+
+static unsigned long global_authdrops; /* __atomic */
+
+
+static inline int auth_valid(const unsigned char * p, int hasmac)
+{
+    if( hasmac && siphash24(p, sizeof(struct messageblock), authkey) == msgview_mac(p)){
+        return 1;
+    }
+    __atomic_add_fetch(&global_authdrops, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+
+/*
+** kernel socket filter: attach_filter(), kernel_drops()
+**   a classic BPF program drops the wrong size, wrong magic and wrong version packets in the kernel,
+**   so they cost no wakeup and no copy. The receiver_loop() checks them again (the filter is optional).
+**   With --authkeyfile only the packets with the MAC trailer pass, without it both sizes pass, and the
+**   0.1 packets too (shorter, no MAC). The version expected for the size is in the X register.
+**   The filter of an UDP socket sees the UDP header (8 bytes) before the payload.
+**   BPF loads words in network (big endian) order, so the expected values are loaded the same way from the bytes.
+*/
+
+#define BPF_UDPHDR_LEN 8
+
+static int receiver_socket = -1; /* for kernel_drops() */
+
+
+static inline uint32_t bpf_word(const unsigned char * p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+
+static int attach_filter(int sfd)
+{
+    struct messageblock expected;
+    const unsigned char * magic = (const unsigned char *) expected.magic;
+    uint32_t version, oldversion;
+    uint32_t maclen = BPF_UDPHDR_LEN + sizeof(struct messageblock) + FSLATENCY_MAC_LEN;
+    uint32_t plainlen = NULL == opt.authkeyfile ? BPF_UDPHDR_LEN + sizeof(struct messageblock) : maclen;
+    uint32_t oldlen = NULL == opt.authkeyfile ? BPF_UDPHDR_LEN + msgview_len(FSLATENCY_VERSION_MINOR_OLDEST) : maclen;
+    struct sock_fprog prog;
+
+    memcpy(expected.magic, FSLATENCY_MAGIC, FSLATENCY_MAGIC_LEN);
+    expected.major = FSLATENCY_VERSION_MAJOR;
+    expected.minor = FSLATENCY_VERSION_MINOR;
+    version = bpf_word((const unsigned char *) &(expected.major)); /* major and minor in one word, as sent */
+    expected.minor = FSLATENCY_VERSION_MINOR_OLDEST;
+    oldversion = bpf_word((const unsigned char *) &(expected.major));
+    {
+        struct sock_filter code[] = {
+            BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, plainlen, 4, 0),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, maclen, 3, 0),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, oldlen, 0, 14),
+            BPF_STMT(BPF_LDX | BPF_W | BPF_IMM, oldversion),
+            BPF_JUMP(BPF_JMP | BPF_JA, 1, 0, 0),
+            BPF_STMT(BPF_LDX | BPF_W | BPF_IMM, version),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, BPF_UDPHDR_LEN + 0),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, bpf_word(magic + 0), 0, 9),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, BPF_UDPHDR_LEN + 4),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, bpf_word(magic + 4), 0, 7),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, BPF_UDPHDR_LEN + 8),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, bpf_word(magic + 8), 0, 5),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, BPF_UDPHDR_LEN + 12),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, bpf_word(magic + 12), 0, 3),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, BPF_UDPHDR_LEN + FSLATENCY_MAGIC_LEN),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_X, 0, 0, 1),
+            BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF), /* accept the whole packet */
+            BPF_STMT(BPF_RET | BPF_K, 0),          /* drop */
+        };
+
+        prog.len = sizeof(code) / sizeof(code[0]);
+        prog.filter = code;
+        return setsockopt(sfd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+    }
+}
+
+
+/* packets dropped by the kernel: filtered out or receive buffer overflow. -1 if unknown */
+static long kernel_drops(void)
+{
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(meminfo);
+
+    if( -1 == receiver_socket || 0 != getsockopt(receiver_socket, SOL_SOCKET, SO_MEMINFO, meminfo, &len)
+        || len <= SK_MEMINFO_DROPS * sizeof(uint32_t)){
+        return -1;
+    }
+    return (long) meminfo[SK_MEMINFO_DROPS];
+}
+
+
+
+/*
+** lost_segments
+**   groups the lost clients (ALARM_UDPTIMEOUT) by network segment (source address / --segmentprefix),
+**   so a partitioned subnet or switch shows up as one segment with all of its clients lost,
+**   apart from the stuck and latency alarms of a frozen datastore. Reads hotdb without lock, like the scans.
+**   Fixed memory: up to SEGMENT_SLOTS segments with lost clients are counted one by one, the rest together.
+**   top: the segments with the most lost clients, by descending lost count. Returns the number of them.
+*/
+
+#define SEGMENT_SLOTS 1024  /* power of 2 */
+#define SEGMENT_TOP 8
+
+struct segmentcount {
+    uint32_t segment;    /* host order */
+    unsigned int lost;   /* 0: empty slot */
+    unsigned int total;  /* known clients in the segment */
+};
+
+static inline uint32_t segment_of(uint32_t srcaddr)
+{
+    return 0 == opt.segmentprefix ? 0 : ntohl(srcaddr) & (0xFFFFFFFFu << (32 - opt.segmentprefix));
+}
+
+static inline struct segmentcount * segment_slot(struct segmentcount * table, uint32_t segment)
+{
+    size_t i = (segment * 2654435761u) >> 22; /* 10 bits: SEGMENT_SLOTS */
+    size_t probe;
+
+    for( probe=0; probe < SEGMENT_SLOTS; probe++){
+        if( 0 == table[i].lost || segment == table[i].segment){
+            return table + i;
+        }
+        i = (i + 1) & (SEGMENT_SLOTS - 1);
+    }
+    return NULL;
+}
+
+
+static int lost_segments(struct segmentcount * top, unsigned int * segments, unsigned int * otherlost)
+{
+    struct segmentcount table[SEGMENT_SLOTS];  /* 12 KiB of the stack */
+    struct segmentcount * sp;
+    size_t size = clienttable_getsize();
+    size_t i;
+    int n = 0;
+    int j;
+
+    memset(table, 0, sizeof(table));
+    *segments = 0;
+    *otherlost = 0;
+    for( i=0; i < size; i++){
+        if( hotdb.alarm[i] & ALARM_UDPTIMEOUT){
+            sp = segment_slot(table, segment_of(hotdb.srcaddr[i]));
+            if( NULL == sp){
+                (*otherlost) ++;
+                continue;
+            }
+            if( 0 == sp->lost){
+                sp->segment = segment_of(hotdb.srcaddr[i]);
+                (*segments) ++;
+            }
+            sp->lost ++;
+        }
+    }
+    if( 0 == *segments){
+        return 0;
+    }
+    for( i=0; i < size; i++){
+        if( 0 != hotdb.lastarrival[i]){
+            sp = segment_slot(table, segment_of(hotdb.srcaddr[i]));
+            if( NULL != sp && 0 != sp->lost){
+                sp->total ++;
+            }
+        }
+    }
+    /* insertion into the short sorted top list */
+    for( i=0; i < SEGMENT_SLOTS; i++){
+        if( 0 == table[i].lost || (SEGMENT_TOP == n && table[i].lost <= top[n - 1].lost)){
+            continue;
+        }
+        j = SEGMENT_TOP == n ? n - 1 : n++;
+        while( j > 0 && top[j - 1].lost < table[i].lost){
+            top[j] = top[j - 1];
+            j --;
+        }
+        top[j] = table[i];
+    }
+    return n;
+}
+
+
+/* the lost by segment line of the alarm status. The caller holds global_alarmstatus_lock */
+static void lost_segments_print(const char * timebuff)
+{
+    struct segmentcount top[SEGMENT_TOP];
+    unsigned int segments, otherlost;
+    char line[SEGMENT_TOP * 48 + 128];
+    char addrbuff[INET_ADDRSTRLEN];
+    uint32_t addr;
+    int n, i;
+    int len;
+
+    n = lost_segments(top, &segments, &otherlost);
+    if( 0 == n){
+        return;
+    }
+    len = 0;
+    for( i=0; i < n; i++){
+        addr = htonl(top[i].segment);
+        inet_ntop(AF_INET, &addr, addrbuff, sizeof(addrbuff));
+        len += snprintf(line + len, sizeof(line) - len, " %s/%d:%u/%u", addrbuff, opt.segmentprefix, top[i].lost, top[i].total);
+    }
+    logprintf(1, "%s ALARM lost by network segment (lost/clients), %u segments:%s%s\n", timebuff, segments, line,
+        segments > (unsigned int) n || otherlost ? " ..." : "");
+}
+
+
+/*
+** periodic reporting loops: normalstatus_loop, alarmstatus_loop
+**   the lines themselves: normalstatus_print(), alarmstatus_print(). The caller holds global_alarmstatus_lock.
+**
+*/
+
+/* the alarmed groups (hits of the last quorum / members now), see groups */
+static void group_alarms_print(const char * timebuff)
+{
+    int ids[GROUP_TOP];
+    unsigned int hits[GROUP_TOP], members[GROUP_TOP];
+    char key[GROUP_KEY_LEN];
+    char line[LOGRING_TEXTLEN];
+    char entry[GROUP_KEY_LEN + 32];
+    unsigned int n, i;
+    int len;
+
+    n = group_alarms(ids, hits, members);
+    if( 0 == n){
+        return;
+    }
+    len = snprintf(line, sizeof(line), "%s ALARM groups (alarmed/clients), %u groups:", timebuff, n);
+    for( i=0; i < n && i < GROUP_TOP; i++){
+        if( -1 == nameregistry_getbyid(&groupdb, ids[i], key)){
+            continue; /* forgotten meanwhile */
+        }
+        snprintf(entry, sizeof(entry), " %.*s:%u/%u", GROUP_KEY_LEN, key, hits[i], members[i]);
+        if( 0 != loglist_append(line, &len, entry)){
+            break;
+        }
+    }
+    if( i == GROUP_TOP && n > GROUP_TOP){
+        loglist_append(line, &len, LOGLIST_MORE);
+    }
+    logprintf(1, "%s\n", line);
+}
+
+
+/* the clients of the highest z-score, see fleet_pass(). With the names of now: a msgid may be reused since then */
+static void worst_clients_print(const char * timebuff)
+{
+    struct fleet_topk_entry worst[WORST_CLIENTS];
+    char name[FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN];
+    char line[LOGRING_TEXTLEN];
+    char entry[FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN + 24];
+    int n, i;
+    int len;
+
+    pthread_mutex_lock(&global_stat_lock);
+    n = global_stat.worstn;
+    memcpy(worst, global_stat.worst, n * sizeof(struct fleet_topk_entry));
+    pthread_mutex_unlock(&global_stat_lock);
+    if( 0 == n){
+        return;
+    }
+    len = snprintf(line, sizeof(line), "%s ALARM worst clients by z-score:", timebuff);
+    for( i=0; i < n; i++){
+        if( -1 == nameregistry_getbyid(&namedb, worst[i].id, name)){
+            continue; /* forgotten meanwhile */
+        }
+        snprintf(entry, sizeof(entry), " %.*s(%.*s):%.1f", FSLATENCY_HOSTNAME_LEN, name,
+            FSLATENCY_TEXT_LEN, name + FSLATENCY_HOSTNAME_LEN, worst[i].score);
+        if( 0 != loglist_append(line, &len, entry)){
+            break;
+        }
+    }
+    logprintf(1, "%s\n", line);
+}
+
+
+/* the SLO part of the status lines (--slo), empty if off. Must be called under global_stat_lock */
+static void slo_format(char * buff, size_t bufflen)
+{
+    buff[0] = '\0';
+    if( 0.0 != opt.slo){
+        snprintf(buff, bufflen, " slo:(%gms 1h:%.3f%% 24h:%.3f%%)", opt.slo, global_stat.slo1h, global_stat.slo24h);
+    }
+}
+
+
+static void normalstatus_print(void)
+{
+    time_t tmp;
+    struct tm tm;
+    char timebuff[TIMEFORMAT_LEN]; /* "2025-01-31T14:45:20+01:00" */
+    char slobuff[64];
+
+    tmp = time(NULL);
+    strftime(timebuff, sizeof(timebuff), TIMEFORMAT, localtime_r(&tmp, &tm));
+    pthread_mutex_lock(&global_stat_lock);
+    slo_format(slobuff, sizeof(slobuff));
+    logprintf(1, "%s Status: normal. Clients: %lu rt: %d kdrops: %ld logdrops: %lu eventdrops: %lu authdrops: %lu shed:(src:%lu cli:%lu reg:%lu) udp:(lost:%lu reord:%lu) ln_ltncy:(N:%lu min:%f max:%f avg:%f std:%f)%s\n",
+        timebuff, namedb.used, __atomic_load_n(&global_rtclients, __ATOMIC_RELAXED), kernel_drops(), __atomic_load_n(&(logdb.dropped), __ATOMIC_RELAXED),
+        __atomic_load_n(&global_eventdrops, __ATOMIC_RELAXED), __atomic_load_n(&global_authdrops, __ATOMIC_RELAXED), __atomic_load_n(&global_shed.source, __ATOMIC_RELAXED),
+        __atomic_load_n(&global_shed.client, __ATOMIC_RELAXED), __atomic_load_n(&global_shed.registration, __ATOMIC_RELAXED),
+        __atomic_load_n(&global_udplost, __ATOMIC_RELAXED), __atomic_load_n(&global_udpreordered, __ATOMIC_RELAXED),
+        global_stat.sumN,global_stat.minx, global_stat.maxx, global_stat.mean, global_stat.std, slobuff);
+    pthread_mutex_unlock(&global_stat_lock);
+}
+
+
+static void alarmstatus_print(void)
+{
+    time_t tmp;
+    struct tm tm;
+    char timebuff[TIMEFORMAT_LEN]; /* "2025-01-31T14:45:20+01:00" */
+    unsigned int counts[STATUSSCAN_COUNTERS];
+    char slobuff[64];
+
+    count_alarms(counts);
+    tmp = time(NULL);
+    strftime(timebuff, sizeof(timebuff), TIMEFORMAT, localtime_r(&tmp, &tm));
+    pthread_mutex_lock(&global_stat_lock);
+    slo_format(slobuff, sizeof(slobuff));
+    logprintf(1, "%s ALARM Clients: %lu rt: %d w/alarms: %d (ltncy lo:%d ltncy hi:%d drift:%d stuck:%d lost:%d (net:%d stall:%d) groups:%u) kdrops: %ld logdrops: %lu eventdrops: %lu authdrops: %lu shed:(src:%lu cli:%lu reg:%lu) udp:(lost:%lu reord:%lu) ln_ltncy:(N:%lu min:%f max:%f avg:%f std:%f) fleet:(clients:%lu p50:%f p90:%f p99:%f)%s\n",
+        timebuff, namedb.used, __atomic_load_n(&global_rtclients, __ATOMIC_RELAXED),
+        counts[0], alarmcount(counts, ALARM_STATISTICALALARM_LOW), alarmcount(counts, ALARM_STATISTICALALARM_HIGH),
+        alarmcount(counts, ALARM_STATISTICALALARM_DRIFT),
+        alarmcount(counts, ALARM_STATISTICALALARM_EMPTYDATABLOCK), alarmcount(counts, ALARM_UDPTIMEOUT),
+        alarmcount(counts, ALARM_UDPTIMEOUT_NET), alarmcount(counts, ALARM_UDPTIMEOUT_STALL), group_alarms(NULL, NULL, NULL),
+        kernel_drops(), __atomic_load_n(&(logdb.dropped), __ATOMIC_RELAXED), __atomic_load_n(&global_eventdrops, __ATOMIC_RELAXED),
+        __atomic_load_n(&global_authdrops, __ATOMIC_RELAXED),
+        __atomic_load_n(&global_shed.source, __ATOMIC_RELAXED), __atomic_load_n(&global_shed.client, __ATOMIC_RELAXED),
+        __atomic_load_n(&global_shed.registration, __ATOMIC_RELAXED), __atomic_load_n(&global_udplost, __ATOMIC_RELAXED),
+        __atomic_load_n(&global_udpreordered, __ATOMIC_RELAXED), global_stat.sumN, global_stat.minx, global_stat.maxx, global_stat.mean, global_stat.std,
+        global_stat.clients, global_stat.p50, global_stat.p90, global_stat.p99, slobuff);
+    pthread_mutex_unlock(&global_stat_lock);
+    group_alarms_print(timebuff);
+    worst_clients_print(timebuff);
+    if( 0 < alarmcount(counts, ALARM_UDPTIMEOUT)){
+        lost_segments_print(timebuff);
+    }
+}
+
+
+void * normalstatus_loop(void *arg)
+{
     while(1){
-        clock_gettime(CLOCK_REALTIME, &deadline);
-        deadline.tv_sec -= opt.timetoforget;
-        for(msgid = 0; msgid < opt.maxclient; msgid++){
-            /* some quickie without lock */
-            if( timespec_zero(&(statusdb[msgid].lastarrival))){ /* empty slot*/
-                continue;
+        sleep(opt.statusperiod);
+        pthread_mutex_lock(&global_alarmstatus_lock);
+        if( global_alarmstatus){
+            pthread_cond_wait(&global_normalstatus_cond, &global_alarmstatus_lock);
+        }
+        normalstatus_print();
+        pthread_mutex_unlock(&global_alarmstatus_lock);
+
+    }
+}
+
+
+void * alarmstatus_loop(void *arg)
+{
+    while(1){
+        sleep(opt.alarmstatusperiod);
+        pthread_mutex_lock(&global_alarmstatus_lock);
+        if( !global_alarmstatus){
+            pthread_cond_wait(&global_alarmstatus_cond, &global_alarmstatus_lock);
+        }
+        alarmstatus_print();
+        pthread_mutex_unlock(&global_alarmstatus_lock);
+    }
+}
+
+
+/*
+** heatmap (--heatmap client|group)
+**   the datablocks of every client are counted by their max latency in HEATMAP_BUCKETS log2 buckets,
+**   in window_add() (O(1) per datablock, no ring rescan), for the heatmap panels of grafana.
+**   Once per graphite period heatmap_snapshot() takes and zeroes the counts of the clients (or sums
+**   them up by group), and heatmap_format() formats the lines of the non-zero buckets from a cursor
+**   into a buffer, so they go out in a few large writes (graphite_loop()), or a buffer at a time
+**   as the socket drains (graphite_send()). Lines: base.heatmap.NAME.BOUND COUNT TIME,
+**   NAME: hostname_text or the group key ([A-Za-z0-9_-] only), BOUND: the upper limit in usec
+**   (64 ... 1048576, inf). An empty datablock (stuck agent) is counted in inf.
+**   The snapshot of the clients is a client array (heatmapcounts), it grows with the client table.
+**   The snapshot is taken every period, even if graphite is unreachable, so the counts never saturate.
+*/
+
+#define HEATMAP_BUFF_LEN 65536
+#define HEATMAP_PATH_LEN (FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN + 2)
+
+static struct {
+    uint32_t (*counts)[HEATMAP_BUCKETS];  /* per msgid (heatmapcounts) or group id */
+    size_t n;        /* in the last snapshot */
+    size_t cursor;   /* the next one to format */
+    time_t time;     /* of the last snapshot */
+} heatmapdb;
+
+static char heatmap_buff[HEATMAP_BUFF_LEN];
+
+
+static int init_heatmap(void)
+{
+    if( HEATMAP_GROUP == opt.heatmap){
+        heatmapdb.counts = (uint32_t (*)[HEATMAP_BUCKETS]) calloc(GROUP_MAX, sizeof(uint32_t) * HEATMAP_BUCKETS);
+    } else {
+        heatmapdb.counts = heatmapcounts;
+    }
+    heatmapdb.n = heatmapdb.cursor = 0;
+    return NULL == heatmapdb.counts ? -1 : 0;
+}
+
+
+static void heatmap_snapshot(void)
+{
+    size_t size = clienttable_getsize();
+    size_t msgid;
+    int group;
+    int b;
+
+    heatmapdb.time = time(NULL);
+    heatmapdb.cursor = 0;
+    if( HEATMAP_GROUP == opt.heatmap){
+        memset(heatmapdb.counts, 0, GROUP_MAX * sizeof(uint32_t) * HEATMAP_BUCKETS);
+        heatmapdb.n = GROUP_MAX;
+    } else {
+        heatmapdb.n = size;
+    }
+    for( msgid=0; msgid < size; msgid++){
+        pthread_mutex_lock(&(statusdb[msgid].mutex));
+        group = statusdb[msgid].group;
+        for( b=0; b < HEATMAP_BUCKETS; b++){
+            if( HEATMAP_CLIENT == opt.heatmap){
+                heatmapdb.counts[msgid][b] = statusdb[msgid].heatmap[b];
+            } else if( GROUP_NONE != group){
+                heatmapdb.counts[group][b] += statusdb[msgid].heatmap[b];
             }
-            if( timespec_gt(&(statusdb[msgid].lastarrival), &deadline)){ /*fresh*/
+        }
+        memset(statusdb[msgid].heatmap, 0, sizeof(statusdb[msgid].heatmap));
+        pthread_mutex_unlock(&(statusdb[msgid].mutex));
+    }
+}
+
+
+/* the name of the client or group as a node of the metric path */
+static void heatmap_path(size_t id, char * path)
+{
+    char name[FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN];
+    size_t i, len = 0;
+
+    path[0] = '\0';
+    if( HEATMAP_GROUP == opt.heatmap){
+        memset(name, 0, sizeof(name));
+        if( -1 == nameregistry_getbyid(&groupdb, id, name)){
+            return;
+        }
+    } else if( -1 == nameregistry_getbyid(&namedb, id, name)){
+        return; /* forgotten meanwhile */
+    }
+    for( i=0; i < FSLATENCY_HOSTNAME_LEN && '\0' != name[i]; i++){
+        path[len ++] = name[i];
+    }
+    if( HEATMAP_CLIENT == opt.heatmap && '\0' != name[FSLATENCY_HOSTNAME_LEN]){
+        path[len ++] = '_';
+        for( i=FSLATENCY_HOSTNAME_LEN; i < sizeof(name) && '\0' != name[i]; i++){
+            path[len ++] = name[i];
+        }
+    }
+    path[len] = '\0';
+    for( i=0; i < len; i++){
+        if( !(isalnum((unsigned char) path[i]) || '-' == path[i] || '_' == path[i])){
+            path[i] = '_';
+        }
+    }
+}
+
+
+/* the lines of the next clients (groups) of the snapshot into buff. Returns the length, 0 at the end */
+static int heatmap_format(char * buff, size_t bufflen)
+{
+    const size_t maxline = strlen(opt.graphitebase) + HEATMAP_PATH_LEN + 64;
+    char path[HEATMAP_PATH_LEN];
+    const uint32_t * counts;
+    size_t len = 0;
+    int b, any;
+
+    for( ; heatmapdb.cursor < heatmapdb.n && len + HEATMAP_BUCKETS * maxline < bufflen; heatmapdb.cursor ++){
+        counts = heatmapdb.counts[heatmapdb.cursor];
+        for( any=0, b=0; b < HEATMAP_BUCKETS; b++){
+            any |= 0 != counts[b];
+        }
+        if( !any){
+            continue;
+        }
+        heatmap_path(heatmapdb.cursor, path);
+        if( '\0' == path[0]){
+            continue;
+        }
+        for( b=0; b < HEATMAP_BUCKETS; b++){
+            if( 0 == counts[b]){
                 continue;
             }
-            pthread_mutex_lock(&global_addremove_lock);
-            clock_gettime(CLOCK_REALTIME, &deadline); /* ujra kell kerni, mert a lock() barmeddig tarthat */
-            deadline.tv_sec -= opt.timetoforget;
-            /* itt nem lehet empty, mert ez az egyetlen thread, ami torol.
-            De lehet fresh, mert lehet, hogy ido kozben a receiver rakott bele.
-            */
-            if( timespec_gt(&(statusdb[msgid].lastarrival), &deadline)){ /*fresh*/
-                pthread_mutex_unlock(&global_addremove_lock);
+            if( HEATMAP_BUCKETS - 1 == b){
+                len += snprintf(buff + len, bufflen - len, "%s.heatmap.%s.inf %u %ld\n",
+                    opt.graphitebase, path, counts[b], heatmapdb.time);
+            } else {
+                len += snprintf(buff + len, bufflen - len, "%s.heatmap.%s.%lu %u %ld\n",
+                    opt.graphitebase, path, 1UL << (b + HEATMAP_LOW_LOG2_US), counts[b], heatmapdb.time);
+            }
+        }
+    }
+    return (int) len;
+}
+
+
+/*
+** graphite_format
+**   formats the status and data in graphite plaintext input format into buff.
+**   Returns the length. All lines are sent with one write().
+*/
+
+#define GRAPHITE_BUFF_LEN 4096
+
+static int graphite_format(char * buff, size_t bufflen)
+{
+    time_t curtime;
+    unsigned int counts[STATUSSCAN_COUNTERS];
+    double minx, maxx, mean, std, p50, p90, p99, slo1h, slo24h;
+    uint64_t sumN;
+    struct fleet_topk_entry worst[WORST_CLIENTS];
+    struct fleet_topk_entry sloworst[WORST_CLIENTS];
+    int worstn, sloworstn, i;
+    struct segmentcount top[SEGMENT_TOP];
+    unsigned int segments = 0, otherlost;
+    int len = 0;
+
+    curtime = time(NULL);
+    count_alarms(counts);
+    if( 0 < alarmcount(counts, ALARM_UDPTIMEOUT)){
+        lost_segments(top, &segments, &otherlost);
+    }
+    pthread_mutex_lock(&global_stat_lock);
+    minx = global_stat.minx;
+    maxx = global_stat.maxx;
+    mean = global_stat.mean;
+    std = global_stat.std;
+    sumN = global_stat.sumN;
+    p50 = global_stat.p50;
+    p90 = global_stat.p90;
+    p99 = global_stat.p99;
+    worstn = global_stat.worstn;
+    memcpy(worst, global_stat.worst, worstn * sizeof(struct fleet_topk_entry));
+    slo1h = global_stat.slo1h;
+    slo24h = global_stat.slo24h;
+    sloworstn = global_stat.sloworstn;
+    memcpy(sloworst, global_stat.sloworst, sloworstn * sizeof(struct fleet_topk_entry));
+    pthread_mutex_unlock(&global_stat_lock);
+
+#define GRAPHITE_LINE(...) len += snprintf(buff + len, bufflen - len, __VA_ARGS__)
+    GRAPHITE_LINE("%s.totalclients %lu %ld\n", opt.graphitebase, namedb.used, curtime);
+    GRAPHITE_LINE("%s.rtclients %d %ld\n", opt.graphitebase, __atomic_load_n(&global_rtclients, __ATOMIC_RELAXED), curtime);
+    GRAPHITE_LINE("%s.alarmedclients %u %ld\n", opt.graphitebase, counts[0], curtime);
+    GRAPHITE_LINE("%s.latencylow %u %ld\n", opt.graphitebase, alarmcount(counts, ALARM_STATISTICALALARM_LOW), curtime);
+    GRAPHITE_LINE("%s.latencyhigh %u %ld\n", opt.graphitebase, alarmcount(counts, ALARM_STATISTICALALARM_HIGH), curtime);
+    GRAPHITE_LINE("%s.latencydrift %u %ld\n", opt.graphitebase, alarmcount(counts, ALARM_STATISTICALALARM_DRIFT), curtime);
+    GRAPHITE_LINE("%s.stuckedclients %u %ld\n", opt.graphitebase, alarmcount(counts, ALARM_STATISTICALALARM_EMPTYDATABLOCK), curtime);
+    GRAPHITE_LINE("%s.lostclients %u %ld\n", opt.graphitebase, alarmcount(counts, ALARM_UDPTIMEOUT), curtime);
+    GRAPHITE_LINE("%s.netlostclients %u %ld\n", opt.graphitebase, alarmcount(counts, ALARM_UDPTIMEOUT_NET), curtime);
+    GRAPHITE_LINE("%s.stalledclients %u %ld\n", opt.graphitebase, alarmcount(counts, ALARM_UDPTIMEOUT_STALL), curtime);
+    GRAPHITE_LINE("%s.lostsegments %u %ld\n", opt.graphitebase, segments, curtime);
+    GRAPHITE_LINE("%s.groupalarms %u %ld\n", opt.graphitebase, group_alarms(NULL, NULL, NULL), curtime);
+    GRAPHITE_LINE("%s.udp.lost %lu %ld\n", opt.graphitebase, __atomic_load_n(&global_udplost, __ATOMIC_RELAXED), curtime);
+    GRAPHITE_LINE("%s.udp.reordered %lu %ld\n", opt.graphitebase, __atomic_load_n(&global_udpreordered, __ATOMIC_RELAXED), curtime);
+    GRAPHITE_LINE("%s.kerneldrops %ld %ld\n", opt.graphitebase, kernel_drops(), curtime);
+    GRAPHITE_LINE("%s.logdrops %lu %ld\n", opt.graphitebase, __atomic_load_n(&(logdb.dropped), __ATOMIC_RELAXED), curtime);
+    GRAPHITE_LINE("%s.eventdrops %lu %ld\n", opt.graphitebase, __atomic_load_n(&global_eventdrops, __ATOMIC_RELAXED), curtime);
+    GRAPHITE_LINE("%s.authdrops %lu %ld\n", opt.graphitebase, __atomic_load_n(&global_authdrops, __ATOMIC_RELAXED), curtime);
+    GRAPHITE_LINE("%s.shed.source %lu %ld\n", opt.graphitebase, __atomic_load_n(&global_shed.source, __ATOMIC_RELAXED), curtime);
+    GRAPHITE_LINE("%s.shed.client %lu %ld\n", opt.graphitebase, __atomic_load_n(&global_shed.client, __ATOMIC_RELAXED), curtime);
+    GRAPHITE_LINE("%s.shed.registration %lu %ld\n", opt.graphitebase, __atomic_load_n(&global_shed.registration, __ATOMIC_RELAXED), curtime);
+    GRAPHITE_LINE("%s.ln_latency.datapoints %lu %ld\n", opt.graphitebase, sumN, curtime);
+    GRAPHITE_LINE("%s.ln_latency.min %f %ld\n", opt.graphitebase, minx, curtime);
+    GRAPHITE_LINE("%s.ln_latency.max %f %ld\n", opt.graphitebase, maxx, curtime);
+    GRAPHITE_LINE("%s.ln_latency.mean %f %ld\n", opt.graphitebase, mean, curtime);
+    GRAPHITE_LINE("%s.ln_latency.std %f %ld\n", opt.graphitebase, std, curtime);
+    GRAPHITE_LINE("%s.fleet.p50 %f %ld\n", opt.graphitebase, p50, curtime);
+    GRAPHITE_LINE("%s.fleet.p90 %f %ld\n", opt.graphitebase, p90, curtime);
+    GRAPHITE_LINE("%s.fleet.p99 %f %ld\n", opt.graphitebase, p99, curtime);
+    for( i=0; i < worstn; i++){
+        /* by rank: the names would make a new series for every client */
+        GRAPHITE_LINE("%s.fleet.worstz.%d %f %ld\n", opt.graphitebase, i + 1, worst[i].score, curtime);
+    }
+    if( 0.0 != opt.slo){
+        GRAPHITE_LINE("%s.slo.1h %f %ld\n", opt.graphitebase, slo1h, curtime);
+        GRAPHITE_LINE("%s.slo.24h %f %ld\n", opt.graphitebase, slo24h, curtime);
+        for( i=0; i < sloworstn; i++){
+            GRAPHITE_LINE("%s.slo.worst.%d %f %ld\n", opt.graphitebase, i + 1, 100.0 - sloworst[i].score, curtime);
+        }
+    }
+#undef GRAPHITE_LINE
+    return len < bufflen ? len : bufflen - 1;
+}
+
+
+void * graphite_loop(void *arg)
+/* send status and data to graphite server in graphithe plaintext input format*/
+{
+    char buff[GRAPHITE_BUFF_LEN];
+    int len;
+    int retval;
+    int gfd;
+
+    while(1){
+        sleep(60);
+        len = graphite_format(buff, sizeof(buff));
+        if( HEATMAP_NONE != opt.heatmap){
+            heatmap_snapshot(); /* even if it cannot be sent, see heatmap */
+        }
+
+        if( NULL != opt.graphiteip){
+            gfd = socket(AF_INET, SOCK_STREAM, 0);
+            if( -1 == gfd){
+                perror("Error: cannot allocate socket to graphite");
                 continue;
             }
-            retval = nameregistry_getbyid(&namedb, msgid, buff);
+
+            retval = connect(gfd, (struct sockaddr *) &(opt.graphiteaddr), sizeof(opt.graphiteaddr));
             if( -1 == retval){
-                dprintf(2 /*stderr*/, "Error: programing flow error: namedb does not contain an entry for statusdb msgid=%d\n. Clear this orphaned statusdb entry.\n", msgid);
-                statusentry_clear(statusdb + msgid);
-            } else {
-                dprintf(2 /*stderr*/, "Notice: timetoforget, client removed from database. msgid=%d hostname=%.*s text=%.*s\n",
-                msgid, FSLATENCY_HOSTNAME_LEN, buff, FSLATENCY_TEXT_LEN, buff+FSLATENCY_HOSTNAME_LEN);
-                /* clear it */
-                statusentry_clear(statusdb + msgid);
-                retval = nameregistry_removebyid(&namedb, msgid);
-                if( -1 == retval){
-                    dprintf(2 /*stderr*/, "Error: programing flow error: possibly inconsistent namedb. %s %d\n", __FILE__, __LINE__);
+                perror("Error: cannot connect to graphite");
+                close(gfd);
+                continue;
+            }
+            if( opt.debug >1){
+                logprintf(2, "DEBUG graphite connection established to %s:%u via fd=%d\n",
+                    inet_ntoa(opt.graphiteaddr.sin_addr), ntohs(opt.graphiteaddr.sin_port), gfd);
+            }
+        }else{
+            gfd = 1;
+        }
+
+        if( len != write(gfd, buff, len)){
+            perror("Error: cannot send to graphite");
+        }
+        if( HEATMAP_NONE != opt.heatmap){
+            while( 0 < (len = heatmap_format(heatmap_buff, sizeof(heatmap_buff)))){
+                if( len != write(gfd, heatmap_buff, len)){
+                    perror("Error: cannot send the heatmap to graphite");
+                    break;
                 }
             }
-            pthread_mutex_unlock(&global_addremove_lock);
-        } /* end for msgid */
-        sleep(1);
-    } /* end while 1 */
+        }
+        if(  NULL != opt.graphiteip){
+            shutdown(gfd, SHUT_RDWR);
+            close(gfd);
+        }
+    }
     return NULL;
 }
 
+/*
+** history queries (--historymb) on the loopback interface, TCP port --port. One query line per connection:
+**     client FROM TO HOSTNAME [TEXT]   the text is the rest of the line, it can have spaces
+**     group FROM TO KEY                the current members of a --groupby group
+**   FROM and TO are unix times, 0 and the negative ones are relative to now (client -3600 0 esx12 ds3).
+**   The answer is a line per sample: HOSTNAME(TEXT) UNIXTIME MIN MAX MEAN (ln(ms), "empty" for an empty
+**   datablock), and an "end: N samples" line, or an "error: ..." line.
+**   The connections are served one after the other by the history thread. The chain of the chunks of
+**   a client is followed HISTORY_FIND_BATCH chunks at a time, and the chunks are copied one at a time,
+**   each under history_lock, so the receiver waits at most for a few dozen chunk headers or a copy.
+**   The answer has the newest HISTORY_QUERY_CHUNKS chunks of a client in the time range at most.
+*/
+#define HISTORY_QUERY_LEN 512
+#define HISTORY_QUERY_CHUNKS 4096  /* about 2 days of a client: 40 samples per chunk or more */
+#define HISTORY_FIND_BATCH 64
+#define HISTORY_REPLY_LEN 65536
+#define HISTORY_TIMEOUT_SEC 5   /* of the reading of the query and of the writing of the answer */
+
+struct history_reply {
+    int fd;
+    int len;
+    int failed; /* bool: the client is gone or too slow, the rest is thrown away */
+    char buff[HISTORY_REPLY_LEN];
+};
+
+static int history_fd = -1;
+static struct history_reply * history_replybuff;
+static uint64_t * history_epochs; /* of the chunks of a client, HISTORY_QUERY_CHUNKS. See history_client() */
 
 
-static void * alarmsilencer_loop( void * arg)
-/* only this function switches off alarms. All others just set. */
+static void history_flush(struct history_reply * rp)
 {
-    int msgid;
-    struct timespec deadline;
-    int some_alarm;
+    if( !rp->failed && 0 < rp->len && rp->len != send(rp->fd, rp->buff, rp->len, MSG_NOSIGNAL)){
+        rp->failed = 1;
+    }
+    rp->len = 0;
+}
 
-    while(1){
-        clock_gettime(CLOCK_REALTIME, &deadline);
-        deadline.tv_sec -= opt.alarmtimeout;
-        some_alarm = 0;
-        for(msgid = 0; msgid < opt.maxclient; msgid++){
-            /* some quickie without lock */
-            if( timespec_zero(&(statusdb[msgid].lastarrival))){ /* empty slot*/
+
+static void history_printf(struct history_reply * rp, const char * format, ...) __attribute__ ((format (printf, 2, 3)));
+static void history_printf(struct history_reply * rp, const char * format, ...)
+{
+    va_list ap;
+    int len;
+
+    if( HISTORY_REPLY_LEN - rp->len < HISTORY_QUERY_LEN){
+        history_flush(rp);
+    }
+    va_start(ap, format);
+    len = vsnprintf(rp->buff + rp->len, HISTORY_QUERY_LEN, format, ap);
+    va_end(ap);
+    if( 0 < len){
+        rp->len += len < HISTORY_QUERY_LEN ? len : HISTORY_QUERY_LEN - 1;
+    }
+}
+
+
+/* the samples of a client between from and to. name: the hostname and the text, zero padded. Returns their number */
+static unsigned long history_client(struct history_reply * rp, const char * name, uint32_t from, uint32_t to)
+{
+    struct history_chunk chunk;
+    struct history_sample samples[HISTORY_CHUNK_SAMPLES];
+    unsigned long count = 0;
+    uint64_t key = history_key(name);
+    uint64_t cursor = 0;
+    size_t nchunks = 0, c;
+    size_t batch;
+    int n, i;
+
+    do { /* the newest first */
+        batch = HISTORY_QUERY_CHUNKS - nchunks < HISTORY_FIND_BATCH ? HISTORY_QUERY_CHUNKS - nchunks : HISTORY_FIND_BATCH;
+        pthread_mutex_lock(&history_lock);
+        nchunks += history_find(&historydb, key, &cursor, from, to, history_epochs + nchunks, batch);
+        pthread_mutex_unlock(&history_lock);
+    } while( 0 != cursor && nchunks < HISTORY_QUERY_CHUNKS);
+    for( c=nchunks; c > 0 && !rp->failed; c--){
+        pthread_mutex_lock(&history_lock);
+        memcpy(&chunk, historydb.chunks + HISTORY_INDEX(&historydb, history_epochs[c - 1]), sizeof(chunk));
+        pthread_mutex_unlock(&history_lock);
+        if( chunk.epoch != history_epochs[c - 1]){
+            continue; /* recycled meanwhile */
+        }
+        n = history_decode(&chunk, samples);
+        for( i=0; i < n; i++){
+            if( samples[i].time < from || samples[i].time > to){
                 continue;
             }
-            if( opt.debug > 2){
-                dprintf(2, "DEBUG in alarmsilencer_loop global_alarmstatus=%d msgid=%d lastalarmtime=%ld.%09ld deadline=%ld.%09ld alarm=%d\n",
-                    global_alarmstatus, msgid, statusdb[msgid].lastalarmtime.tv_sec, statusdb[msgid].lastalarmtime.tv_nsec,
-                    deadline.tv_sec, deadline.tv_nsec, statusdb[msgid].alarm);
+            if( isnan(samples[i].value[0])){
+                history_printf(rp, "%.*s(%.*s) %u empty\n", FSLATENCY_HOSTNAME_LEN, name,
+                    FSLATENCY_TEXT_LEN, name + FSLATENCY_HOSTNAME_LEN, samples[i].time);
+            } else {
+                history_printf(rp, "%.*s(%.*s) %u %f %f %f\n", FSLATENCY_HOSTNAME_LEN, name,
+                    FSLATENCY_TEXT_LEN, name + FSLATENCY_HOSTNAME_LEN, samples[i].time,
+                    samples[i].value[0], samples[i].value[1], samples[i].value[2]);
+            }
+            count ++;
+        }
+    }
+    return count;
+}
+
+
+static void history_query(struct history_reply * rp, char * line)
+{
+    char name[FSLATENCY_HOSTNAME_LEN + FSLATENCY_TEXT_LEN];
+    char key[GROUP_KEY_LEN];
+    char kind[8];
+    unsigned long count = 0;
+    long from, to;
+    time_t now = time(NULL);
+    char * rest;
+    char * space;
+    size_t id;
+    int gid;
+    int off = -1;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    if( 3 != sscanf(line, "%7s %ld %ld %n", kind, &from, &to, &off) || -1 == off){
+        history_printf(rp, "error: usage: client FROM TO HOSTNAME [TEXT] | group FROM TO KEY\n");
+        return;
+    }
+    rest = line + off;
+    from = from > 0 ? from : now + from;
+    to = to > 0 ? to : now + to;
+    from = from < 0 ? 0 : from > UINT32_MAX ? UINT32_MAX : from;
+    to = to < 0 ? 0 : to > UINT32_MAX ? UINT32_MAX : to;
+    if( 0 == strcmp(kind, "client")){
+        memset(name, 0, sizeof(name));
+        space = strchr(rest, ' ');
+        if( NULL != space){
+            *space = '\0';
+        }
+        if( '\0' == rest[0] || FSLATENCY_HOSTNAME_LEN < strlen(rest)
+            || (NULL != space && FSLATENCY_TEXT_LEN < strlen(space + 1))){
+            history_printf(rp, "error: no hostname, or too long hostname or text\n");
+            return;
+        }
+        memcpy(name, rest, strlen(rest));
+        if( NULL != space){
+            memcpy(name + FSLATENCY_HOSTNAME_LEN, space + 1, strlen(space + 1));
+        }
+        count = history_client(rp, name, from, to);
+    } else if( 0 == strcmp(kind, "group")){
+        memset(key, 0, sizeof(key));
+        if( GROUPBY_NONE == opt.groupby){
+            history_printf(rp, "error: no groups without --groupby\n");
+            return;
+        }
+        if( '\0' == rest[0] || GROUP_KEY_LEN < strlen(rest)){
+            history_printf(rp, "error: no key, or too long key\n");
+            return;
+        }
+        memcpy(key, rest, strlen(rest));
+        gid = nameregistry_find(&groupdb, key);
+        if( -1 == gid){
+            history_printf(rp, "error: unknown group\n");
+            return;
+        }
+        for( id=0; id < clienttable_getsize() && !rp->failed; id++){
+            if( gid == __atomic_load_n(&(statusdb[id].group), __ATOMIC_RELAXED)
+                && -1 != nameregistry_getbyid(&namedb, id, name)){
+                count += history_client(rp, name, from, to);
+            }
+        }
+    } else {
+        history_printf(rp, "error: unknown query %s\n", kind);
+        return;
+    }
+    history_printf(rp, "end: %lu samples\n", count);
+}
+
+
+/* the listening socket and the buffers of the history thread. Returns -1 on error */
+static int history_listen(void)
+{
+    struct sockaddr_in addr;
+    int one = 1;
+
+    history_replybuff = (struct history_reply *) malloc(sizeof(struct history_reply));
+    history_epochs = (uint64_t *) malloc(HISTORY_QUERY_CHUNKS * sizeof(uint64_t));
+    if( NULL == history_replybuff || NULL == history_epochs){
+        dprintf(2 /*stderr*/, "Error: cannot allocate memory for the history queries\n");
+        return -1;
+    }
+    history_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if( -1 == history_fd){
+        perror("Error: cannot allocate socket for the history queries");
+        return -1;
+    }
+    setsockopt(history_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if( 0 != bind(history_fd, (struct sockaddr *) &addr, sizeof(addr)) || 0 != listen(history_fd, 4)){
+        perror("Error: cannot listen for the history queries");
+        close(history_fd);
+        return -1;
+    }
+    return 0;
+}
+
+
+void * history_loop(void * arg)
+{
+    struct timeval timeout = {HISTORY_TIMEOUT_SEC, 0};
+    char line[HISTORY_QUERY_LEN];
+    size_t len;
+    ssize_t retval;
+    int cfd;
+
+    while(1){
+        cfd = accept(history_fd, NULL, NULL);
+        if( -1 == cfd){
+            continue;
+        }
+        setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(cfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        len = 0;
+        while( len < sizeof(line) - 1 && NULL == memchr(line, '\n', len)){
+            retval = recv(cfd, line + len, sizeof(line) - 1 - len, 0);
+            if( retval <= 0){
+                break;
+            }
+            len += retval;
+        }
+        line[len] = '\0';
+        if( opt.debug){
+            logprintf(2, "DEBUG history query: %.*s\n", (int) strcspn(line, "\r\n"), line);
+        }
+        history_replybuff->fd = cfd;
+        history_replybuff->len = 0;
+        history_replybuff->failed = 0;
+        history_query(history_replybuff, line);
+        history_flush(history_replybuff);
+        close(cfd);
+    }
+    return NULL;
+}
+
+
+/*
+** receive_packet
+**   processes one packet in place: the fields are read from the receive buffer through msgview.h,
+**   and only the new datablocks are converted into the ring of the client (window_add()).
+**   srcaddr: the IPv4 source address (network order)
+*/
+static void receive_packet(const unsigned char * p, size_t len, uint32_t srcaddr, uint64_t rectick)
+{
+    struct timespec starttime;
+    struct datablock debugblock;
+    int msgid;
+    int i;
+    int hasmac = 0;
+    char addrbuff[INET_ADDRSTRLEN];
+
+    if( !sourcelimit_take(&sourcedb, srcaddr, rectick)){
+        __atomic_add_fetch(&global_shed.source, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if( sizeof(struct messageblock) + FSLATENCY_MAC_LEN == len){
+        hasmac = 1;
+        len = sizeof(struct messageblock);
+    }
+    if( !msgview_valid(p, len)){
+        if(opt.debug){
+            if( len < offsetof(struct messageblock, hostname)){
+                logprintf(2, "DEBUG received packed dropped because of wrong size.\n");
+            } else if( (FSLATENCY_VERSION_MAJOR != msgview_major(p)) || 0 == msgview_len(msgview_minor(p))){
+                logprintf(2, "DEBUG received packed dropped because of wrong version. Requires: %d.%d or %d.%d received: %d.%d\n",
+                    FSLATENCY_VERSION_MAJOR,FSLATENCY_VERSION_MINOR, FSLATENCY_VERSION_MAJOR, FSLATENCY_VERSION_MINOR_OLDEST,
+                    msgview_major(p), msgview_minor(p));
+            } else if( msgview_len(msgview_minor(p)) != len){
+                logprintf(2, "DEBUG received packed dropped because of wrong size.\n");
+            } else {
+                logprintf(2, "DEBUG received packed dropped because of wrong magic.\n");
+            }
+        }
+        return; /*silently drop*/
+    }
+    if( NULL != opt.authkeyfile && !auth_valid(p, hasmac)){
+        if(opt.debug){
+            logprintf(2, "DEBUG received packed dropped because of %s MAC. hostname: %.*s\n",
+                hasmac ? "wrong" : "missing", FSLATENCY_HOSTNAME_LEN, msgview_hostname(p));
+        }
+        return;
+    }
+    if( opt.debug > 2  ){ /* undocumented --debug=3 */
+        logprintf(2, "Received:\n");
+        logprintf(2, "  magic %.*s\n", FSLATENCY_MAGIC_LEN, p + offsetof(struct messageblock, magic));
+        logprintf(2, "  hostname %.*s\n", FSLATENCY_HOSTNAME_LEN, msgview_hostname(p));
+        logprintf(2, "  text %.*s\n", FSLATENCY_TEXT_LEN, msgview_text(p));
+        logprintf(2, "  version: %d.%d\n", msgview_major(p), msgview_minor(p));
+        memcpy(&starttime, p + offsetof(struct messageblock, precision), sizeof(starttime));
+        logprintf(2, "  precision: %ld.%09ld sec\n", starttime.tv_sec, starttime.tv_nsec);
+        for( i=0; i < 2; i++){
+            memcpy(&debugblock, MSGVIEW_BLOCK(p, i), sizeof(debugblock));
+            datablock_print(&debugblock);
+        }
+    }
+
+    /* known client: lock-free lookup. The msgid may be forgotten and reused between the lookup
+       and the lock of the entry, so the name is checked again under the lock. */
+    msgid = nameregistry_find(&namedb, msgview_name(p)); /* hostname+text both */
+    if( -1 != msgid){
+        pthread_mutex_lock(&(statusdb[msgid].mutex));
+        if( !nameregistry_check(&namedb, msgid, msgview_name(p))){
+            pthread_mutex_unlock(&(statusdb[msgid].mutex));
+            msgid = -1;
+        } else if( !ratelimit_take(&clientlimit, clientbuckets + msgid, rectick)){
+            pthread_mutex_unlock(&(statusdb[msgid].mutex));
+            __atomic_add_fetch(&global_shed.client, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    if( -1 == msgid){
+        /* new client: the writer path */
+        if( !ratelimit_take(&registrationlimit, &registrationbucket, rectick)){
+            __atomic_add_fetch(&global_shed.registration, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        pthread_mutex_lock(&global_addremove_lock);
+        msgid = nameregistry_add(&namedb, msgview_name(p)); /* hostname+text both */
+        if( -1 == msgid && 0 == clienttable_grow(namedb.size + 1)){
+            /* timer_loop() grows the table in advance, this is only for a sudden flood of new clients */
+            msgid = nameregistry_add(&namedb, msgview_name(p));
+        }
+        if( -1 == msgid){
+            pthread_mutex_unlock(&global_addremove_lock);
+            logprintf(2 /*stderr*/, "Warning: received packed from hostname=%.*s text=%.*s is dropped because the client table is full (clientlimit=%d).\n",
+                FSLATENCY_HOSTNAME_LEN, msgview_hostname(p), FSLATENCY_TEXT_LEN, msgview_text(p), opt.clientlimit);
+            return;
+        }
+        pthread_mutex_lock(&(statusdb[msgid].mutex));
+        pthread_mutex_unlock(&global_addremove_lock);
+        ratelimit_fill(&clientlimit, clientbuckets + msgid, rectick);
+        ratelimit_take(&clientlimit, clientbuckets + msgid, rectick);
+        hotdb.lastarrival[msgid] = rectick;
+        timer_arm(msgid, TIMER_UDPTIMEOUT, rectick, opt.udptimeout);
+        timer_arm(msgid, TIMER_TIMETOFORGET, rectick, opt.timetoforget);
+        alarm_clear(msgid); /* new client: no alarm */
+        sched_note(msgid, p);
+        seq_start(msgid, p);
+        hotdb.srcaddr[msgid] = srcaddr;
+        group_join(msgid, p);
+        history_writer_init(&(statusdb[msgid].history), history_key(msgview_name(p)));
+        statusdb[msgid].rule = rules_match(&rulesdb, msgview_hostname(p), msgview_text(p)); /* before the window */
+        for( i = FSLATENCY_DATABLOCKARRAY_LEN-1; i>=0 ; i--){
+            if( 0 != msgview_count(p, i)){
+                /* it won't add empty datablocks */
+                window_add(msgid, p, i);
+            }
+        }
+        pthread_mutex_unlock(&(statusdb[msgid].mutex));
+        inet_ntop(AF_INET, &srcaddr, addrbuff, sizeof(addrbuff));
+        logprintf(2 /*stderr*/, "Info: client added. msgid=%d hostname=%.*s text=%.*s sched=%s:%u from=%s profile=%u\n",
+            msgid, FSLATENCY_HOSTNAME_LEN, msgview_hostname(p), FSLATENCY_TEXT_LEN, msgview_text(p),
+            rtsched_policyname(msgview_schedpolicy(p)), msgview_schedprio(p), addrbuff, statusdb[msgid].rule);
+    } else { /* end if new entry added. else: kown entry will be updated, its lock is held */
+        if( opt.debug >1){
+            logprintf(2, "DEBUG known client msgid=%d\n", msgid);
+        }
+
+        /* note received packet */
+        seq_note(msgid, p, rectick);
+        timer_arm_ticks(msgid, TIMER_UDPTIMEOUT, rectick, iat_note(statusdb + msgid, hotdb.lastarrival[msgid], rectick));
+        hotdb.lastarrival[msgid] = rectick;
+        hotdb.srcaddr[msgid] = srcaddr;
+        sched_note(msgid, p);
+        timer_arm(msgid, TIMER_TIMETOFORGET, rectick, opt.timetoforget);
+        if( 0 == statusdb[msgid].len){ /* there was no datablock in th ring, but it is a known client.  */
+            /* unmature but known client */
+            logprintf(2 /*stderr*/, "Warning: Why is the buffer for the known client empty? msgid=%d\n", msgid);
+            if( 0 != msgview_count(p, 0)){
+                /* it won't add empty datablocks */
+                window_add(msgid, p, 0);
             }
-            pthread_mutex_lock(&(statusdb[msgid].mutex));
-            clock_gettime(CLOCK_REALTIME, &deadline);
-            deadline.tv_sec -= opt.alarmtimeout;
-            if( timespec_gt(&(statusdb[msgid].lastalarmtime), &deadline)){
-                pthread_mutex_unlock(&(statusdb[msgid].mutex));
-                some_alarm = 1;
-                continue;
+        } else {
+            /*mature and kown client */
+            for( i = FSLATENCY_DATABLOCKARRAY_LEN-1; i>=0 ; i--){
+                /* autmatically discard out-of-order packets. And automatically replace the data of dropped packages.
+                   That's why we have repeated datablocks in each UDP packet. */
+                msgview_start(p, i, &starttime);
+                if( timespec_gt(&starttime, &(statusdb[msgid].laststart))){
+                     window_add(msgid, p, i);
+                }
             }
-            if(opt.debug >1){
-                dprintf(2, "DEBUG alarm status cleared for msgid=%d\n", msgid);
+            /* the "empty datablock alarm" is set only for mature and known client */
+            if( msgview_min(p, 0) == FSLATENCY_EXTREMEBIGINTERVAL){
+                alarm_set(msgid, ALARM_STATISTICALALARM_EMPTYDATABLOCK, NAN, NAN);
+            } else {
+                alarm_unset(msgid, ALARM_STATISTICALALARM_EMPTYDATABLOCK, NAN, NAN);
             }
-            alarm_clear(msgid);
-            pthread_mutex_unlock(&(statusdb[msgid].mutex));
-        } /* end for msgid */
-        /* if there no more alarm, but global_alarmstatus is set, clear it.*/
-        pthread_mutex_lock(&global_alarmstatus_lock);
-        if( !some_alarm && global_alarmstatus){
-            dprintf(2, "Info: global status set to normal.\n");
-            global_alarmstatus = 0;
-            pthread_cond_signal(&global_normalstatus_cond);
+            drift_check(msgid, p);
         }
-        pthread_mutex_unlock(&global_alarmstatus_lock);
-        sleep(1);
+        if( opt.debug > 1){
+            logprintf(2, "DEBUG receiver: this msgid=%d 's ringbufer size: %u of %d\n",
+                    msgid, statusdb[msgid].len, rulesdb.profile[statusdb[msgid].rule].rollingwindow);
+        }
+        pthread_mutex_unlock(&(statusdb[msgid].mutex));
     }
-    return NULL;
 }
 
 
-
 /*
-** periodic reporting loops: normalstatus_loop, alarmstatus_loop
-**
+** receiver_loop (not a child threaded one)
+**  receives up to RECEIVE_BATCH packets with one recvmmsg() call, and processes them
+**  in place in the receive buffers. See receive_batch(), receive_packet()
+**  does not return
 **
 */
 
-void * normalstatus_loop(void *arg)
-{
-    time_t tmp;
-    char timebuff[TIMEFORMAT_LEN]; /* "2025-01-31T14:45:20+01:00" */
+#define RECEIVE_BATCH 32
 
-    while(1){
-        sleep(opt.statusperiod);
-        pthread_mutex_lock(&global_alarmstatus_lock);
-        if( global_alarmstatus){
-            pthread_cond_wait(&global_normalstatus_cond, &global_alarmstatus_lock);
-        }
-        tmp = time(NULL);
-        strftime(timebuff, sizeof(timebuff), TIMEFORMAT, localtime(&tmp));
-        pthread_mutex_lock(&global_stat_lock);
-        dprintf(1, "%s Status: normal. Clients: %lu ln_ltncy:(N:%lu min:%f max:%f avg:%f std:%f)\n",
-            timebuff, namedb.used,
-            global_stat.sumN,global_stat.minx, global_stat.maxx, global_stat.mean, global_stat.std);
-        pthread_mutex_unlock(&global_stat_lock);
-        pthread_mutex_unlock(&global_alarmstatus_lock);
+/* +1 byte: a longer packet is not truncated to the right size */
+static unsigned char receivebuffers[RECEIVE_BATCH][sizeof(struct messageblock) + FSLATENCY_MAC_LEN + 1];
+static struct mmsghdr receivemsgs[RECEIVE_BATCH];
+static struct iovec receiveiovecs[RECEIVE_BATCH];
+static struct sockaddr_in receiveaddrs[RECEIVE_BATCH];
 
+
+static void receiver_init(void)
+{
+    int i;
+
+    memset(receivemsgs, 0, sizeof(receivemsgs));
+    for( i=0; i < RECEIVE_BATCH; i++){
+        receiveiovecs[i].iov_base = receivebuffers[i];
+        receiveiovecs[i].iov_len = sizeof(receivebuffers[i]);
+        receivemsgs[i].msg_hdr.msg_iov = receiveiovecs + i;
+        receivemsgs[i].msg_hdr.msg_iovlen = 1;
+        receivemsgs[i].msg_hdr.msg_name = receiveaddrs + i;
+        receivemsgs[i].msg_hdr.msg_namelen = sizeof(receiveaddrs[i]);
     }
 }
 
 
-void * alarmstatus_loop(void *arg)
+/* receives and processes one batch. Returns the number of packets (-1 or 0 if none) */
+static int receive_batch(int sfd, int flags)
 {
-    time_t tmp;
-    char timebuff[TIMEFORMAT_LEN]; /* "2025-01-31T14:45:20+01:00" */
-    unsigned int cnt_statlow, cnt_stathigh, cnt_empty, cnt_udptmo, cnt_alarm;
-    int msgid;
+    uint64_t rectick;
+    int n;
+    int i;
 
-    while(1){
-        sleep(opt.alarmstatusperiod);
-        pthread_mutex_lock(&global_alarmstatus_lock);
-        if( !global_alarmstatus){
-            pthread_cond_wait(&global_alarmstatus_cond, &global_alarmstatus_lock);
-        }
-        cnt_alarm = cnt_statlow = cnt_stathigh = cnt_empty = cnt_udptmo = 0;
-        for(msgid = 0; msgid < opt.maxclient; msgid++){
-            if( statusdb[msgid].alarm){
-                cnt_alarm++;
-            }
-            if( statusdb[msgid].alarm & ALARM_STATISTICALALARM_LOW){
-                cnt_statlow++;
-            }
-            if( statusdb[msgid].alarm & ALARM_STATISTICALALARM_HIGH){
-                cnt_stathigh ++;
-            }
-            if( statusdb[msgid].alarm & ALARM_STATISTICALALARM_EMPTYDATABLOCK){
-                cnt_empty++;
-            }
-            if( statusdb[msgid].alarm & ALARM_UDPTIMEOUT){
-                cnt_udptmo++;
-            }
-        }
-        tmp = time(NULL);
-        strftime(timebuff, sizeof(timebuff), TIMEFORMAT, localtime(&tmp));
-        pthread_mutex_lock(&global_stat_lock);
-        dprintf(1, "%s ALARM Clients: %lu w/alarms: %d (ltncy lo:%d ltncy hi:%d stuck:%d lost:%d) ln_ltncy:(N:%lu min:%f max:%f avg:%f std:%f)\n",
-            timebuff, namedb.used,
-            cnt_alarm, cnt_statlow, cnt_stathigh, cnt_empty, cnt_udptmo,
-            global_stat.sumN, global_stat.minx, global_stat.maxx, global_stat.mean, global_stat.std);
-        pthread_mutex_unlock(&global_stat_lock);
-        pthread_mutex_unlock(&global_alarmstatus_lock);
+    n = recvmmsg(sfd, receivemsgs, RECEIVE_BATCH, flags, NULL);
+    if( n <= 0){
+        return n;
+    }
+    rectick = timer_now();
+    for( i=0; i < n; i++){
+        receive_packet(receivebuffers[i], receivemsgs[i].msg_len, receiveaddrs[i].sin_addr.s_addr, rectick);
     }
+    return n;
 }
 
 
-void * graphite_loop(void *arg)
-/* send status and data to graphite server in graphithe plaintext input format*/
+void receiver_loop(int sfd)
 {
-    time_t curtime;
-    unsigned int cnt_statlow, cnt_stathigh, cnt_empty, cnt_udptmo, cnt_alarm;
-    double minx, maxx, mean, std;
-    uint64_t sumN;
-    int msgid;
-    int retval;
-    int gfd;
-
+    receiver_init();
     while(1){
-        sleep(60);
-        curtime = time(NULL);
-        cnt_alarm = cnt_statlow = cnt_stathigh = cnt_empty = cnt_udptmo = 0;
-        for(msgid = 0; msgid < opt.maxclient; msgid++){
-            if( statusdb[msgid].alarm){
-                cnt_alarm++;
-            }
-            if( statusdb[msgid].alarm & ALARM_STATISTICALALARM_LOW){
-                cnt_statlow++;
-            }
-            if( statusdb[msgid].alarm & ALARM_STATISTICALALARM_HIGH){
-                cnt_stathigh ++;
-            }
-            if( statusdb[msgid].alarm & ALARM_STATISTICALALARM_EMPTYDATABLOCK){
-                cnt_empty++;
-            }
-            if( statusdb[msgid].alarm & ALARM_UDPTIMEOUT){
-                cnt_udptmo++;
-            }
-        }
-        pthread_mutex_lock(&global_stat_lock);
-        minx = global_stat.minx;
-        maxx = global_stat.maxx;
-        mean = global_stat.mean;
-        std = global_stat.std;
-        sumN = global_stat.sumN;
-        pthread_mutex_unlock(&global_stat_lock);
+        /* blocks for the first packet only, then takes what is already queued */
+        receive_batch(sfd, MSG_WAITFORONE);
+    } /* end while1 */
+}
 
 
-        if( NULL != opt.graphiteip){
-            gfd = socket(AF_INET, SOCK_STREAM, 0);
-            if( -1 == gfd){
-                perror("Error: cannot allocate socket to graphite");
-                continue;
-            }
+/*
+** eventloop (--eventloop, not a child threaded one)
+**  the receiver, the timer, the statistical alarmer, the status lines, graphite and the log writer
+**  in one thread, instead of the threads above. Every periodic task has a timerfd, they and the
+**  UDP socket (and the graphite socket while sending) are waited for with one epoll_wait().
+**  The locks are still taken, but nobody else does: they are never contended.
+**  The lines of the log ring are written out after every wakeup (the timer ticks in every 100 msec).
+**  does not return
+**
+*/
 
-            retval = connect(gfd, (struct sockaddr *) &(opt.graphiteaddr), sizeof(opt.graphiteaddr));
-            if( -1 == retval){
-                perror("Error: cannot connect to graphite");
-                close(gfd);
-                continue;
-            }
-            if( opt.debug >1){
-                dprintf(2, "DEBUG graphite connection established to %s:%u via fd=%d\n",
-                    inet_ntoa(opt.graphiteaddr.sin_addr), ntohs(opt.graphiteaddr.sin_port), gfd);
+#define EVENTLOOP_MAXEVENTS 8
+#define EVENTLOOP_RECEIVE_ROUNDS 8 /* max batches per wakeup, so the timers are not starved by a flood */
+
+enum eventloop_source { EV_RECEIVER, EV_TIMER, EV_STATISTICAL, EV_NORMALSTATUS, EV_ALARMSTATUS, EV_GRAPHITETIMER, EV_GRAPHITESOCKET };
+
+static int eventloop_fd = -1;
+
+
+/* a periodic timerfd in the epoll set. Returns the fd or -1 */
+static int eventloop_timer(enum eventloop_source source, time_t sec, long nsec)
+{
+    struct itimerspec its = {{sec, nsec}, {sec, nsec}};
+    struct epoll_event ev;
+    int tfd;
+
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if( -1 == tfd){
+        return -1;
+    }
+    ev.events = EPOLLIN;
+    ev.data.u64 = ((uint64_t) source << 32) | (uint32_t) tfd;
+    if( 0 != timerfd_settime(tfd, 0, &its, NULL) || 0 != epoll_ctl(eventloop_fd, EPOLL_CTL_ADD, tfd, &ev)){
+        close(tfd);
+        return -1;
+    }
+    return tfd;
+}
+
+
+/* the graphite lines: a non-blocking connect, they are written when the socket gets writable */
+static char graphite_buff[GRAPHITE_BUFF_LEN];
+static int graphite_len;
+static int graphite_fd = -1;
+static int graphite_sent = -1;  /* of graphite_buff, -1: still connecting */
+static int heatmap_len;         /* the heatmap lines in heatmap_buff */
+static int heatmap_sent;
+
+
+/* stdout: the heatmap lines through the log ring too, packed into full records, written out in between */
+static void heatmap_print(void)
+{
+    char * line;
+    char * end;
+    char * last;
+    int len;
+
+    while( 0 < (len = heatmap_format(heatmap_buff, sizeof(heatmap_buff)))){
+        for( line = heatmap_buff; line < heatmap_buff + len; line = last + 1){
+            last = memchr(line, '\n', heatmap_buff + len - line);
+            for( end = last; NULL != end && end - line < LOGRING_TEXTLEN - 1; end = memchr(end + 1, '\n', heatmap_buff + len - end - 1)){
+                last = end;
             }
-        }else{
-            gfd = 1;
+            logprintf(1, "%.*s", (int)(last + 1 - line), line);
         }
+        while( logring_consume(&logdb)){
+            ;
+        }
+    }
+}
 
-        dprintf(gfd, "%s.totalclients %lu %ld\n", opt.graphitebase, namedb.used, curtime);
-        dprintf(gfd, "%s.alarmedclients %u %ld\n", opt.graphitebase, cnt_alarm, curtime);
-        dprintf(gfd, "%s.latencylow %u %ld\n", opt.graphitebase, cnt_statlow, curtime);
-        dprintf(gfd, "%s.latencyhigh %u %ld\n", opt.graphitebase, cnt_stathigh, curtime);
-        dprintf(gfd, "%s.stuckedclients %u %ld\n", opt.graphitebase, cnt_empty, curtime);
-        dprintf(gfd, "%s.lostclients %u %ld\n", opt.graphitebase, cnt_udptmo, curtime);
-        dprintf(gfd, "%s.ln_latency.datapoints %lu %ld\n", opt.graphitebase, sumN, curtime);
-        dprintf(gfd, "%s.ln_latency.min %f %ld\n", opt.graphitebase, minx, curtime);
-        dprintf(gfd, "%s.ln_latency.max %f %ld\n", opt.graphitebase, maxx, curtime);
-        dprintf(gfd, "%s.ln_latency.mean %f %ld\n", opt.graphitebase, mean, curtime);
-        dprintf(gfd, "%s.ln_latency.std %f %ld\n", opt.graphitebase, std, curtime);
-        if(  NULL != opt.graphiteip){
-            shutdown(gfd, SHUT_RDWR);
-            close(gfd);
+static void graphite_start(void)
+{
+    struct epoll_event ev;
+    char * line;
+    char * end;
+
+    graphite_len = graphite_format(graphite_buff, sizeof(graphite_buff));
+    if( NULL == opt.graphiteip){
+        /* stdout: line by line through the log ring */
+        for( line = graphite_buff; line < graphite_buff + graphite_len; line = end + 1){
+            end = strchr(line, '\n');
+            if( NULL == end){
+                break; /* truncated */
+            }
+            logprintf(1, "%.*s\n", (int)(end - line), line);
         }
+        if( HEATMAP_NONE != opt.heatmap){
+            heatmap_snapshot();
+            heatmap_print();
+        }
+        return;
+    }
+    if( -1 != graphite_fd){
+        logprintf(2 /*stderr*/, "Error: cannot send to graphite: still connecting or sending from the previous period\n");
+        close(graphite_fd);
+    }
+    if( HEATMAP_NONE != opt.heatmap){
+        heatmap_snapshot();
+    }
+    graphite_sent = -1;
+    heatmap_len = heatmap_sent = 0;
+    graphite_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if( -1 == graphite_fd){
+        logprintf(2 /*stderr*/, "Error: cannot allocate socket to graphite: %s\n", strerror(errno));
+        return;
+    }
+    ev.events = EPOLLOUT;
+    ev.data.u64 = ((uint64_t) EV_GRAPHITESOCKET << 32) | (uint32_t) graphite_fd;
+    if( (-1 == connect(graphite_fd, (struct sockaddr *) &(opt.graphiteaddr), sizeof(opt.graphiteaddr)) && EINPROGRESS != errno)
+        || 0 != epoll_ctl(eventloop_fd, EPOLL_CTL_ADD, graphite_fd, &ev)){
+        logprintf(2 /*stderr*/, "Error: cannot connect to graphite: %s\n", strerror(errno));
+        close(graphite_fd);
+        graphite_fd = -1;
     }
-    return NULL;
 }
 
 /*
-** receiver_loop (not a child threaded one)
-**  implements UDP socket receiver handling via select()
-**  based on https://stackoverflow.com/questions/15592089/implementing-udp-sockets-with-select-in-c
-**  does not return
-**
+**  the socket is writable: the status lines, then the heatmap a buffer at a time. What does not fit
+**  into the socket buffer waits for the next writable event, so the event loop never blocks here.
 */
-void receiver_loop(int sfd)
+static void graphite_send(void)
 {
-    struct messageblock mymessageblock;
-    struct datablock lastdatablock;
-    struct timespec rectime;
-    int msgid;
-    size_t retsize;
-    int retval;
-    int i;
-
+    int err = 0;
+    socklen_t errlen = sizeof(err);
+    ssize_t retval;
+
+    if( -1 == graphite_sent){
+        if( 0 != getsockopt(graphite_fd, SOL_SOCKET, SO_ERROR, &err, &errlen) || 0 != err){
+            logprintf(2 /*stderr*/, "Error: cannot connect to graphite: %s\n", strerror(err));
+            close(graphite_fd); /* removes it from the epoll set too */
+            graphite_fd = -1;
+            return;
+        }
+        if( opt.debug >1){
+            logprintf(2, "DEBUG graphite connection established to %s:%u via fd=%d\n",
+                inet_ntoa(opt.graphiteaddr.sin_addr), ntohs(opt.graphiteaddr.sin_port), graphite_fd);
+        }
+        graphite_sent = 0;
+    }
     while(1){
-        retsize = recv(sfd, &mymessageblock, sizeof(mymessageblock), 0);
-        if( retsize != sizeof(mymessageblock)){
-            if(opt.debug){
-                dprintf(2, "DEBUG received packed dropped because of wrong size.\n");
-            }
-            continue; /*silently drop*/
-        }
-        clock_gettime(CLOCK_REALTIME, &rectime);
-        if( opt.debug > 2  ){ /* undocumented --debug=3 */
-            dprintf(2, "Received:\n");
-            dprintf(2, "  magic %s\n", mymessageblock.magic);
-            dprintf(2, "  hostname %.*s\n", FSLATENCY_HOSTNAME_LEN, mymessageblock.hostname);
-            dprintf(2, "  text %.*s\n", FSLATENCY_TEXT_LEN, mymessageblock.text);
-            dprintf(2, "  version: %d.%d\n", mymessageblock.major, mymessageblock.minor);
-            dprintf(2, "  precision: %ld.%09ld sec\n", mymessageblock.precision.tv_sec, mymessageblock.precision.tv_nsec);
-            datablock_print(&mymessageblock.datablockarray[0]);
-            datablock_print(&mymessageblock.datablockarray[1]);
-        }
-        /* magic and version processing */
-        if( (FSLATENCY_VERSION_MAJOR != mymessageblock.major) || (FSLATENCY_VERSION_MINOR != mymessageblock.minor)){
-            if(opt.debug){
-                dprintf(2, "DEBUG received packed dropped because of wrong version. Requires: %d.%d received: %d.%d\n",
-                    FSLATENCY_VERSION_MAJOR,FSLATENCY_VERSION_MINOR, mymessageblock.major, mymessageblock.minor);
-            }
-            continue; /*silently drop*/
+        if( graphite_sent < graphite_len){
+            retval = write(graphite_fd, graphite_buff + graphite_sent, graphite_len - graphite_sent);
+        } else if( heatmap_sent < heatmap_len){
+            retval = write(graphite_fd, heatmap_buff + heatmap_sent, heatmap_len - heatmap_sent);
+        } else if( HEATMAP_NONE != opt.heatmap && 0 < (heatmap_len = heatmap_format(heatmap_buff, sizeof(heatmap_buff)))){
+            heatmap_sent = 0;
+            continue;
+        } else {
+            break; /* all sent */
         }
-        if( 0!= memcmp(mymessageblock.magic, FSLATENCY_MAGIC, FSLATENCY_MAGIC_LEN)){
-            if(opt.debug){
-                dprintf(2, "DEBUG received packed dropped because of wrong magic.\n");
-            }
-            continue; /*silently drop*/
+        if( -1 == retval && (EAGAIN == errno || EWOULDBLOCK == errno)){
+            return; /* the socket buffer is full */
+        }
+        if( retval <= 0){
+            logprintf(2 /*stderr*/, "Error: cannot send to graphite: %s\n", strerror(errno));
+            break;
         }
+        if( graphite_sent < graphite_len){
+            graphite_sent += retval;
+        } else {
+            heatmap_sent += retval;
+        }
+    }
+    shutdown(graphite_fd, SHUT_RDWR);
+    close(graphite_fd); /* removes it from the epoll set too */
+    graphite_fd = -1;
+}
 
-        pthread_mutex_lock(&global_addremove_lock);
-        msgid = nameregistry_find(&namedb, mymessageblock.hostname); /* hostname+text both */
-        if( -1 == msgid){
-            /* new client */
-            msgid = nameregistry_add(&namedb, mymessageblock.hostname); /* hostname+text both */
-            if( -1 == msgid){
-                dprintf(2 /*stderr*/, "Warning: received packed from hostname=%.*s text=%.*s is dropped because nameregistry is full.\n",
-                    FSLATENCY_HOSTNAME_LEN, mymessageblock.hostname, FSLATENCY_TEXT_LEN, mymessageblock.text);
-                pthread_mutex_unlock(&global_addremove_lock);
-                continue;
-            }
-            dprintf(2 /*stderr*/, "Info: client added. msgid=%d hostname=%.*s text=%.*s\n",
-                msgid, FSLATENCY_HOSTNAME_LEN, mymessageblock.hostname, FSLATENCY_TEXT_LEN, mymessageblock.text);
-            pthread_mutex_lock(&(statusdb[msgid].mutex));
-            statusdb[msgid].lastarrival = rectime;
-            alarm_clear(msgid); /* new client: no alarm */
-            for( i = FSLATENCY_DATABLOCKARRAY_LEN-1; i>=0 ; i--){
-                if( 0 != mymessageblock.datablockarray[i].measurementcount){
-                    /* it won't add empty datablocks */
-                    ringbuffer_add(&(statusdb[msgid].datablockbuffer), &(mymessageblock.datablockarray[i]));
-                }
-            }
-            pthread_mutex_unlock(&(statusdb[msgid].mutex));
-        } else { /* end if new entry added. else: kown entry will be updated*/
-            if( opt.debug >1){
-                dprintf(2, "DEBUG known client msgid=%d\n", msgid);
-            }
 
-            /* note received packet */
-            pthread_mutex_lock(&(statusdb[msgid].mutex));
-            statusdb[msgid].lastarrival = rectime;
-            retval = ringbuffer_getlast(&(statusdb[msgid].datablockbuffer), &lastdatablock);
-            if( -1 == retval){ /* there was no datablock in th ringbuffer, but it is a known client.  */
-                /* unmature but known client */
-                dprintf(2 /*stderr*/, "Warning: Why is the buffer for the known client empty? msgid=%d\n", msgid);
-                if( 0 != mymessageblock.datablockarray[i].measurementcount){
-                    /* it won't add empty datablocks */
-                    ringbuffer_add(&(statusdb[msgid].datablockbuffer), &(mymessageblock.datablockarray[i]));
-                }
-            } else {
-                /*mature and kown client */
-                for( i = FSLATENCY_DATABLOCKARRAY_LEN-1; i>=0 ; i--){
-                    /* autmatically discard out-of-order packets. And automatically replace the data of dropped packages.
-                       That's why we have repeated datablocks in each UDP packet. */
-                    if( timespec_gt(&(mymessageblock.datablockarray[i].starttime), &(lastdatablock.starttime))){
-                         ringbuffer_add(&(statusdb[msgid].datablockbuffer), &(mymessageblock.datablockarray[i]));
+/* returns only on error */
+int eventloop(int sfd)
+{
+    struct epoll_event ev;
+    struct epoll_event events[EVENTLOOP_MAXEVENTS];
+    uint64_t expirations;
+    int n, i, rounds;
+
+    receiver_init();
+    eventloop_fd = epoll_create1(EPOLL_CLOEXEC);
+    if( -1 == eventloop_fd){
+        return -1;
+    }
+    ev.events = EPOLLIN;
+    ev.data.u64 = ((uint64_t) EV_RECEIVER << 32) | (uint32_t) sfd;
+    if( 0 != epoll_ctl(eventloop_fd, EPOLL_CTL_ADD, sfd, &ev)
+        || -1 == eventloop_timer(EV_TIMER, 0, TIMER_TICK_MS * 1000000)
+        || -1 == eventloop_timer(EV_STATISTICAL, 1, 0)
+        || -1 == eventloop_timer(EV_NORMALSTATUS, opt.statusperiod, 0)
+        || -1 == eventloop_timer(EV_ALARMSTATUS, opt.alarmstatusperiod, 0)
+        || (NULL != opt.graphitebase && -1 == eventloop_timer(EV_GRAPHITETIMER, 60, 0))){
+        return -1;
+    }
+
+    while(1){
+        n = epoll_wait(eventloop_fd, events, EVENTLOOP_MAXEVENTS, -1);
+        for( i=0; i < n; i++){
+            switch( events[i].data.u64 >> 32){
+                case EV_RECEIVER:
+                    /* level triggered: what is left there wakes up again */
+                    rounds = 0;
+                    while( RECEIVE_BATCH == receive_batch(sfd, MSG_DONTWAIT) && ++rounds < EVENTLOOP_RECEIVE_ROUNDS){
+                        ;
                     }
-                }
-                /* the "empty datablock alarm" is set only for mature and known client */
-                if( mymessageblock.datablockarray[0].min == FSLATENCY_EXTREMEBIGINTERVAL){
-                    alarm_set(msgid, ALARM_STATISTICALALARM_EMPTYDATABLOCK);
-                } else {
-                    alarm_unset(msgid, ALARM_STATISTICALALARM_EMPTYDATABLOCK);
-                }
+                    continue;
+                case EV_GRAPHITESOCKET:
+                    graphite_send();
+                    continue;
             }
-            if( opt.debug > 1){
-                dprintf(2, "DEBUG receiver: this msgid=%d 's ringbufer size: %lu of %lu\n",
-                        msgid, statusdb[msgid].datablockbuffer.len, statusdb[msgid].datablockbuffer.bufferlen);
+            /* a timerfd: read it, or it stays readable */
+            if( sizeof(expirations) != read((int)(uint32_t) events[i].data.u64, &expirations, sizeof(expirations))){
+                continue;
+            }
+            switch( events[i].data.u64 >> 32){
+                case EV_TIMER:
+                    timer_pass();
+                    break;
+                case EV_STATISTICAL:
+                    statistical_alarmer_pass();
+                    break;
+                case EV_NORMALSTATUS:
+                    pthread_mutex_lock(&global_alarmstatus_lock);
+                    if( !global_alarmstatus){
+                        normalstatus_print();
+                    }
+                    pthread_mutex_unlock(&global_alarmstatus_lock);
+                    break;
+                case EV_ALARMSTATUS:
+                    pthread_mutex_lock(&global_alarmstatus_lock);
+                    if( global_alarmstatus){
+                        alarmstatus_print();
+                    }
+                    pthread_mutex_unlock(&global_alarmstatus_lock);
+                    break;
+                case EV_GRAPHITETIMER:
+                    graphite_start();
+                    break;
             }
-            pthread_mutex_unlock(&(statusdb[msgid].mutex));
         }
-        pthread_mutex_unlock(&global_addremove_lock);
-        /* ... */
-
-    } /* end while1 */
+        while( logring_consume(&logdb)){
+            ;
+        }
+    }
+    return -1;
 }
 
 
@@ -1073,12 +3721,12 @@ int main(int argc, char * argv[])
     int retval;
     struct sockaddr_in serversockstruct;
     pthread_t statistical_alarmer_thread;
-    pthread_t timetoforget_thread;
-    pthread_t alarmsilencer_thread;
-    pthread_t udptimeout_thread;
+    pthread_t timer_thread;
     pthread_t alarmstatus_thread;
     pthread_t normalstatus_thread;
     pthread_t graphite_thread;
+    pthread_t logwriter_thread;
+    pthread_t history_thread;
 
     /* parameter processing */
     init_opt();
@@ -1118,99 +3766,143 @@ int main(int argc, char * argv[])
         perror("Error: cannot bind");
         return 1;
     }
+    receiver_socket = sfd;
+    if( !opt.nofilter){
+        retval = attach_filter(sfd);
+        if( -1 == retval){
+            perror("Warning: cannot attach socket filter, filtering in userspace only");
+        } else if( opt.debug){
+            dprintf(2, "DEBUG socket filter attached\n");
+        }
+    }
 
     /* initializations */
 
-    retval = init_databases(opt.maxclient);
+    retval = logring_init(&logdb, LOGRING_CAPACITY);
     if( -1 == retval){
-        dprintf(2 /*stderr*/, "Error: cannot initialize databases\n");
+        dprintf(2 /*stderr*/, "Error: cannot allocate memory for the log ring\n");
         return 1;
     }
-    if( opt.debug > 2){
-        dprintf(2, "DEBUG initialization done for %d clients\n", opt.maxclient);
-    }
-
-    /* various threads */
-
-    retval = pthread_create(&statistical_alarmer_thread, NULL, &statistical_alarmer_loop, NULL);
+    if( !opt.eventloop){
+        retval = rtsched_create(&opt.threadsched, "logwriter", &logwriter_thread, &logring_writer_loop, &logdb);
         if( 0 != retval){
-        dprintf(2 /*stderr*/, "Error: cannot create statistical_alarmer thread. Errno:%d\n", retval);
-        return 2;
-    }
-    if( opt.debug > 2){
-        dprintf(2, "DEBUG thread start: statistical_alarmer\n");
+            dprintf(2 /*stderr*/, "Error: cannot create logwriter thread. Errno:%d\n", retval);
+            return 2;
+        }
     }
 
-    retval = pthread_create(&timetoforget_thread, NULL, &timetoforget_loop, NULL);
-        if( 0 != retval){
-        dprintf(2 /*stderr*/, "Error: cannot create timetoforget (client auto remove) thread. Errno:%d\n", retval);
-        return 2;
+    retval = init_databases(opt.maxclient);
+    if( -1 == retval){
+        dprintf(2 /*stderr*/, "Error: cannot initialize databases\n");
+        return 1;
     }
-    if( opt.debug > 2){
-        dprintf(2, "DEBUG thread start: timetoforget\n");
+    if( HEATMAP_NONE != opt.heatmap && 0 != init_heatmap()){
+        dprintf(2 /*stderr*/, "Error: cannot allocate memory for the heatmap\n");
+        return 1;
     }
-
-    retval = pthread_create(&alarmsilencer_thread, NULL, &alarmsilencer_loop, NULL);
-        if( 0 != retval){
-        dprintf(2 /*stderr*/, "Error: cannot create alarmsilencer (obsoleted alarm purger) thread. Errno:%d\n", retval);
-        return 2;
+    retval = init_ratelimits();
+    if( -1 == retval){
+        dprintf(2 /*stderr*/, "Error: cannot allocate memory for the rate limits\n");
+        return 1;
     }
     if( opt.debug > 2){
-        dprintf(2, "DEBUG thread start: alarmsilencer\n");
+        dprintf(2, "DEBUG initialization done for %lu clients\n", clienttable_getsize());
     }
 
-    retval = pthread_create(&udptimeout_thread, NULL, &udptimeout_loop, NULL);
+    /* the history queries have their own thread in the event loop too: an answer can take long */
+    if( 0 != opt.historymb){
+        if( -1 == history_listen()){
+            return 1;
+        }
+        retval = rtsched_create(&opt.threadsched, "history", &history_thread, &history_loop, NULL);
         if( 0 != retval){
-        dprintf(2 /*stderr*/, "Error: cannot create udptimeout detection thread. Errno:%d\n", retval);
-        return 2;
-    }
-    if( opt.debug > 2){
-        dprintf(2, "DEBUG thread start: udptimeout\n");
+            dprintf(2 /*stderr*/, "Error: cannot create thread for the history queries. Errno:%d\n", retval);
+            return 2;
+        }
+        if( opt.debug > 2){
+            dprintf(2, "DEBUG thread start: history\n");
+        }
     }
 
-    retval = pthread_create(&alarmstatus_thread, NULL, &alarmstatus_loop, NULL);
-        if( 0 != retval){
-        dprintf(2 /*stderr*/, "Error: cannot create thread to report alarm periodically. Errno:%d\n", retval);
-        return 2;
-    }
-    if( opt.debug > 2){
-        dprintf(2, "DEBUG thread start: alarmstatus\n");
-    }
+    /* various threads: the event loop does it all in this one */
 
-    retval = pthread_create(&normalstatus_thread, NULL, &normalstatus_loop, NULL);
-        if( 0 != retval){
-        dprintf(2 /*stderr*/, "Error: cannot create thread to report normal status periodically. Errno:%d\n", retval);
-        return 2;
-    }
-    if( opt.debug > 2){
-        dprintf(2, "DEBUG thread start: normalstatus\n");
-    }
+    if( !opt.eventloop){
+        retval = rtsched_create(&opt.threadsched, "statistical", &statistical_alarmer_thread, &statistical_alarmer_loop, NULL);
+            if( 0 != retval){
+            dprintf(2 /*stderr*/, "Error: cannot create statistical_alarmer thread. Errno:%d\n", retval);
+            return 2;
+        }
+        if( opt.debug > 2){
+            dprintf(2, "DEBUG thread start: statistical_alarmer\n");
+        }
+
+        retval = rtsched_create(&opt.threadsched, "timer", &timer_thread, &timer_loop, NULL);
+            if( 0 != retval){
+            dprintf(2 /*stderr*/, "Error: cannot create timer (udptimeout, timetoforget, alarmsilencer) thread. Errno:%d\n", retval);
+            return 2;
+        }
+        if( opt.debug > 2){
+            dprintf(2, "DEBUG thread start: timer\n");
+        }
+
+        retval = rtsched_create(&opt.threadsched, "alarmstatus", &alarmstatus_thread, &alarmstatus_loop, NULL);
+            if( 0 != retval){
+            dprintf(2 /*stderr*/, "Error: cannot create thread to report alarm periodically. Errno:%d\n", retval);
+            return 2;
+        }
+        if( opt.debug > 2){
+            dprintf(2, "DEBUG thread start: alarmstatus\n");
+        }
 
-    if( NULL != opt.graphitebase){
-        retval = pthread_create(&graphite_thread, NULL, &graphite_loop, NULL);
+        retval = rtsched_create(&opt.threadsched, "normalstatus", &normalstatus_thread, &normalstatus_loop, NULL);
             if( 0 != retval){
-            dprintf(2 /*stderr*/, "Error: cannot create thread to report status to graphite. Errno:%d\n", retval);
+            dprintf(2 /*stderr*/, "Error: cannot create thread to report normal status periodically. Errno:%d\n", retval);
             return 2;
         }
         if( opt.debug > 2){
-            dprintf(2, "DEBUG thread start: graphite\n");
+            dprintf(2, "DEBUG thread start: normalstatus\n");
         }
 
+        if( NULL != opt.graphitebase){
+            retval = rtsched_create(&opt.threadsched, "graphite", &graphite_thread, &graphite_loop, NULL);
+                if( 0 != retval){
+                dprintf(2 /*stderr*/, "Error: cannot create thread to report status to graphite. Errno:%d\n", retval);
+                return 2;
+            }
+            if( opt.debug > 2){
+                dprintf(2, "DEBUG thread start: graphite\n");
+            }
+
 
+        }
     }
 
 
+    /* the receiver is this thread */
+    retval = rtsched_self(&opt.threadsched, "receiver");
+    if( 0 != retval){
+        dprintf(2 /*stderr*/, "Error: cannot set the scheduling of the receiver. Errno:%d\n", retval);
+        return 2;
+    }
+
     /* Locking all memory for emergency running. This program should run even if the system disk fails. */
     if( !opt.nomemlock ){
         sleep(1);
+        rtsched_prefault_stack(RTSCHED_STACK_SIZE); /* the stack of the receiver */
         retval = mlockall(MCL_CURRENT);
         if( retval < 0){
             perror("Error: cannot memlockall");
             return 2;
         }
+        arena_setmemlock(1); /* the client table grows later: lock its new pages too */
     }
 
     /* starting receiver */
+    if( opt.eventloop){
+        eventloop(sfd);
+        perror("Error: event loop setup failed");
+        return 1;
+    }
     receiver_loop(sfd);
 
     close(sfd);
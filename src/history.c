@@ -0,0 +1,345 @@
+/*
+** history.c
+**
+** compressed in-memory latency history implementations. See history.h
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <math.h>
+#include "history.h"
+
+#define HISTORY_NAN 0x7fc00000u
+#define HISTORY_CAPACITY (HISTORY_CHUNK_DATA * 8)
+
+
+int history_init(struct history * hp, size_t bytes)
+{
+    size_t nheads = 2;
+
+    while( nheads < 2 * (bytes / sizeof(struct history_chunk))){
+        nheads <<= 1;
+    }
+    if( bytes <= nheads * sizeof(struct history_head)){
+        return -1;
+    }
+    hp->n = (bytes - nheads * sizeof(struct history_head)) / sizeof(struct history_chunk);
+    if( 0 == hp->n){
+        return -1;
+    }
+    hp->chunks = (struct history_chunk *) calloc(hp->n, sizeof(struct history_chunk));
+    hp->heads = (struct history_head *) calloc(nheads, sizeof(struct history_head));
+    if( NULL == hp->chunks || NULL == hp->heads){
+        free(hp->chunks);
+        free(hp->heads);
+        return -1;
+    }
+    hp->mask = nheads - 1;
+    hp->epoch = 0;
+    return 0;
+}
+
+
+/* the head of key, or the empty slot for it */
+static struct history_head * head_find(const struct history * hp, uint64_t key)
+{
+    size_t i;
+
+    for( i=key & hp->mask; 0 != hp->heads[i].key && key != hp->heads[i].key; i = (i + 1) & hp->mask){
+        ;
+    }
+    return hp->heads + i;
+}
+
+
+/* the followers of the probe sequence are shifted back, so no search stops at the hole */
+static void head_remove(struct history * hp, struct history_head * hd)
+{
+    size_t i = hd - hp->heads;
+    size_t j = i;
+    size_t home;
+
+    while( 0 != hp->heads[j = (j + 1) & hp->mask].key){
+        home = hp->heads[j].key & hp->mask;
+        if( ((j - home) & hp->mask) >= ((j - i) & hp->mask)){ /* its home is not between the hole and it */
+            hp->heads[i] = hp->heads[j];
+            i = j;
+        }
+    }
+    hp->heads[i].key = 0;
+}
+
+
+void history_writer_init(struct history_writer * wp, uint64_t key)
+{
+    memset(wp, 0, sizeof(struct history_writer));
+    wp->key = 0 == key ? 1 : key; /* 0 marks the unused chunks */
+}
+
+
+/* the float bits rounded to HISTORY_MANTISSA_BITS of mantissa, one NaN for all */
+static uint32_t quantize(float f)
+{
+    const int drop = 23 - HISTORY_MANTISSA_BITS;
+    uint32_t bits;
+
+    if( isnan(f)){
+        return HISTORY_NAN;
+    }
+    memcpy(&bits, &f, sizeof(bits));
+    if( isinf(f)){
+        return bits;
+    }
+    return (bits + (1u << (drop - 1))) & ~((1u << drop) - 1);
+}
+
+
+/* the lowest n bits of value, the highest first. Returns -1 if the chunk is full */
+static int put(uint8_t * data, unsigned int * pos, uint64_t value, int n)
+{
+    int i;
+
+    if( *pos + n > HISTORY_CAPACITY){
+        return -1;
+    }
+    for( i=n - 1; i >= 0; i--){
+        if( (value >> i) & 1){
+            data[*pos >> 3] |= (uint8_t) (0x80 >> (*pos & 7));
+        } else {
+            data[*pos >> 3] &= (uint8_t) ~(0x80 >> (*pos & 7));
+        }
+        (*pos) ++;
+    }
+    return 0;
+}
+
+
+static uint64_t get(const uint8_t * data, unsigned int * pos, int n)
+{
+    uint64_t value = 0;
+    int i;
+
+    for( i=0; i < n; i++){
+        value = (value << 1) | ((data[*pos >> 3] >> (7 - (*pos & 7))) & 1);
+        (*pos) ++;
+    }
+    return value;
+}
+
+
+/* delta of delta: 0, 10+7, 110+9, 1110+12 or 1111+32 bits */
+static int put_time(uint8_t * data, unsigned int * pos, int64_t dod)
+{
+    if( 0 == dod){
+        return put(data, pos, 0, 1);
+    } else if( -63 <= dod && dod <= 64){
+        return put(data, pos, 2, 2) | put(data, pos, dod + 63, 7);
+    } else if( -255 <= dod && dod <= 256){
+        return put(data, pos, 6, 3) | put(data, pos, dod + 255, 9);
+    } else if( -2047 <= dod && dod <= 2048){
+        return put(data, pos, 14, 4) | put(data, pos, dod + 2047, 12);
+    }
+    return put(data, pos, 15, 4) | put(data, pos, (uint32_t) dod, 32);
+}
+
+
+static int64_t get_time(const uint8_t * data, unsigned int * pos)
+{
+    if( 0 == get(data, pos, 1)){
+        return 0;
+    } else if( 0 == get(data, pos, 1)){
+        return (int64_t) get(data, pos, 7) - 63;
+    } else if( 0 == get(data, pos, 1)){
+        return (int64_t) get(data, pos, 9) - 255;
+    } else if( 0 == get(data, pos, 1)){
+        return (int64_t) get(data, pos, 12) - 2047;
+    }
+    return (int32_t) get(data, pos, 32);
+}
+
+
+/* the XOR with the previous value: 0, 10+meaningful bits in the previous window, or 11+5+5+meaningful bits */
+static int put_value(uint8_t * data, unsigned int * pos, struct history_writer * wp, int i, uint32_t v)
+{
+    uint32_t x = v ^ wp->prev[i];
+    int lead, trail;
+
+    wp->prev[i] = v;
+    if( 0 == x){
+        return put(data, pos, 0, 1);
+    }
+    lead = __builtin_clz(x);
+    trail = __builtin_ctz(x);
+    if( 0 != wp->length[i] && lead >= wp->leading[i] && trail >= 32 - wp->leading[i] - wp->length[i]){
+        return put(data, pos, 2, 2) | put(data, pos, x >> (32 - wp->leading[i] - wp->length[i]), wp->length[i]);
+    }
+    wp->leading[i] = (uint8_t) lead;
+    wp->length[i] = (uint8_t) (32 - lead - trail);
+    return put(data, pos, 3, 2) | put(data, pos, lead, 5) | put(data, pos, wp->length[i] - 1, 5)
+        | put(data, pos, x >> trail, wp->length[i]);
+}
+
+
+static uint32_t get_value(const uint8_t * data, unsigned int * pos, struct history_writer * wp, int i)
+{
+    if( 0 == get(data, pos, 1)){
+        return wp->prev[i];
+    }
+    if( 1 == get(data, pos, 1)){
+        wp->leading[i] = (uint8_t) get(data, pos, 5);
+        wp->length[i] = (uint8_t) get(data, pos, 5) + 1;
+    }
+    wp->prev[i] ^= (uint32_t) get(data, pos, wp->length[i]) << (32 - wp->leading[i] - wp->length[i]);
+    return wp->prev[i];
+}
+
+
+/*
+**  the sample is encoded with a copy of the writer state, that is kept only if the sample fits in the chunk.
+**  A new chunk starts with the raw values. It is started also if the time is not after the last one
+**  (an agent clock step) or jumps decades, so the samples of a chunk are always in time order.
+*/
+void history_add(struct history * hp, struct history_writer * wp, uint32_t time, const float * value)
+{
+    struct history_chunk * cp;
+    struct history_head * hd;
+    struct history_writer w;
+    uint32_t v[HISTORY_VALUES];
+    unsigned int pos;
+    int64_t delta;
+    int retval;
+    int i;
+
+    for( i=0; i < HISTORY_VALUES; i++){
+        v[i] = quantize(value[i]);
+    }
+    cp = hp->chunks + wp->chunk;
+    if( 0 != wp->epoch && cp->epoch == wp->epoch /* not recycled meanwhile */
+        && time > wp->lasttime && time - wp->lasttime < 0x40000000u){
+        w = *wp;
+        pos = cp->nbits;
+        delta = (int64_t) time - w.lasttime;
+        retval = put_time(cp->data, &pos, delta - w.lastdelta);
+        for( i=0; i < HISTORY_VALUES; i++){
+            retval |= put_value(cp->data, &pos, &w, i, v[i]);
+        }
+        if( 0 == retval){
+            w.lasttime = time;
+            w.lastdelta = (int32_t) delta;
+            *wp = w;
+            cp->nbits = (uint16_t) pos;
+            cp->count ++;
+            cp->last = time;
+            return;
+        }
+    }
+    /* a new chunk: the oldest one of the pool */
+    hp->epoch ++;
+    wp->chunk = (uint32_t) HISTORY_INDEX(hp, hp->epoch);
+    wp->epoch = hp->epoch;
+    wp->lasttime = time;
+    wp->lastdelta = 1; /* a regular second costs 1 bit from the second sample on */
+    cp = hp->chunks + wp->chunk;
+    if( 0 != cp->key){
+        hd = head_find(hp, cp->key);
+        if( hd->key == cp->key && hd->epoch == cp->epoch){
+            head_remove(hp, hd); /* it was the last chunk of its key */
+        }
+    }
+    hd = head_find(hp, wp->key);
+    cp->back = wp->key == hd->key ? (uint32_t) (hp->epoch - hd->epoch) : 0; /* a live one is within n */
+    hd->key = wp->key;
+    hd->epoch = hp->epoch;
+    cp->key = wp->key;
+    cp->epoch = hp->epoch;
+    cp->start = cp->last = time;
+    cp->count = 1;
+    pos = 0;
+    for( i=0; i < HISTORY_VALUES; i++){
+        put(cp->data, &pos, v[i], 32);
+        wp->prev[i] = v[i];
+        wp->length[i] = 0;
+    }
+    cp->nbits = (uint16_t) pos;
+}
+
+
+size_t history_find(const struct history * hp, uint64_t key, uint64_t * cursor, uint32_t from, uint32_t to,
+    uint64_t * epochs, size_t max)
+{
+    const struct history_chunk * cp;
+    const struct history_head * hd;
+    uint64_t epoch = *cursor;
+    size_t found = 0;
+    size_t i;
+
+    if( 0 == key){
+        key = 1;
+    }
+    if( 0 == epoch){
+        hd = head_find(hp, key);
+        epoch = key == hd->key ? hd->epoch : 0;
+    }
+    for( i=0; i < max && 0 != epoch && hp->epoch - epoch < hp->n /* not recycled */; i++){
+        cp = hp->chunks + HISTORY_INDEX(hp, epoch);
+        if( epoch != cp->epoch || key != cp->key){
+            epoch = 0; /* can not happen */
+            break;
+        }
+        if( cp->last >= from && cp->start <= to){
+            epochs[found ++] = epoch;
+        }
+        epoch = 0 == cp->back ? 0 : epoch - cp->back;
+    }
+    *cursor = 0 != epoch && hp->epoch - epoch < hp->n ? epoch : 0;
+    return found;
+}
+
+
+int history_decode(const struct history_chunk * cp, struct history_sample * out)
+{
+    struct history_writer w;
+    unsigned int pos = 0;
+    uint32_t time;
+    int32_t delta = 1;
+    int n;
+    int i;
+
+    if( 0 == cp->count){
+        return 0;
+    }
+    memset(&w, 0, sizeof(w));
+    time = cp->start;
+    for( n=0; n < cp->count && n < HISTORY_CHUNK_SAMPLES; n++){
+        if( 0 == n){
+            for( i=0; i < HISTORY_VALUES; i++){
+                w.prev[i] = (uint32_t) get(cp->data, &pos, 32);
+            }
+        } else {
+            delta += (int32_t) get_time(cp->data, &pos);
+            time += delta;
+            for( i=0; i < HISTORY_VALUES; i++){
+                get_value(cp->data, &pos, &w, i);
+            }
+        }
+        out[n].time = time;
+        for( i=0; i < HISTORY_VALUES; i++){
+            memcpy(out[n].value + i, w.prev + i, sizeof(float));
+        }
+    }
+    return n;
+}
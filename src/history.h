@@ -0,0 +1,114 @@
+/*
+** history.h
+**
+** compressed in-memory latency history definitions
+**
+**  The per second min/max/mean of the clients, beyond the rolling window, in a fixed pool of
+**  HISTORY_CHUNK_SIZE byte chunks. Every chunk holds a run of samples of one client, compressed
+**  like the Gorilla time series database (Pelkonen et al., VLDB 2015): the timestamps as delta of
+**  delta (1 bit for a regular second), the values as the XOR with the previous one of the same
+**  series (1 bit for a repeated value, the meaningful bits otherwise). The values are rounded to
+**  HISTORY_MANTISSA_BITS bits of mantissa (about 3 significant digits), so their XORs are short.
+**  The pool is a ring: a new chunk always recycles the oldest one, so the memory is fixed at init
+**  and the history of the busy clients is as long as the pool allows.
+**  The chunks of a client are found by the 64 bit hash of its name (key), so the history of a
+**  forgotten client remains readable until it is recycled. An empty datablock is a NaN sample.
+**  The chunks of a key are chained newest first (back: the distance to the epoch of the previous
+**  one), and the newest chunk of every key is in a hash table (heads, linear probing, at most half
+**  full), so a search follows the chain of the key instead of scanning the pool. A link is valid
+**  while its epoch is not older than the pool, the ring recycles the oldest chunks first.
+**  The heads are in the bytes of the pool too (16 bytes per 2 chunks at least).
+**
+** not multithread safe: the writers and the readers of a pool must be serialized by the caller.
+**
+**  functions:
+**      - init          the constructor of the pool. bytes: its size. Returns -1 if it is too small.
+**      - writer_init   the constructor of the writer of a client (one per client)
+**      - add           append a sample of the client of the writer.
+**      - find          the epochs of the chunks of key that may have samples between from and to,
+**                      newest first, from the chain at *cursor (0: the newest chunk of key). At most
+**                      max chunks are visited, *cursor is set to the next one (0: the end of the chain),
+**                      so the caller may let the pool go between the calls. Returns the number found.
+**      - decode        the samples of a chunk. Returns their number (at most HISTORY_CHUNK_SAMPLES)
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __HISTORY_H
+#define __HISTORY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define HISTORY_CHUNK_SIZE 256
+#define HISTORY_CHUNK_DATA (HISTORY_CHUNK_SIZE - 32)
+#define HISTORY_CHUNK_SAMPLES (HISTORY_CHUNK_DATA * 8 / 4)  /* 1 bit time + 3 * 1 bit value at least */
+#define HISTORY_MANTISSA_BITS 10
+#define HISTORY_VALUES 3   /* min, max, mean */
+
+struct history_chunk {
+    uint64_t key;     /* of the client, 0: never used */
+    uint64_t epoch;   /* allocation number, 1 for the first chunk of the pool */
+    uint32_t start;   /* unix time of the first sample */
+    uint32_t last;    /* the latest time of the samples */
+    uint16_t count;   /* samples */
+    uint16_t nbits;   /* used bits of data */
+    uint32_t back;    /* epoch - the epoch of the previous chunk of the key, 0: none */
+    uint8_t data[HISTORY_CHUNK_DATA];
+};
+
+struct history_writer {
+    uint64_t key;
+    uint64_t epoch;      /* of the current chunk, 0: none */
+    uint32_t chunk;      /* index of the current chunk */
+    uint32_t lasttime;
+    int32_t lastdelta;
+    uint32_t prev[HISTORY_VALUES];    /* float bits */
+    uint8_t leading[HISTORY_VALUES];  /* the meaningful bits of the last XOR */
+    uint8_t length[HISTORY_VALUES];   /* 0: no previous XOR in the chunk */
+};
+
+struct history_head {
+    uint64_t key;     /* 0: empty */
+    uint64_t epoch;   /* of the newest chunk of key */
+};
+
+struct history {
+    struct history_chunk * chunks;
+    size_t n;
+    uint64_t epoch;   /* of the newest chunk */
+    struct history_head * heads;
+    size_t mask;      /* of heads, the size of it - 1 (a power of 2) */
+};
+
+#define HISTORY_INDEX(hp, epoch) ((size_t) (((epoch) - 1) % (hp)->n))  /* of the chunk of epoch */
+
+struct history_sample {
+    uint32_t time;
+    float value[HISTORY_VALUES];   /* min, max, mean. NaN: empty datablock */
+};
+
+
+int history_init(struct history * hp, size_t bytes);
+void history_writer_init(struct history_writer * wp, uint64_t key);
+void history_add(struct history * hp, struct history_writer * wp, uint32_t time, const float * value);
+size_t history_find(const struct history * hp, uint64_t key, uint64_t * cursor, uint32_t from, uint32_t to,
+    uint64_t * epochs, size_t max);
+int history_decode(const struct history_chunk * cp, struct history_sample * out);
+
+#endif /* __HISTORY_H */
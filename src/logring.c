@@ -0,0 +1,139 @@
+/*
+** logring.c
+**
+** lock-free log ring implementations. See logring.h
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include "logring.h"
+
+#define LOGRING_IDLE_NSEC 10000000  /* the writer polls the empty ring every 10 msec */
+
+
+int logring_init(struct logring * lrp, size_t capacity)
+{
+    size_t i;
+
+    if( 0 == capacity || 0 != (capacity & (capacity - 1))){
+        return -1;
+    }
+    lrp->records = (struct logring_record *) aligned_alloc(64, capacity * sizeof(struct logring_record));
+    if( NULL == lrp->records){
+        return -1;
+    }
+    for( i=0; i < capacity; i++){
+        lrp->records[i].sequence = i;
+    }
+    lrp->mask = capacity - 1;
+    lrp->enqueuepos = 0;
+    lrp->dequeuepos = 0;
+    lrp->dropped = 0;
+    lrp->truncated = 0;
+    lrp->written = 0;
+    return 0;
+}
+
+
+/*
+**  record.sequence == pos      : free for the producer of pos
+**  record.sequence == pos + 1  : published, the writer can take it
+**  record.sequence <  pos      : the writer did not write it out yet: the ring is full
+*/
+int logring_printf(struct logring * lrp, int fd, const char * format, ...)
+{
+    struct logring_record * rp;
+    size_t pos;
+    size_t seq;
+    intptr_t diff;
+    va_list ap;
+    int len;
+
+    pos = __atomic_load_n(&(lrp->enqueuepos), __ATOMIC_RELAXED);
+    while(1){
+        rp = lrp->records + (pos & lrp->mask);
+        seq = __atomic_load_n(&(rp->sequence), __ATOMIC_ACQUIRE);
+        diff = (intptr_t) seq - (intptr_t) pos;
+        if( 0 == diff){
+            if( __atomic_compare_exchange_n(&(lrp->enqueuepos), &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                break; /* claimed */
+            }
+        } else if( diff < 0){
+            __atomic_add_fetch(&(lrp->dropped), 1, __ATOMIC_RELAXED);
+            return -1;
+        } else {
+            pos = __atomic_load_n(&(lrp->enqueuepos), __ATOMIC_RELAXED);
+        }
+    }
+    va_start(ap, format);
+    len = vsnprintf(rp->text, LOGRING_TEXTLEN, format, ap);
+    va_end(ap);
+    if( len < 0){
+        len = 0;
+    } else if( len >= LOGRING_TEXTLEN){
+        len = LOGRING_TEXTLEN - 1;
+        rp->text[len - 1] = '\n';
+        __atomic_add_fetch(&(lrp->truncated), 1, __ATOMIC_RELAXED);
+    }
+    rp->fd = (short) fd;
+    rp->len = (short) len;
+    __atomic_store_n(&(rp->sequence), pos + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+
+int logring_consume(struct logring * lrp)
+{
+    struct logring_record * rp = lrp->records + (lrp->dequeuepos & lrp->mask);
+    struct pollfd pfd;
+
+    if( __atomic_load_n(&(rp->sequence), __ATOMIC_ACQUIRE) != lrp->dequeuepos + 1){
+        return 0; /* empty (or the oldest one is not published yet) */
+    }
+    pfd.fd = rp->fd;
+    pfd.events = POLLOUT;
+    /* a stalled output (a full pipe) must not hold up the lines of the other file descriptors */
+    if( 1 != poll(&pfd, 1, 0) || !(pfd.revents & POLLOUT) || rp->len != write(rp->fd, rp->text, rp->len)){
+        __atomic_add_fetch(&(lrp->dropped), 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_add_fetch(&(lrp->written), 1, __ATOMIC_RELAXED);
+    }
+    /* free for the producer of the next round */
+    __atomic_store_n(&(rp->sequence), lrp->dequeuepos + lrp->mask + 1, __ATOMIC_RELEASE);
+    lrp->dequeuepos ++;
+    return 1;
+}
+
+
+void * logring_writer_loop(void * arg)
+{
+    struct logring * lrp = (struct logring *) arg;
+    struct timespec idle = {0, LOGRING_IDLE_NSEC};
+
+    while(1){
+        while( logring_consume(lrp)){
+            ;
+        }
+        nanosleep(&idle, NULL);
+    }
+    return NULL;
+}
@@ -0,0 +1,72 @@
+/*
+** logring.h
+**
+** lock-free log ring definitions
+**
+**  Many threads format their output lines into a bounded ring of fixed size records,
+**  one writer thread writes them to their file descriptors. A producer never blocks and never
+**  takes a lock: if the ring is full (the output is slow or stalled), the line is dropped
+**  and counted. The writer does not wait for a file descriptor that is not writable (a full pipe):
+**  that line is dropped and counted too. Lines longer than LOGRING_TEXTLEN are truncated and counted.
+**  The ring is the bounded queue of D. Vyukov: every record has a sequence number,
+**  the producers claim a record with a compare-and-swap, and publish it with the sequence number.
+**
+** multithread safe: any number of producers (printf) and ONE consumer (consume, writer_loop).
+**
+**  functions:
+**      - init         the constructor. capacity must be a power of 2.
+**      - printf       format a line into the ring. Returns -1 if dropped.
+**      - consume      write out the oldest line. Returns 0 if the ring was empty.
+**      - writer_loop  thread function (arg: the logring), consumes forever.
+**  attributes:
+**      - dropped, truncated, written   counters
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __LOGRING_H
+#define __LOGRING_H
+
+#include <stdlib.h>
+
+#define LOGRING_TEXTLEN 500  /* a record is 512 bytes */
+
+struct logring_record {
+    size_t sequence;
+    short fd;
+    short len;
+    char text[LOGRING_TEXTLEN];
+};
+
+struct logring {
+    struct logring_record * records;
+    size_t mask;
+    size_t enqueuepos;   /* producers */
+    size_t dequeuepos;   /* the writer only */
+    unsigned long dropped;
+    unsigned long truncated;
+    unsigned long written;
+};
+
+
+int logring_init(struct logring * lrp, size_t capacity);
+int logring_printf(struct logring * lrp, int fd, const char * format, ...) __attribute__ ((format (printf, 3, 4)));
+int logring_consume(struct logring * lrp);
+void * logring_writer_loop(void * arg);
+
+#endif /* __LOGRING_H */
@@ -0,0 +1,165 @@
+/*
+** msgview.h
+**
+** accessor views of a received messageblock
+**
+**  The fields are read in place from the receive buffer, the packet is never copied into
+**  a struct messageblock. The buffer has no alignment requirement (every access is a memcpy
+**  of the field, that compiles to a plain load on x86).
+**
+**  functions:
+**      - len        the size of a messageblock of a protocol minor version, 0 if it is not accepted
+**      - valid      returns 1 if the packet has the right size for its version, the magic and an accepted
+**                   version: the current one or 0.1. A 0.1 packet ends before schedpolicy, its
+**                   schedpolicy, schedprio and sequence read as 0 (SCHED_OTHER, no loss accounting).
+**      - major, minor  the protocol version of the packet
+**      - schedpolicy, schedprio  the scheduling of the measuring thread of the agent
+**      - sequence   the sequence number of the packet
+**      - name       the hostname and the text, directly after each other (the key of the namedb)
+**      - hostname, text
+**      - count, start, min, max, sumx, sumxx  the fields of the i-th datablock
+**      - mac        the MAC trailer after the messageblock (only if the packet has one)
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __MSGVIEW_H
+#define __MSGVIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "datablock.h"
+
+#define MSGVIEW_BLOCK(p, i) ((p) + offsetof(struct messageblock, datablockarray) + (size_t)(i) * sizeof(struct datablock))
+
+
+static inline uint16_t msgview_major(const unsigned char * p)
+{
+    uint16_t v;
+
+    memcpy(&v, p + offsetof(struct messageblock, major), sizeof(v));
+    return v;
+}
+
+static inline uint16_t msgview_minor(const unsigned char * p)
+{
+    uint16_t v;
+
+    memcpy(&v, p + offsetof(struct messageblock, minor), sizeof(v));
+    return v;
+}
+
+static inline size_t msgview_len(uint16_t minor)
+{
+    if( FSLATENCY_VERSION_MINOR == minor){
+        return sizeof(struct messageblock);
+    }
+    return FSLATENCY_VERSION_MINOR_OLDEST == minor ? offsetof(struct messageblock, schedpolicy) : 0;
+}
+
+static inline int msgview_valid(const unsigned char * p, size_t len)
+{
+    return FSLATENCY_VERSION_MAJOR == msgview_major(p) && 0 != len && msgview_len(msgview_minor(p)) == len
+        && 0 == memcmp(p + offsetof(struct messageblock, magic), FSLATENCY_MAGIC, FSLATENCY_MAGIC_LEN);
+}
+
+static inline uint64_t msgview_sequence(const unsigned char * p)
+{
+    uint64_t v;
+
+    if( FSLATENCY_VERSION_MINOR != msgview_minor(p)){
+        return 0;
+    }
+    memcpy(&v, p + offsetof(struct messageblock, sequence), sizeof(v));
+    return v;
+}
+
+static inline uint64_t msgview_mac(const unsigned char * p)
+{
+    uint64_t v;
+
+    memcpy(&v, p + sizeof(struct messageblock), sizeof(v));
+    return v;
+}
+
+static inline uint16_t msgview_schedpolicy(const unsigned char * p)
+{
+    uint16_t v;
+
+    if( FSLATENCY_VERSION_MINOR != msgview_minor(p)){
+        return 0;
+    }
+    memcpy(&v, p + offsetof(struct messageblock, schedpolicy), sizeof(v));
+    return v;
+}
+
+static inline uint16_t msgview_schedprio(const unsigned char * p)
+{
+    uint16_t v;
+
+    if( FSLATENCY_VERSION_MINOR != msgview_minor(p)){
+        return 0;
+    }
+    memcpy(&v, p + offsetof(struct messageblock, schedprio), sizeof(v));
+    return v;
+}
+
+static inline const void * msgview_name(const unsigned char * p)
+{
+    return p + offsetof(struct messageblock, hostname);
+}
+
+static inline const char * msgview_hostname(const unsigned char * p)
+{
+    return (const char *)(p + offsetof(struct messageblock, hostname));
+}
+
+static inline const char * msgview_text(const unsigned char * p)
+{
+    return (const char *)(p + offsetof(struct messageblock, text));
+}
+
+static inline uint64_t msgview_count(const unsigned char * p, int i)
+{
+    uint64_t v;
+
+    memcpy(&v, MSGVIEW_BLOCK(p, i) + offsetof(struct datablock, measurementcount), sizeof(v));
+    return v;
+}
+
+static inline void msgview_start(const unsigned char * p, int i, struct timespec * tsp)
+{
+    memcpy(tsp, MSGVIEW_BLOCK(p, i) + offsetof(struct datablock, starttime), sizeof(*tsp));
+}
+
+static inline double msgview_double(const unsigned char * p, int i, size_t offset)
+{
+    double v;
+
+    memcpy(&v, MSGVIEW_BLOCK(p, i) + offset, sizeof(v));
+    return v;
+}
+
+#define msgview_min(p, i) msgview_double((p), (i), offsetof(struct datablock, min))
+#define msgview_max(p, i) msgview_double((p), (i), offsetof(struct datablock, max))
+#define msgview_sumx(p, i) msgview_double((p), (i), offsetof(struct datablock, sumx))
+#define msgview_sumxx(p, i) msgview_double((p), (i), offsetof(struct datablock, sumxx))
+
+#endif /* __MSGVIEW_H */
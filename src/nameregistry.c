@@ -29,172 +29,349 @@
 **    in range used <= X < size freelist contains the free entries of registry
 **      so freelist[used] is a next avaiable free index of the registry
 **  free entries = size - used
+**
+**  seqlock usage:
+**    writers (under the mutex): seq_write_begin(), modify the hash index and/or the names, seq_write_end()
+**    readers (without lock): if 0 == seq_read_begin(&s): read, done unless seq_read_retry(s)
+**    a reader may see a half-modified index, so every read is bounded and every result is checked by the retry.
+**    After SEQ_READ_TRIES failed tries the reader takes the mutex: the writer may be preempted by the reader
+**    itself (a SCHED_FIFO receiver on the same CPU), spinning or sched_yield() would not let it finish.
+**    The mutex has priority inheritance, so the writer runs at the priority of the waiting reader.
 */
 
+#define SEQ_READ_TRIES 64   /* a write section is a few hundred nanoseconds */
+
+static inline uint32_t namehash(const void * name, size_t namelen)
+{
+    const unsigned char * p = (const unsigned char *) name;
+    uint32_t hash = 2166136261u; /* FNV-1a */
+    size_t i;
+
+    for( i=0; i < namelen; i++){
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+
+static inline void seq_write_begin(struct nameregistry * nrp)
+{
+    __atomic_store_n(&(nrp->seq), nrp->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seq_write_end(struct nameregistry * nrp)
+{
+    __atomic_store_n(&(nrp->seq), nrp->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* returns -1 if a writer is working */
+static inline int seq_read_begin(struct nameregistry * nrp, unsigned int * seqp)
+{
+    *seqp = __atomic_load_n(&(nrp->seq), __ATOMIC_ACQUIRE);
+    return (*seqp & 1) ? -1 : 0;
+}
+
+static inline int seq_read_retry(struct nameregistry * nrp, unsigned int seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return seq != __atomic_load_n(&(nrp->seq), __ATOMIC_RELAXED);
+}
+
+
+/* walk the chain of the name. Safe without lock, but then the result must be validated by the seqlock */
+static int lookup(struct nameregistry * nrp, const void * name, uint32_t hash)
+{
+    int32_t id;
+    size_t steps;
+
+    id = __atomic_load_n(nrp->buckets + (hash & nrp->bucketmask), __ATOMIC_RELAXED);
+    for( steps = 0; -1 != id && steps < nrp->maxsize; steps++){
+        if( 0 == memcmp(name, nrp->registry + (nrp->namelen * id), nrp->namelen)){
+            return (int) id;
+        }
+        id = __atomic_load_n(&(nrp->links[id].next), __ATOMIC_RELAXED);
+    }
+    return -1;
+}
+
+
+/* must be called under the mutex */
+static int add_locked(struct nameregistry * nrp, const void * name, uint32_t hash)
+{
+    int32_t id;
+    int32_t * bucketp = nrp->buckets + (hash & nrp->bucketmask);
+
+    if( nrp->used == nrp->size){
+        return -1;
+    }
+    id = (int32_t) nrp->freelist[nrp->used];
+    seq_write_begin(nrp);
+    memcpy(nrp->registry + (nrp->namelen * id), name, nrp->namelen);
+    nrp->links[id].next = *bucketp;
+    __atomic_store_n(bucketp, id, __ATOMIC_RELAXED);
+    nrp->used ++;
+    seq_write_end(nrp);
+    return (int) id;
+}
+
+
+/* must be called under the mutex. id must be used */
+static void remove_locked(struct nameregistry * nrp, size_t id)
+{
+    int32_t * nextp;
+    size_t position = nrp->links[id].position;
+    size_t last;
+
+    seq_write_begin(nrp);
+    /* unlink from the chain */
+    nextp = nrp->buckets + (namehash(nrp->registry + (nrp->namelen * id), nrp->namelen) & nrp->bucketmask);
+    while( *nextp != (int32_t) id){
+        nextp = &(nrp->links[*nextp].next);
+    }
+    __atomic_store_n(nextp, nrp->links[id].next, __ATOMIC_RELAXED);
+    memset(nrp->registry + (nrp->namelen * id), '.', nrp->namelen);
+    /* move it to the free range of the freelist. In the write section too: getbyid reads the positions */
+    nrp->used --;
+    last = nrp->freelist[nrp->used];
+    nrp->freelist[position] = last;
+    nrp->links[last].position = position;
+    nrp->freelist[nrp->used] = id;
+    nrp->links[id].position = nrp->used;
+    seq_write_end(nrp);
+}
+
+
 int nameregistry_init(struct nameregistry * nrp, size_t size, size_t namelen)
 {
+    return nameregistry_init_growable(nrp, size, size, namelen);
+}
+
 
-    int i;
+/*
+**  the freelist, the registry and the links are reserved for maxsize entries, but only size entries are committed.
+**  the buckets are committed at once, their number does not change.
+*/
+int nameregistry_init_growable(struct nameregistry * nrp, size_t size, size_t maxsize, size_t namelen)
+{
+    pthread_mutexattr_t attr;
+    size_t nbuckets;
 
-    if( size > 1048573){ /* should use a better implementation for lots of names. Btw 1048573 is a nice prime bellow 2**20 */
+    if( maxsize > 1048573 || size > maxsize){ /* should use a better implementation for lots of names. Btw 1048573 is a nice prime bellow 2**20 */
         return -1;
     }
-    nrp->size = size;
+    nrp->size = 0;
     nrp->used = 0;
+    nrp->maxsize = maxsize;
     nrp->namelen = namelen;
-    nrp->freelist = (size_t *) malloc( size * sizeof(size_t));
-    if( NULL == nrp->freelist){
+    nrp->seq = 0;
+    for( nbuckets = 1; nbuckets < maxsize; nbuckets *= 2){
+        ;
+    }
+    nrp->bucketmask = nbuckets - 1;
+    if( 0 != arena_init(&(nrp->freelistarena), maxsize * sizeof(size_t))){
         return -1;
     }
-    for( i=0; i<size; i++){
-        nrp->freelist[i] = i;
+    nrp->freelist = (size_t *) nrp->freelistarena.base;
+    if( 0 != arena_init(&(nrp->registryarena), namelen * maxsize)){
+        return -1;
+    }
+    nrp->registry = nrp->registryarena.base;
+    if( 0 != arena_init(&(nrp->linkarena), maxsize * sizeof(struct nameregistry_link))){
+        return -1;
+    }
+    nrp->links = (struct nameregistry_link *) nrp->linkarena.base;
+    if( 0 != arena_init(&(nrp->bucketarena), nbuckets * sizeof(int32_t))
+        || 0 != arena_commit(&(nrp->bucketarena), nbuckets * sizeof(int32_t))){
+        return -1;
     }
-    nrp->registry = malloc( namelen * size);
-    if( NULL == nrp->registry){
+    nrp->buckets = (int32_t *) nrp->bucketarena.base;
+    memset(nrp->buckets, 0xFF, nbuckets * sizeof(int32_t)); /* all -1 */
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT); /* see seqlock usage */
+    pthread_mutex_init(&(nrp->mutex), &attr);
+    pthread_mutexattr_destroy(&attr);
+    return nameregistry_grow(nrp, size);
+}
+
+
+/*
+**  the new entries are free: they are appended to the free range of the freelist.
+**  The readers never reach the new entries, so no seqlock is needed.
+*/
+int nameregistry_grow(struct nameregistry * nrp, size_t newsize)
+{
+    size_t i;
+
+    pthread_mutex_lock(&(nrp->mutex));
+    if( newsize <= nrp->size){
+        pthread_mutex_unlock(&(nrp->mutex));
+        return 0;
+    }
+    if( newsize > nrp->maxsize
+        || 0 != arena_commit(&(nrp->freelistarena), newsize * sizeof(size_t))
+        || 0 != arena_commit(&(nrp->registryarena), newsize * nrp->namelen)
+        || 0 != arena_commit(&(nrp->linkarena), newsize * sizeof(struct nameregistry_link))){
+        pthread_mutex_unlock(&(nrp->mutex));
         return -1;
     }
+    for( i=nrp->size; i<newsize; i++){
+        nrp->freelist[i] = i;
+        nrp->links[i].next = -1;
+        nrp->links[i].position = i;
+    }
     /* we sugest a clearcharacter == '.' because this is invalid for any internet name */
-    memset(nrp->registry, '.', namelen * size);
-    pthread_mutex_init(&(nrp->mutex), 0);
+    memset(nrp->registry + (nrp->namelen * nrp->size), '.', nrp->namelen * (newsize - nrp->size));
+    __atomic_store_n(&(nrp->size), newsize, __ATOMIC_RELEASE); /* the new entries are ready for the lock-free readers */
+    pthread_mutex_unlock(&(nrp->mutex));
     return 0;
 }
 
 
 int nameregistry_free(struct nameregistry * nrp)
 {
-    memset(nrp->registry, '.', nrp->namelen * nrp->size);
     nrp->size = 0;
     nrp->used = 0;
+    nrp->maxsize = 0;
     nrp->namelen = 0;
-    free(nrp->freelist);
+    arena_free(&(nrp->freelistarena));
     nrp->freelist = NULL;
-    free(nrp->registry);
+    arena_free(&(nrp->registryarena));
     nrp->registry = NULL;
+    arena_free(&(nrp->linkarena));
+    nrp->links = NULL;
+    arena_free(&(nrp->bucketarena));
+    nrp->buckets = NULL;
     pthread_mutex_destroy(&(nrp->mutex));
     return 0;
 }
 
 
-int nameregistry_find(struct nameregistry * nrp, void * name)
+int nameregistry_find(struct nameregistry * nrp, const void * name)
 {
-    int i;
+    uint32_t hash = namehash(name, nrp->namelen);
+    unsigned int seq;
     int retval;
-    pthread_mutex_lock(&(nrp->mutex));
-    /* scan only the used entries */
-    for(i=0; i < nrp->used; i++){
-        if( 0 == memcmp(name, nrp->registry + (nrp->namelen * nrp->freelist[i]), nrp->namelen)){
-            /* match found */
-            retval =  (int) nrp->freelist[i];
-            pthread_mutex_unlock(&(nrp->mutex));
-            return  retval;
+    int tries;
+
+    for( tries=0; tries < SEQ_READ_TRIES; tries++){
+        if( 0 == seq_read_begin(nrp, &seq)){
+            retval = lookup(nrp, name, hash);
+            if( !seq_read_retry(nrp, seq)){
+                return retval;
+            }
         }
     }
+    pthread_mutex_lock(&(nrp->mutex)); /* see seqlock usage */
+    retval = lookup(nrp, name, hash);
     pthread_mutex_unlock(&(nrp->mutex));
-    return -1;
+    return retval;
 }
 
 
-int nameregistry_add(struct nameregistry * nrp, void * name)
+int nameregistry_check(struct nameregistry * nrp, size_t id, const void * name)
+{
+    unsigned int seq;
+    int retval;
+    int tries;
+
+    if( id >= __atomic_load_n(&(nrp->size), __ATOMIC_RELAXED)){
+        return 0;
+    }
+    for( tries=0; tries < SEQ_READ_TRIES; tries++){
+        if( 0 == seq_read_begin(nrp, &seq)){
+            retval = (0 == memcmp(name, nrp->registry + (nrp->namelen * id), nrp->namelen));
+            if( !seq_read_retry(nrp, seq)){
+                return retval;
+            }
+        }
+    }
+    pthread_mutex_lock(&(nrp->mutex)); /* see seqlock usage */
+    retval = (0 == memcmp(name, nrp->registry + (nrp->namelen * id), nrp->namelen));
+    pthread_mutex_unlock(&(nrp->mutex));
+    return retval;
+}
+
+
+int nameregistry_add(struct nameregistry * nrp, const void * name)
 {
     int retval;
     /* no check. May duplicate add */
     pthread_mutex_lock(&(nrp->mutex));
-    if( nrp->used == nrp->size){
-        pthread_mutex_unlock(&(nrp->mutex));
-        return -1;
-    }
-    memcpy(nrp->registry + (nrp->namelen *  nrp->freelist[nrp->used]), name, nrp->namelen);
-    retval = (int) nrp->freelist[nrp->used];
-    nrp->used ++;
+    retval = add_locked(nrp, name, namehash(name, nrp->namelen));
     pthread_mutex_unlock(&(nrp->mutex));
     return retval;
 }
 
 
-int nameregistry_findadd(struct nameregistry * nrp, void * name)
+int nameregistry_findadd(struct nameregistry * nrp, const void * name)
 {
+    uint32_t hash = namehash(name, nrp->namelen);
     int retval;
-    int i;
 
     pthread_mutex_lock(&(nrp->mutex));
-    /* scan only the used entries */
-    for(i=0; i < nrp->used; i++){
-        if( 0 == memcmp(name, nrp->registry + (nrp->namelen * nrp->freelist[i]), nrp->namelen)){
-            /* match found */
-            retval =  (int) nrp->freelist[i];
-            pthread_mutex_unlock(&(nrp->mutex));
-            return retval;
-        }
+    retval = lookup(nrp, name, hash);
+    if( -1 == retval){
+        retval = add_locked(nrp, name, hash);
     }
-    if( nrp->used == nrp->size){
-        pthread_mutex_unlock(&(nrp->mutex));
-        return -1;
-    }
-    memcpy(nrp->registry + (nrp->namelen *  nrp->freelist[nrp->used]), name, nrp->namelen);
-    retval = (int) nrp->freelist[nrp->used];
-    nrp->used ++;
     pthread_mutex_unlock(&(nrp->mutex));
     return retval;
 }
 
 
-int nameregistry_remove(struct nameregistry * nrp, void * name)
+int nameregistry_remove(struct nameregistry * nrp, const void * name)
 {
-    int i;
-    size_t indextmp;
+    int retval;
+
     pthread_mutex_lock(&(nrp->mutex));
-    /* scan only the used entries */
-    for(i=0; i < nrp->used; i++){
-        indextmp = nrp->freelist[i];
-        if( 0 == memcmp(name, nrp->registry + (nrp->namelen * indextmp), nrp->namelen)){
-            /* match found */
-            memset(nrp->registry + (nrp->namelen * indextmp), '.', nrp->namelen);
-            nrp->used --;
-            nrp->freelist[i] = nrp->freelist[nrp->used];
-            nrp->freelist[nrp->used] = indextmp;
-            pthread_mutex_unlock(&(nrp->mutex));
-            return  (int) indextmp;
-        }
+    retval = lookup(nrp, name, namehash(name, nrp->namelen));
+    if( -1 != retval){
+        remove_locked(nrp, (size_t) retval);
     }
     pthread_mutex_unlock(&(nrp->mutex));
-    return -1; /* if not found */
+    return retval; /* -1 if not found */
 }
 
 
 int nameregistry_removebyid(struct nameregistry * nrp, size_t id)
 {
-    int i;
-
     pthread_mutex_lock(&(nrp->mutex));
-    for(i=0; i < nrp->used; i++){
-        if( id == nrp->freelist[i] ){
-            memset(nrp->registry + (nrp->namelen * id), '.', nrp->namelen);
-            nrp->used --;
-            nrp->freelist[i] = nrp->freelist[nrp->used];
-            nrp->freelist[nrp->used] = id;
-            pthread_mutex_unlock(&(nrp->mutex));
-            return (int) id;
-        }
+    if( id >= nrp->size || nrp->links[id].position >= nrp->used){
+        pthread_mutex_unlock(&(nrp->mutex));
+        return -1; /* id not used */
     }
+    remove_locked(nrp, id);
     pthread_mutex_unlock(&(nrp->mutex));
-    return -1; /* id not used */
+    return (int) id;
 }
 
 
 int nameregistry_getbyid(struct nameregistry * nrp, size_t id, void * name)
 {
-    int i;
+    unsigned int seq;
+    int retval;
+    int tries;
 
-    pthread_mutex_lock(&(nrp->mutex));
-    for(i=0; i < nrp->used; i++){
-        if( id == nrp->freelist[i] ){
-            memcpy(name, nrp->registry + (nrp->namelen * id), nrp->namelen);
-            pthread_mutex_unlock(&(nrp->mutex));
-            return (int) id;
+    if( id >= __atomic_load_n(&(nrp->size), __ATOMIC_ACQUIRE)){
+        return -1;
+    }
+    for( tries=0; tries < SEQ_READ_TRIES; tries++){
+        if( 0 == seq_read_begin(nrp, &seq)){
+            retval = __atomic_load_n(&(nrp->links[id].position), __ATOMIC_RELAXED) < __atomic_load_n(&(nrp->used), __ATOMIC_RELAXED)
+                ? (int) id : -1; /* -1: id not used */
+            if( -1 != retval){
+                memcpy(name, nrp->registry + (nrp->namelen * id), nrp->namelen);
+            }
+            if( !seq_read_retry(nrp, seq)){
+                return retval;
+            }
         }
     }
+    pthread_mutex_lock(&(nrp->mutex)); /* see seqlock usage */
+    retval = nrp->links[id].position < nrp->used ? (int) id : -1;
+    if( -1 != retval){
+        memcpy(name, nrp->registry + (nrp->namelen * id), nrp->namelen);
+    }
     pthread_mutex_unlock(&(nrp->mutex));
-    return -1; /* id not used */
-
+    return retval;
 }
-
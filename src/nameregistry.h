@@ -6,18 +6,26 @@
 **  registers a fixed-length name and assigns it an ID. The ID is a small (20bit) integer.
 **  useable a name <-> id mapping.
 **
-** NOT multithrad safe
+** multithread safe. find, check and getbyid are lock-free: a hash index protected by a seqlock,
+** the readers retry if a writer changed the index meanwhile, and wait for a slow (preempted)
+** writer on the internal mutex after a few tries. All others take the internal mutex.
 **
 **  functions:
 **      - init     the constructor
+**      - init_growable  the constructor of a registry that can grow up to maxsize entries.
+**      - grow     make the registry larger. The IDs remain valid, the new IDs are free.
 **      - free     the destructor
-**      - find     find a name in the registry. Returns an ID.
+**      - find     find a name in the registry. Returns an ID. Lock-free.
+**      - check    returns 1 if the ID belongs to the name (it was not removed or reused meanwhile). Lock-free.
 **      - add      insert a perviously unknown name to the registry. Returns an ID.
 **      - findadd  Returns an ID either find or add.
 **      - remove   Remove a name from the registry. No error if not found.
+**      - removebyid  Remove the name of an ID. Returns -1 if the ID is not used.
+**      - getbyid  copy the name of an ID. Returns -1 if the ID is not used. Lock-free.
 **  attributes:
 **      - size      total length of registry
 **      - used      used entryes in the registry
+**      - maxsize   the registry can grow up to this size
 **
 **
 ** Copyright by Adam Maulis maulis@andrews.hu 2025
@@ -41,7 +49,9 @@
 #define __NAMEREGISTRY_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <pthread.h>
+#include "arena.h"
 
 /*
 **  freelist usage: (how to handle the fragmantation if the registry)
@@ -51,22 +61,46 @@
 **  free entries = size - used
 */
 
+/*
+**  hash index: buckets[hash & bucketmask] is the first ID of a chain, links[ID].next is the next one (-1 terminated).
+**    the number of buckets is a power of 2, at least maxsize, so the chains are short.
+**    links[ID].position is the index of the ID in the freelist, so removebyid and getbyid are O(1).
+**  seq is the sequence counter of the seqlock: odd while a writer modifies the index, the names or the positions.
+*/
+
+struct nameregistry_link {
+    int32_t next;
+    uint32_t position;
+};
+
 struct nameregistry {
     size_t size;
     size_t used;
+    size_t maxsize;
     size_t namelen;
     size_t * freelist;
     void * registry;
+    int32_t * buckets;
+    size_t bucketmask;
+    struct nameregistry_link * links;
+    unsigned int seq;
+    struct arena freelistarena;
+    struct arena registryarena;
+    struct arena bucketarena;
+    struct arena linkarena;
     pthread_mutex_t mutex;
 };
 
 
 int nameregistry_init(struct nameregistry * nrp, size_t size, size_t namelen);
+int nameregistry_init_growable(struct nameregistry * nrp, size_t size, size_t maxsize, size_t namelen);
+int nameregistry_grow(struct nameregistry * nrp, size_t newsize);
 int nameregistry_free(struct nameregistry * nrp);
-int nameregistry_find(struct nameregistry * nrp, void * name);
-int nameregistry_add(struct nameregistry * nrp, void * name);
-int nameregistry_findadd(struct nameregistry * nrp, void * name);
-int nameregistry_remove(struct nameregistry * nrp, void * name);
+int nameregistry_find(struct nameregistry * nrp, const void * name);
+int nameregistry_check(struct nameregistry * nrp, size_t id, const void * name);
+int nameregistry_add(struct nameregistry * nrp, const void * name);
+int nameregistry_findadd(struct nameregistry * nrp, const void * name);
+int nameregistry_remove(struct nameregistry * nrp, const void * name);
 int nameregistry_removebyid(struct nameregistry * nrp, size_t id);
 int nameregistry_getbyid(struct nameregistry * nrp, size_t id, void * name);
 
@@ -0,0 +1,111 @@
+/*
+** ratelimit.c
+**
+** token bucket rate limiting implementations. See ratelimit.h
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ratelimit.h"
+
+
+void ratelimit_init(struct ratelimit * rlp, uint32_t rate, uint32_t burst, uint32_t tickspersec)
+{
+    rlp->rate = rate;
+    rlp->burst = burst > 0 ? burst : 1;
+    rlp->tickspersec = tickspersec;
+}
+
+
+void ratelimit_fill(const struct ratelimit * rlp, struct tokenbucket * tbp, uint64_t now)
+{
+    tbp->tokens = (uint64_t) rlp->burst * rlp->tickspersec;
+    tbp->tick = now;
+}
+
+
+int ratelimit_take(const struct ratelimit * rlp, struct tokenbucket * tbp, uint64_t now)
+{
+    uint64_t full = (uint64_t) rlp->burst * rlp->tickspersec;
+    uint64_t elapsed;
+
+    if( 0 == rlp->rate){
+        return 1;
+    }
+    if( now > tbp->tick){
+        elapsed = now - tbp->tick;
+        if( elapsed > full){ /* rate >= 1: it is full anyway, and no overflow */
+            elapsed = full;
+        }
+        tbp->tokens += elapsed * rlp->rate;
+        if( tbp->tokens > full){
+            tbp->tokens = full;
+        }
+        tbp->tick = now;
+    }
+    if( tbp->tokens < rlp->tickspersec){
+        return 0;
+    }
+    tbp->tokens -= rlp->tickspersec;
+    return 1;
+}
+
+
+/* a packet passes if the bucket is not more than burst packets ahead of now after it */
+int ratelimit_take_shared(const struct ratelimit * rlp, struct sharedbucket * sbp, uint64_t now)
+{
+    uint64_t t = now * rlp->rate;
+    uint64_t tat, newtat;
+
+    if( 0 == rlp->rate){
+        return 1;
+    }
+    tat = __atomic_load_n(&(sbp->tat), __ATOMIC_RELAXED);
+    do {
+        newtat = (tat > t ? tat : t) + rlp->tickspersec;
+        if( newtat - t > (uint64_t) rlp->burst * rlp->tickspersec){
+            return 0;
+        }
+    } while( !__atomic_compare_exchange_n(&(sbp->tat), &tat, newtat, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return 1;
+}
+
+
+int sourcelimit_init(struct sourcelimit * slp, size_t size, uint32_t rate, uint32_t burst, uint32_t tickspersec)
+{
+    unsigned int bits = 0;
+
+    if( size < 2 || 0 != (size & (size - 1)) || size > ((size_t) 1 << 31)){
+        return -1;
+    }
+    while( ((size_t) 1 << bits) < size){
+        bits ++;
+    }
+    slp->buckets = (struct tokenbucket *) calloc(size, sizeof(struct tokenbucket));
+    if( NULL == slp->buckets){
+        return -1;
+    }
+    slp->shift = 32 - bits;
+    ratelimit_init(&(slp->limit), rate, burst, tickspersec);
+    return 0;
+}
+
+
+int sourcelimit_take(struct sourcelimit * slp, uint32_t addr, uint64_t now)
+{
+    /* multiplicative hash: the high bits depend on every bit of the address */
+    return ratelimit_take(&(slp->limit), slp->buckets + ((uint32_t) (addr * 2654435761u) >> slp->shift), now);
+}
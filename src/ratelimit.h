@@ -0,0 +1,79 @@
+/*
+** ratelimit.h
+**
+** token bucket rate limiting definitions (flood protection of the data processor)
+**
+**  A bucket holds at most burst packets, and gets rate packets per second. A packet takes one,
+**  if there is none, the packet is shed. The time is in ticks of the caller (tickspersec per second),
+**  the tokens are counted in 1/tickspersec packets, so there is no floating point and no rounding loss.
+**  A zeroed bucket is a full one (its last tick is long ago).
+**  A shared bucket is the same limit for several threads, in one word updated with compare and swap:
+**  the theoretical arrival time of the next packet (GCRA), in 1/rate ticks. A zeroed one is full too.
+**  The sourcelimit is a fixed size table of buckets, indexed by the hash of the IPv4 source address.
+**  There are no keys: the addresses of a colliding pair share the bucket (fixed memory,
+**  and a flood of spoofed addresses cannot evict anything).
+**
+** not multithread safe: one thread (the receiver) uses them. Except ratelimit_take_shared().
+**
+**  functions:
+**      - ratelimit_init    the constructor of a limit (rate 0: unlimited)
+**      - ratelimit_fill    makes the bucket full
+**      - ratelimit_take    takes a token: returns 1 if the packet passes, 0 if it is shed
+**      - ratelimit_take_shared  the same on a shared bucket. Multithread safe, lock-free.
+**      - sourcelimit_init  the constructor of the table. size must be a power of 2. Returns 0 or -1 (no memory)
+**      - sourcelimit_take  ratelimit_take() on the bucket of the address
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __RATELIMIT_H
+#define __RATELIMIT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct tokenbucket {
+    uint64_t tokens; /* in 1/tickspersec packets */
+    uint64_t tick;   /* of the last refill */
+};
+
+struct sharedbucket {
+    uint64_t tat;    /* now * rate when it is full, + tickspersec per packet taken */
+};
+
+struct ratelimit {
+    uint32_t rate;        /* packets per second, 0: unlimited */
+    uint32_t burst;       /* packets */
+    uint32_t tickspersec;
+};
+
+struct sourcelimit {
+    struct ratelimit limit;
+    struct tokenbucket * buckets;
+    unsigned int shift;   /* 32 - log2(size) */
+};
+
+
+void ratelimit_init(struct ratelimit * rlp, uint32_t rate, uint32_t burst, uint32_t tickspersec);
+void ratelimit_fill(const struct ratelimit * rlp, struct tokenbucket * tbp, uint64_t now);
+int ratelimit_take(const struct ratelimit * rlp, struct tokenbucket * tbp, uint64_t now);
+int ratelimit_take_shared(const struct ratelimit * rlp, struct sharedbucket * sbp, uint64_t now);
+int sourcelimit_init(struct sourcelimit * slp, size_t size, uint32_t rate, uint32_t burst, uint32_t tickspersec);
+int sourcelimit_take(struct sourcelimit * slp, uint32_t addr, uint64_t now);
+
+#endif /* __RATELIMIT_H */
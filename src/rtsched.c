@@ -0,0 +1,211 @@
+/*
+** rtsched.c
+**
+** per-thread scheduling and stack implementations. See rtsched.h
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE 1 /* pthread_attr_setaffinity_np, pthread_setname_np */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "rtsched.h"
+
+
+const char * rtsched_policyname(int policy)
+{
+    switch( policy){
+        case SCHED_FIFO:
+            return "fifo";
+        case SCHED_RR:
+            return "rr";
+        default:
+            return "other";
+    }
+}
+
+
+/* NAME:POLICY:PRIO[:CPU] */
+int rtsched_add(struct rtsched * rsp, const char * spec, const char * const * names)
+{
+    struct rtsched_entry e;
+    char buff[64];
+    char * field[5];  /* the 5th one is an error */
+    char * saveptr;
+    char * end;
+    int n = 0;
+    int i;
+
+    if( strlen(spec) >= sizeof(buff)){
+        return -1;
+    }
+    strcpy(buff, spec);
+    while( n < 5 && NULL != (field[n] = strtok_r(0 == n ? buff : NULL, ":", &saveptr))){
+        n++;
+    }
+    if( n < 3 || n > 4 || strlen(field[0]) >= RTSCHED_NAME_LEN){
+        return -1;
+    }
+    for( i=0; NULL != names[i] && 0 != strcmp(names[i], field[0]); i++){
+        ;
+    }
+    if( NULL == names[i]){
+        return -1; /* unknown thread */
+    }
+    strcpy(e.name, field[0]);
+
+    if( 0 == strcmp(field[1], "fifo")){
+        e.policy = SCHED_FIFO;
+    } else if( 0 == strcmp(field[1], "rr")){
+        e.policy = SCHED_RR;
+    } else if( 0 == strcmp(field[1], "other")){
+        e.policy = SCHED_OTHER;
+    } else {
+        return -1;
+    }
+    e.prio = strtol(field[2], &end, 10);
+    if( '\0' != *end || e.prio < sched_get_priority_min(e.policy) || e.prio > sched_get_priority_max(e.policy)){
+        return -1;
+    }
+    e.cpu = -1;
+    if( 4 == n){
+        e.cpu = strtol(field[3], &end, 10);
+        if( '\0' != *end || e.cpu < 0 || e.cpu >= CPU_SETSIZE){
+            return -1;
+        }
+    }
+
+    /* the last one wins */
+    for( i=0; i < rsp->n && 0 != strcmp(rsp->entry[i].name, e.name); i++){
+        ;
+    }
+    if( i == RTSCHED_MAX){
+        return -1;
+    }
+    rsp->entry[i] = e;
+    if( i == rsp->n){
+        rsp->n ++;
+    }
+    return 0;
+}
+
+
+const struct rtsched_entry * rtsched_find(const struct rtsched * rsp, const char * name)
+{
+    int i;
+
+    for( i=0; i < rsp->n; i++){
+        if( 0 == strcmp(rsp->entry[i].name, name)){
+            return rsp->entry + i;
+        }
+    }
+    return NULL;
+}
+
+
+/*
+** The stack is never freed: the threads run until the process exits.
+*/
+int rtsched_create(const struct rtsched * rsp, const char * name, pthread_t * thread, void * (*start_routine)(void *), void * arg)
+{
+    const struct rtsched_entry * ep = rtsched_find(rsp, name);
+    struct sched_param param;
+    pthread_attr_t attr;
+    cpu_set_t cpus;
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    char * stack;
+    int retval;
+
+    /* the lowest page is the guard, the others are populated now */
+    stack = (char *) mmap(NULL, RTSCHED_STACK_SIZE + pagesize, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_POPULATE, -1, 0);
+    if( MAP_FAILED == stack){
+        return errno;
+    }
+    if( 0 != mprotect(stack, pagesize, PROT_NONE)){
+        retval = errno;
+        munmap(stack, RTSCHED_STACK_SIZE + pagesize);
+        return retval;
+    }
+
+    pthread_attr_init(&attr);
+    retval = pthread_attr_setstack(&attr, stack + pagesize, RTSCHED_STACK_SIZE);
+    if( 0 == retval && NULL != ep){
+        param.sched_priority = ep->prio;
+        retval = pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        if( 0 == retval){
+            retval = pthread_attr_setschedpolicy(&attr, ep->policy);
+        }
+        if( 0 == retval){
+            retval = pthread_attr_setschedparam(&attr, &param);
+        }
+        if( 0 == retval && ep->cpu >= 0){
+            CPU_ZERO(&cpus);
+            CPU_SET(ep->cpu, &cpus);
+            retval = pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+        }
+    }
+    if( 0 == retval){
+        retval = pthread_create(thread, &attr, start_routine, arg);
+    }
+    pthread_attr_destroy(&attr);
+    if( 0 != retval){
+        munmap(stack, RTSCHED_STACK_SIZE + pagesize);
+        return retval;
+    }
+    pthread_setname_np(*thread, name);
+    return 0;
+}
+
+
+int rtsched_self(const struct rtsched * rsp, const char * name)
+{
+    const struct rtsched_entry * ep = rtsched_find(rsp, name);
+    struct sched_param param;
+    cpu_set_t cpus;
+    int retval;
+
+    if( NULL == ep){
+        return 0;
+    }
+    param.sched_priority = ep->prio;
+    retval = pthread_setschedparam(pthread_self(), ep->policy, &param);
+    if( 0 == retval && ep->cpu >= 0){
+        CPU_ZERO(&cpus);
+        CPU_SET(ep->cpu, &cpus);
+        retval = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+    return retval;
+}
+
+
+/* noinline: the array must be below the stack frame of the caller */
+__attribute__ ((noinline)) void rtsched_prefault_stack(size_t size)
+{
+    volatile char buff[size] __attribute__ ((unused));
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    size_t i;
+
+    for( i=0; i < size; i += pagesize){
+        buff[i] = 0;
+    }
+}
@@ -0,0 +1,68 @@
+/*
+** rtsched.h
+**
+** per-thread scheduling and stack definitions (agent and data processor)
+**
+**  The threads have names. --threadsched NAME:POLICY:PRIO[:CPU] sets the scheduling policy
+**  (fifo, rr or other), the priority and optionally the CPU of the named thread.
+**  Every thread gets a preallocated and prefaulted stack of RTSCHED_STACK_SIZE bytes
+**  (with a guard page), so a later mlockall() locks only what the thread really has,
+**  and the thread never page faults on its stack.
+**
+**  functions:
+**      - add          parse one --threadsched argument. names: the NULL terminated list of the thread names.
+**      - find         the setting of a thread, NULL if it has none
+**      - create       pthread_create() with the prefaulted stack and the setting of the named thread.
+**                     Returns 0 or the error number of pthread_create() (EPERM: no right for realtime scheduling)
+**      - self         applies the setting of the named thread to the calling thread (the main thread)
+**      - prefault_stack  touches the next size bytes of the stack of the calling thread
+**      - policyname   "fifo", "rr" or "other"
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __RTSCHED_H
+#define __RTSCHED_H
+
+#include <pthread.h>
+
+#define RTSCHED_NAME_LEN 16   /* like the kernel thread names */
+#define RTSCHED_MAX 16
+#define RTSCHED_STACK_SIZE (256 * 1024)
+
+struct rtsched_entry {
+    char name[RTSCHED_NAME_LEN];
+    int policy;  /* SCHED_OTHER, SCHED_FIFO, SCHED_RR */
+    int prio;    /* 1-99 for fifo and rr, 0 for other */
+    int cpu;     /* -1: not pinned */
+};
+
+struct rtsched {
+    int n;
+    struct rtsched_entry entry[RTSCHED_MAX];
+};
+
+
+int rtsched_add(struct rtsched * rsp, const char * spec, const char * const * names);
+const struct rtsched_entry * rtsched_find(const struct rtsched * rsp, const char * name);
+int rtsched_create(const struct rtsched * rsp, const char * name, pthread_t * thread, void * (*start_routine)(void *), void * arg);
+int rtsched_self(const struct rtsched * rsp, const char * name);
+void rtsched_prefault_stack(size_t size);
+const char * rtsched_policyname(int policy);
+
+#endif /* __RTSCHED_H */
@@ -0,0 +1,145 @@
+/*
+** rules.c
+**
+** per-client detection profiles implementations. See rules.h
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "rules.h"
+
+#define RULES_SEPARATORS " \t\r\n"
+
+
+void rules_init(struct rules * rp, const struct rules_profile * defaults)
+{
+    memset(rp, 0, sizeof(struct rules));
+    rp->n = 1;
+    rp->profile[0] = *defaults;
+    rp->min = *defaults;
+}
+
+
+/* one key=value of a rule into pp. Returns -1 if it is wrong */
+static int rules_setting(struct rules_profile * pp, char * setting, int maxwindow)
+{
+    char * value = strchr(setting, '=');
+    char * end;
+    double d;
+    long l;
+
+    if( NULL == value){
+        return -1;
+    }
+    *(value ++) = '\0';
+    d = strtod(value, &end);
+    if( end == value || '\0' != *end){
+        return -1;
+    }
+    l = (long) d;
+    if( 0 == strcmp(setting, "latencythresholdfactor") && 0.0 < d){
+        pp->latencythresholdfactor = d;
+    } else if( 0 == strcmp(setting, "madthresholdfactor") && 0.0 < d){
+        pp->madthresholdfactor = d;
+    } else if( 0 == strcmp(setting, "minimummeasurementcount") && 0 <= l && d == l){
+        pp->minimummeasurementcount = (int) l;
+    } else if( 0 == strcmp(setting, "rollingwindow") && 8 <= l && l <= maxwindow && d == l){
+        pp->rollingwindow = (int) l;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+
+int rules_read(struct rules * rp, const char * filename)
+{
+    char line[RULES_LINE_LEN];
+    struct rules_profile * pp;
+    struct rules_prefix * mp;
+    char * saveptr;
+    char * token;
+    FILE * fp;
+    int lineno = 0;
+    int wrong = 0;
+
+    fp = fopen(filename, "r");
+    if( NULL == fp){
+        return -1;
+    }
+    while( NULL != fgets(line, sizeof(line), fp)){
+        lineno ++;
+        token = strtok_r(line, RULES_SEPARATORS, &saveptr);
+        if( NULL == token || '#' == token[0]){
+            continue;
+        }
+        wrong = lineno; /* until it is all right */
+        if( RULES_MAX == rp->n){
+            break; /* too many */
+        }
+        pp = rp->profile + rp->n;
+        mp = rp->prefix + rp->n;
+        *pp = rp->profile[0];
+        memset(mp, 0, sizeof(struct rules_prefix));
+        if( 0 == strcmp(token, "host")){
+            mp->field = RULES_HOST;
+        } else if( 0 == strcmp(token, "text")){
+            mp->field = RULES_TEXT;
+        } else {
+            break;
+        }
+        token = strtok_r(NULL, RULES_SEPARATORS, &saveptr);
+        if( NULL == token || RULES_PREFIX_LEN < strlen(token)){
+            break;
+        }
+        mp->len = strlen(token);
+        memcpy(mp->prefix, token, mp->len);
+        while( NULL != (token = strtok_r(NULL, RULES_SEPARATORS, &saveptr))
+            && 0 == rules_setting(pp, token, rp->profile[0].rollingwindow)){
+            ;
+        }
+        if( NULL != token || (pp->rollingwindow - 1) * 9 < pp->minimummeasurementcount){
+            break; /* a wrong setting, or a window that never has enough measurements */
+        }
+        if( pp->latencythresholdfactor < rp->min.latencythresholdfactor){
+            rp->min.latencythresholdfactor = pp->latencythresholdfactor;
+        }
+        if( pp->minimummeasurementcount < rp->min.minimummeasurementcount){
+            rp->min.minimummeasurementcount = pp->minimummeasurementcount;
+        }
+        rp->n ++;
+        wrong = 0;
+    }
+    fclose(fp);
+    return wrong;
+}
+
+
+uint8_t rules_match(const struct rules * rp, const char * hostname, const char * text)
+{
+    const struct rules_prefix * mp;
+    int i;
+
+    for( i=1; i < rp->n; i++){
+        mp = rp->prefix + i;
+        if( 0 == memcmp(RULES_HOST == mp->field ? hostname : text, mp->prefix, mp->len)){
+            return (uint8_t) i;
+        }
+    }
+    return 0;
+}
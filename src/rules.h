@@ -0,0 +1,80 @@
+/*
+** rules.h
+**
+** per-client detection profiles definitions (--rulesfile)
+**
+**  A rules file assigns a profile of detection settings to the clients by the prefix of their
+**  hostname or text. It is read once at startup. A client gets its profile when it is added,
+**  and keeps only its small index, so the alarmer never matches strings.
+**  Profile 0 is the default: the settings of the command line. A setting not given in a rule
+**  is the default one. The first matching rule wins. One rule per line:
+**      host|text PREFIX [latencythresholdfactor=F] [madthresholdfactor=F]
+**                       [minimummeasurementcount=N] [rollingwindow=N]
+**  Empty lines and lines starting with # are skipped. The rollingwindow of a rule can not be
+**  longer than the default one (the rings of the clients are allocated for that).
+**
+**  functions:
+**      - init     the constructor. defaults: the settings of profile 0.
+**      - read     the rules from a file. Returns 0, -1 if the file cannot be opened,
+**                 or the number of the first wrong line.
+**      - match    the profile of a client. hostname and text: zero padded, not always terminated
+**  attributes:
+**      - n        number of profiles, with the default one
+**      - min      the lowest latencythresholdfactor and minimummeasurementcount of all profiles
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __RULES_H
+#define __RULES_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define RULES_MAX 64          /* profiles, with the default one */
+#define RULES_PREFIX_LEN 64   /* like FSLATENCY_HOSTNAME_LEN and FSLATENCY_TEXT_LEN */
+#define RULES_LINE_LEN 512
+#define RULES_HOST 0
+#define RULES_TEXT 1
+
+struct rules_profile {
+    double latencythresholdfactor;
+    double madthresholdfactor;
+    int minimummeasurementcount;
+    int rollingwindow;
+};
+
+struct rules_prefix {
+    int field;                /* RULES_HOST or RULES_TEXT */
+    size_t len;
+    char prefix[RULES_PREFIX_LEN];
+};
+
+struct rules {
+    int n;
+    struct rules_prefix prefix[RULES_MAX];    /* of profile i, prefix[0] is not used */
+    struct rules_profile profile[RULES_MAX];
+    struct rules_profile min;
+};
+
+
+void rules_init(struct rules * rp, const struct rules_profile * defaults);
+int rules_read(struct rules * rp, const char * filename);
+uint8_t rules_match(const struct rules * rp, const char * hostname, const char * text);
+
+#endif /* __RULES_H */
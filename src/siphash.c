@@ -0,0 +1,103 @@
+/*
+** siphash.c
+**
+** SipHash-2-4 implementations. See siphash.h
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "siphash.h"
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND \
+    do { \
+        v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+        v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+        v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+        v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+    } while(0)
+
+
+/* little endian words, like the reference. The protocol is host order anyway (x86). */
+static inline uint64_t load64(const uint8_t * p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+
+uint64_t siphash24(const void * data, size_t len, const uint8_t * key)
+{
+    const uint8_t * p = (const uint8_t *) data;
+    const uint8_t * end = p + (len & ~(size_t) 7);
+    uint64_t k0 = load64(key);
+    uint64_t k1 = load64(key + 8);
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+    uint64_t m;
+    uint64_t b = ((uint64_t) len) << 56;
+    int i;
+
+    for( ; p != end; p += 8){
+        m = load64(p);
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+    for( i = len & 7; i > 0; i--){
+        b |= ((uint64_t) p[i - 1]) << (8 * (i - 1));
+    }
+    v3 ^= b;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+
+int siphash_readkey(const char * filename, uint8_t * key)
+{
+    FILE * fp;
+    unsigned int byte;
+    int i;
+
+    fp = fopen(filename, "r");
+    if( NULL == fp){
+        return -1;
+    }
+    for( i=0; i < SIPHASH_KEY_LEN; i++){
+        if( 1 != fscanf(fp, "%2x", &byte)){
+            break;
+        }
+        key[i] = byte;
+    }
+    fclose(fp);
+    return SIPHASH_KEY_LEN == i ? 0 : -1;
+}
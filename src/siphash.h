@@ -0,0 +1,45 @@
+/*
+** siphash.h
+**
+** SipHash-2-4 message authentication definitions
+**
+**  A keyed 64 bit MAC of J.-P. Aumasson and D. J. Bernstein: cheap enough to check every packet,
+**  no library needed (static binaries). With --authkeyfile the agent appends it to the messageblock,
+**  and the data processor drops the packets with a wrong one.
+**  The key file contains the 16 byte key as 32 hexadecimal digits (the rest of the file is ignored),
+**  e.g. made with: od -An -N16 -tx1 /dev/urandom | tr -d ' \n' > fslatency.key
+**
+**  functions:
+**      - siphash24    the MAC of len bytes
+**      - readkey      reads the key file. Returns 0 or -1.
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __SIPHASH_H
+#define __SIPHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SIPHASH_KEY_LEN 16
+
+uint64_t siphash24(const void * data, size_t len, const uint8_t * key);
+int siphash_readkey(const char * filename, uint8_t * key);
+
+#endif /* __SIPHASH_H */
@@ -0,0 +1,97 @@
+/*
+** slo.c
+**
+** latency SLO accounting implementations. See slo.h
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "slo.h"
+
+#define SLO_MINUTE_FULL 255
+
+
+void slo_init(struct slo * sp)
+{
+    memset(sp, 0, sizeof(struct slo));
+}
+
+
+/* the ring moves forward to minute: the buckets of the minutes and hours between are cleared */
+static void slo_advance(struct slo * sp, uint32_t minute)
+{
+    uint32_t m, h, i;
+
+    if( minute - sp->minute >= SLO_MINUTES){
+        memset(sp->minutetotal, 0, sizeof(sp->minutetotal));
+        memset(sp->minutebad, 0, sizeof(sp->minutebad));
+        sp->total1h = sp->bad1h = 0;
+    } else {
+        for( m = sp->minute + 1; m <= minute; m++){
+            i = m % SLO_MINUTES;
+            sp->total1h -= sp->minutetotal[i];
+            sp->bad1h -= sp->minutebad[i];
+            sp->minutetotal[i] = sp->minutebad[i] = 0;
+        }
+    }
+    if( minute / 60 - sp->minute / 60 >= SLO_HOURS){
+        memset(sp->hourtotal, 0, sizeof(sp->hourtotal));
+        memset(sp->hourbad, 0, sizeof(sp->hourbad));
+        sp->total24h = sp->bad24h = 0;
+    } else {
+        for( h = sp->minute / 60 + 1; h <= minute / 60; h++){
+            i = h % SLO_HOURS;
+            sp->total24h -= sp->hourtotal[i];
+            sp->bad24h -= sp->hourbad[i];
+            sp->hourtotal[i] = sp->hourbad[i] = 0;
+        }
+    }
+    sp->minute = minute;
+}
+
+
+void slo_add(struct slo * sp, uint32_t minute, int bad)
+{
+    uint32_t i, h;
+
+    if( minute > sp->minute){
+        slo_advance(sp, minute);
+    } else if( sp->minute - minute >= SLO_MINUTES){
+        return; /* too late */
+    }
+    i = minute % SLO_MINUTES;
+    if( SLO_MINUTE_FULL == sp->minutetotal[i]){
+        return;
+    }
+    h = minute / 60 % SLO_HOURS;
+    sp->minutetotal[i] ++;
+    sp->hourtotal[h] ++;
+    sp->total1h ++;
+    sp->total24h ++;
+    if( bad){
+        sp->minutebad[i] ++;
+        sp->hourbad[h] ++;
+        sp->bad1h ++;
+        sp->bad24h ++;
+    }
+}
+
+
+double slo_compliance(uint64_t total, uint64_t bad)
+{
+    return 0 == total ? 100.0 : 100.0 * (total - bad) / total;
+}
@@ -0,0 +1,65 @@
+/*
+** slo.h
+**
+** latency SLO accounting definitions (per client, in the data processor)
+**
+**  Every datablock is a second of the client, good or bad (its max is over the SLO latency, or it is empty).
+**  The seconds are counted in a ring of SLO_MINUTES minute buckets and a ring of SLO_HOURS hour buckets,
+**  so the compliance of the last hour and of the last day (the current hour and the 23 before) needs
+**  no history of the datablocks: sizeof(struct slo) per client. The sums of the rings are maintained
+**  incrementally: the buckets leaving the rings are subtracted. O(1) per datablock (amortized:
+**  a gap of k minutes clears k buckets, at most all of them).
+**  A minute bucket counts at most 255 seconds, the seconds over it are not counted.
+**
+** NOT multithread safe: the caller locks.
+**
+**  functions:
+**      - init         the constructor, no seconds
+**      - add          counts a second of the minute (any monotonic minute counter). A minute before
+**                     the latest one is counted in its bucket, if it is still in the ring.
+**      - compliance   the part of the good seconds in percent, 100.0 if there is no second
+**  attributes:
+**      - total1h, bad1h, total24h, bad24h   the sums of the rings
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __SLO_H
+#define __SLO_H
+
+#include <stdint.h>
+
+#define SLO_MINUTES 60
+#define SLO_HOURS 24
+
+struct slo {
+    uint32_t minute;                     /* the latest one */
+    uint8_t minutetotal[SLO_MINUTES];    /* at minute % SLO_MINUTES */
+    uint8_t minutebad[SLO_MINUTES];
+    uint16_t hourtotal[SLO_HOURS];       /* at minute / 60 % SLO_HOURS */
+    uint16_t hourbad[SLO_HOURS];
+    uint32_t total1h, bad1h;
+    uint32_t total24h, bad24h;
+};
+
+
+void slo_init(struct slo * sp);
+void slo_add(struct slo * sp, uint32_t minute, int bad);
+double slo_compliance(uint64_t total, uint64_t bad);
+
+#endif /* __SLO_H */
@@ -0,0 +1,405 @@
+/*
+** statusscan.c
+**
+** vectorized scan kernels. See statusscan.h
+**
+**  every kernel has a scalar, an SSE2 and an AVX2 implementation. The SIMD ones are compiled
+**  with target attributes, so the binary runs on any x86_64 and selects the best one at startup.
+**  The arithmetic is the same in all of them (same operations in the same order per client),
+**  so the verdicts are identical.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <math.h>
+#include "statusscan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STATUSSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+
+/*
+** scalar implementations. These also process the tails of the SIMD ones.
+*/
+
+static void countalarms_scalar(const uint32_t * alarm, size_t n, unsigned int * counts)
+{
+    size_t i;
+    int b;
+
+    for( i=0; i < n; i++){
+        if( alarm[i]){
+            counts[0] ++;
+        }
+        for( b=0; b < STATUSSCAN_BITS; b++){
+            if( alarm[i] & (1u << b)){
+                counts[1+b] ++;
+            }
+        }
+    }
+}
+
+
+static void threshold_scalar(const struct statusscan_window * wp, size_t from, size_t n, double factor, double minimumcount,
+                             uint8_t * verdict, struct statusscan_total * tp)
+{
+    size_t i;
+    double sumN, mean, std;
+
+    for( i=from; i < n; i++){
+        sumN = wp->sumN[i];
+        mean = wp->sumx[i] / sumN;
+        std = sqrt((wp->sumxx[i] - wp->sumx[i]*mean)/(sumN-1.0));
+        verdict[i] = 0;
+        if( sumN > minimumcount){
+            if( wp->lastmin[i] < mean - std * factor){
+                verdict[i] |= STATUSSCAN_LOW;
+            }
+            if( wp->lastmax[i] > mean + std * factor){
+                verdict[i] |= STATUSSCAN_HIGH;
+            }
+        }
+        tp->sumN += sumN;
+        tp->sumx += wp->sumx[i];
+        tp->sumxx += wp->sumxx[i];
+        if( wp->winmin[i] < tp->minx){
+            tp->minx = wp->winmin[i];
+        }
+        if( wp->winmax[i] > tp->maxx){
+            tp->maxx = wp->winmax[i];
+        }
+    }
+}
+
+
+static void bounds_scalar(const struct statusscan_window * wp, const double * lo, const double * hi, size_t from, size_t n,
+                          uint8_t * verdict)
+{
+    size_t i;
+
+    for( i=from; i < n; i++){
+        verdict[i] = (wp->lastmin[i] < lo[i] ? STATUSSCAN_LOW : 0) | (wp->lastmax[i] > hi[i] ? STATUSSCAN_HIGH : 0);
+    }
+}
+
+
+#ifdef STATUSSCAN_X86
+
+/*
+** SSE2: 4 alarm words or 2 doubles per instruction
+*/
+
+__attribute__((target("sse2")))
+static void countalarms_sse2(const uint32_t * alarm, size_t n, unsigned int * counts)
+{
+    __m128i acc[STATUSSCAN_COUNTERS];
+    __m128i bits[STATUSSCAN_BITS];
+    __m128i zero = _mm_setzero_si128();
+    __m128i v, m;
+    uint32_t lanes[4];
+    size_t i;
+    int b, k;
+
+    for( b=0; b < STATUSSCAN_COUNTERS; b++){
+        acc[b] = zero;
+    }
+    for( b=0; b < STATUSSCAN_BITS; b++){
+        bits[b] = _mm_set1_epi32(1 << b);
+    }
+    for( i=0; i + 4 <= n; i += 4){
+        v = _mm_loadu_si128((const __m128i *)(alarm + i));
+        acc[0] = _mm_sub_epi32(acc[0], _mm_cmpeq_epi32(v, zero)); /* counts the zeros */
+        for( b=0; b < STATUSSCAN_BITS; b++){
+            m = _mm_and_si128(v, bits[b]);
+            acc[1+b] = _mm_sub_epi32(acc[1+b], _mm_cmpeq_epi32(m, bits[b]));
+        }
+    }
+    for( b=0; b < STATUSSCAN_COUNTERS; b++){
+        _mm_storeu_si128((__m128i *) lanes, acc[b]);
+        for( k=0; k < 4; k++){
+            counts[b] += lanes[k];
+        }
+    }
+    counts[0] = (unsigned int) i - counts[0]; /* zeros -> alarmed */
+    countalarms_scalar(alarm + i, n - i, counts);
+}
+
+
+__attribute__((target("sse2")))
+static void threshold_sse2(const struct statusscan_window * wp, size_t n, double factor, double minimumcount,
+                           uint8_t * verdict, struct statusscan_total * tp)
+{
+    __m128d vfactor = _mm_set1_pd(factor);
+    __m128d vminimum = _mm_set1_pd(minimumcount);
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d accN = _mm_setzero_pd(), accx = _mm_setzero_pd(), accxx = _mm_setzero_pd();
+    __m128d accmin = _mm_set1_pd(tp->minx), accmax = _mm_set1_pd(tp->maxx);
+    __m128d N, sx, sxx, mean, std, valid, lo, hi;
+    double lanes[2];
+    size_t i;
+    int mlo, mhi;
+
+    for( i=0; i + 2 <= n; i += 2){
+        N = _mm_loadu_pd(wp->sumN + i);
+        sx = _mm_loadu_pd(wp->sumx + i);
+        sxx = _mm_loadu_pd(wp->sumxx + i);
+        mean = _mm_div_pd(sx, N);
+        std = _mm_sqrt_pd(_mm_div_pd(_mm_sub_pd(sxx, _mm_mul_pd(sx, mean)), _mm_sub_pd(N, one)));
+        valid = _mm_cmpgt_pd(N, vminimum);
+        std = _mm_mul_pd(std, vfactor);
+        lo = _mm_and_pd(valid, _mm_cmplt_pd(_mm_loadu_pd(wp->lastmin + i), _mm_sub_pd(mean, std)));
+        hi = _mm_and_pd(valid, _mm_cmpgt_pd(_mm_loadu_pd(wp->lastmax + i), _mm_add_pd(mean, std)));
+        mlo = _mm_movemask_pd(lo);
+        mhi = _mm_movemask_pd(hi);
+        verdict[i]   = (uint8_t)(( mlo       & 1) | (( mhi       & 1) << 1));
+        verdict[i+1] = (uint8_t)(((mlo >> 1) & 1) | (((mhi >> 1) & 1) << 1));
+        accN = _mm_add_pd(accN, N);
+        accx = _mm_add_pd(accx, sx);
+        accxx = _mm_add_pd(accxx, sxx);
+        accmin = _mm_min_pd(accmin, _mm_loadu_pd(wp->winmin + i));
+        accmax = _mm_max_pd(accmax, _mm_loadu_pd(wp->winmax + i));
+    }
+    _mm_storeu_pd(lanes, accN);  tp->sumN += lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, accx);  tp->sumx += lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, accxx); tp->sumxx += lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, accmin);
+    tp->minx = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    _mm_storeu_pd(lanes, accmax);
+    tp->maxx = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    threshold_scalar(wp, i, n, factor, minimumcount, verdict, tp);
+}
+
+
+__attribute__((target("sse2")))
+static void bounds_sse2(const struct statusscan_window * wp, const double * lo, const double * hi, size_t n, uint8_t * verdict)
+{
+    size_t i;
+    int mlo, mhi;
+
+    for( i=0; i + 2 <= n; i += 2){
+        mlo = _mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(wp->lastmin + i), _mm_loadu_pd(lo + i)));
+        mhi = _mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(wp->lastmax + i), _mm_loadu_pd(hi + i)));
+        verdict[i]   = (uint8_t)(( mlo       & 1) | (( mhi       & 1) << 1));
+        verdict[i+1] = (uint8_t)(((mlo >> 1) & 1) | (((mhi >> 1) & 1) << 1));
+    }
+    bounds_scalar(wp, lo, hi, i, n, verdict);
+}
+
+
+/*
+** AVX2: 8 alarm words or 4 doubles per instruction
+*/
+
+__attribute__((target("avx2")))
+static void countalarms_avx2(const uint32_t * alarm, size_t n, unsigned int * counts)
+{
+    __m256i acc[STATUSSCAN_COUNTERS];
+    __m256i bits[STATUSSCAN_BITS];
+    __m256i zero = _mm256_setzero_si256();
+    __m256i v, m;
+    uint32_t lanes[8];
+    size_t i;
+    int b, k;
+
+    for( b=0; b < STATUSSCAN_COUNTERS; b++){
+        acc[b] = zero;
+    }
+    for( b=0; b < STATUSSCAN_BITS; b++){
+        bits[b] = _mm256_set1_epi32(1 << b);
+    }
+    for( i=0; i + 8 <= n; i += 8){
+        v = _mm256_loadu_si256((const __m256i *)(alarm + i));
+        acc[0] = _mm256_sub_epi32(acc[0], _mm256_cmpeq_epi32(v, zero)); /* counts the zeros */
+        for( b=0; b < STATUSSCAN_BITS; b++){
+            m = _mm256_and_si256(v, bits[b]);
+            acc[1+b] = _mm256_sub_epi32(acc[1+b], _mm256_cmpeq_epi32(m, bits[b]));
+        }
+    }
+    for( b=0; b < STATUSSCAN_COUNTERS; b++){
+        _mm256_storeu_si256((__m256i *) lanes, acc[b]);
+        for( k=0; k < 8; k++){
+            counts[b] += lanes[k];
+        }
+    }
+    counts[0] = (unsigned int) i - counts[0]; /* zeros -> alarmed */
+    countalarms_scalar(alarm + i, n - i, counts);
+}
+
+
+__attribute__((target("avx2")))
+static void threshold_avx2(const struct statusscan_window * wp, size_t n, double factor, double minimumcount,
+                           uint8_t * verdict, struct statusscan_total * tp)
+{
+    __m256d vfactor = _mm256_set1_pd(factor);
+    __m256d vminimum = _mm256_set1_pd(minimumcount);
+    __m256d one = _mm256_set1_pd(1.0);
+    __m256d accN = _mm256_setzero_pd(), accx = _mm256_setzero_pd(), accxx = _mm256_setzero_pd();
+    __m256d accmin = _mm256_set1_pd(tp->minx), accmax = _mm256_set1_pd(tp->maxx);
+    __m256d N, sx, sxx, mean, std, valid, lo, hi;
+    double lanes[4];
+    size_t i;
+    int mlo, mhi, k;
+
+    for( i=0; i + 4 <= n; i += 4){
+        N = _mm256_loadu_pd(wp->sumN + i);
+        sx = _mm256_loadu_pd(wp->sumx + i);
+        sxx = _mm256_loadu_pd(wp->sumxx + i);
+        mean = _mm256_div_pd(sx, N);
+        std = _mm256_sqrt_pd(_mm256_div_pd(_mm256_sub_pd(sxx, _mm256_mul_pd(sx, mean)), _mm256_sub_pd(N, one)));
+        valid = _mm256_cmp_pd(N, vminimum, _CMP_GT_OQ);
+        std = _mm256_mul_pd(std, vfactor);
+        lo = _mm256_and_pd(valid, _mm256_cmp_pd(_mm256_loadu_pd(wp->lastmin + i), _mm256_sub_pd(mean, std), _CMP_LT_OQ));
+        hi = _mm256_and_pd(valid, _mm256_cmp_pd(_mm256_loadu_pd(wp->lastmax + i), _mm256_add_pd(mean, std), _CMP_GT_OQ));
+        mlo = _mm256_movemask_pd(lo);
+        mhi = _mm256_movemask_pd(hi);
+        for( k=0; k < 4; k++){
+            verdict[i+k] = (uint8_t)(((mlo >> k) & 1) | (((mhi >> k) & 1) << 1));
+        }
+        accN = _mm256_add_pd(accN, N);
+        accx = _mm256_add_pd(accx, sx);
+        accxx = _mm256_add_pd(accxx, sxx);
+        accmin = _mm256_min_pd(accmin, _mm256_loadu_pd(wp->winmin + i));
+        accmax = _mm256_max_pd(accmax, _mm256_loadu_pd(wp->winmax + i));
+    }
+    _mm256_storeu_pd(lanes, accN);  tp->sumN += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_pd(lanes, accx);  tp->sumx += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_pd(lanes, accxx); tp->sumxx += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_pd(lanes, accmin);
+    for( k=0; k < 4; k++){
+        if( lanes[k] < tp->minx){
+            tp->minx = lanes[k];
+        }
+    }
+    _mm256_storeu_pd(lanes, accmax);
+    for( k=0; k < 4; k++){
+        if( lanes[k] > tp->maxx){
+            tp->maxx = lanes[k];
+        }
+    }
+    threshold_scalar(wp, i, n, factor, minimumcount, verdict, tp);
+}
+
+__attribute__((target("avx2")))
+static void bounds_avx2(const struct statusscan_window * wp, const double * lo, const double * hi, size_t n, uint8_t * verdict)
+{
+    size_t i;
+    int mlo, mhi, k;
+
+    for( i=0; i + 4 <= n; i += 4){
+        mlo = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(wp->lastmin + i), _mm256_loadu_pd(lo + i), _CMP_LT_OQ));
+        mhi = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(wp->lastmax + i), _mm256_loadu_pd(hi + i), _CMP_GT_OQ));
+        for( k=0; k < 4; k++){
+            verdict[i+k] = (uint8_t)(((mlo >> k) & 1) | (((mhi >> k) & 1) << 1));
+        }
+    }
+    bounds_scalar(wp, lo, hi, i, n, verdict);
+}
+
+#endif /* STATUSSCAN_X86 */
+
+
+static void bounds_scalar_all(const struct statusscan_window * wp, const double * lo, const double * hi, size_t n, uint8_t * verdict)
+{
+    bounds_scalar(wp, lo, hi, 0, n, verdict);
+}
+
+
+static void threshold_scalar_all(const struct statusscan_window * wp, size_t n, double factor, double minimumcount,
+                                 uint8_t * verdict, struct statusscan_total * tp)
+{
+    threshold_scalar(wp, 0, n, factor, minimumcount, verdict, tp);
+}
+
+
+static void (*countalarms_impl)(const uint32_t *, size_t, unsigned int *) = &countalarms_scalar;
+static void (*threshold_impl)(const struct statusscan_window *, size_t, double, double, uint8_t *, struct statusscan_total *) = &threshold_scalar_all;
+static void (*bounds_impl)(const struct statusscan_window *, const double *, const double *, size_t, uint8_t *) = &bounds_scalar_all;
+
+
+int statusscan_select(int implementation)
+{
+    switch( implementation){
+        case STATUSSCAN_SCALAR:
+            countalarms_impl = &countalarms_scalar;
+            threshold_impl = &threshold_scalar_all;
+            bounds_impl = &bounds_scalar_all;
+            return 0;
+#ifdef STATUSSCAN_X86
+        case STATUSSCAN_SSE2:
+            if( !__builtin_cpu_supports("sse2")){
+                return -1;
+            }
+            countalarms_impl = &countalarms_sse2;
+            threshold_impl = &threshold_sse2;
+            bounds_impl = &bounds_sse2;
+            return 0;
+        case STATUSSCAN_AVX2:
+            if( !__builtin_cpu_supports("avx2")){
+                return -1;
+            }
+            countalarms_impl = &countalarms_avx2;
+            threshold_impl = &threshold_avx2;
+            bounds_impl = &bounds_avx2;
+            return 0;
+#endif
+        default:
+            return -1;
+    }
+}
+
+
+/* returns the selected implementation */
+int statusscan_init(void)
+{
+#ifdef STATUSSCAN_X86
+    __builtin_cpu_init();
+    if( 0 == statusscan_select(STATUSSCAN_AVX2)){
+        return STATUSSCAN_AVX2;
+    }
+    if( 0 == statusscan_select(STATUSSCAN_SSE2)){
+        return STATUSSCAN_SSE2;
+    }
+#endif
+    statusscan_select(STATUSSCAN_SCALAR);
+    return STATUSSCAN_SCALAR;
+}
+
+
+void statusscan_countalarms(const uint32_t * alarm, size_t n, unsigned int * counts)
+{
+    memset(counts, 0, STATUSSCAN_COUNTERS * sizeof(unsigned int));
+    countalarms_impl(alarm, n, counts);
+}
+
+
+/* tp is initialized here: the sums to 0, min to +inf, max to -inf */
+void statusscan_threshold(const struct statusscan_window * wp, size_t n, double factor, double minimumcount,
+                          uint8_t * verdict, struct statusscan_total * tp)
+{
+    tp->sumN = tp->sumx = tp->sumxx = 0.0;
+    tp->minx = INFINITY;
+    tp->maxx = -INFINITY;
+    threshold_impl(wp, n, factor, minimumcount, verdict, tp);
+}
+
+
+void statusscan_bounds(const struct statusscan_window * wp, const double * lo, const double * hi, size_t n, uint8_t * verdict)
+{
+    bounds_impl(wp, lo, hi, n, verdict);
+}
@@ -0,0 +1,84 @@
+/*
+** statusscan.h
+**
+** vectorized scan kernels over the structure-of-arrays part of the statusdb
+**
+**  The per-client hot fields are stored in contiguous arrays (one array per field),
+**  so one cache line holds the same field of 8-16 clients. The kernels below walk these arrays
+**  with AVX2 or SSE2 instructions if the CPU has them, otherwise with a scalar loop.
+**  All implementations give the same result.
+**
+** NOT multithrad safe in the sense that the arrays may change during the scan. The caller
+** must confirm a positive verdict under the lock of the client.
+**
+**  functions:
+**      - init            select the best implementation for this CPU
+**      - select          force an implementation (for benchmarking). Returns -1 if unsupported.
+**      - countalarms     count the clients with any alarm, and the clients with each alarm bit.
+**      - threshold       the statistical alarm pass: mean +- factor*std check of the last datablock
+**                        for every client, plus the fleet-wide sums, min and max.
+**      - bounds          the same check against precalculated per-client bounds (robust detectors):
+**                        lastmin < lo[i] or lastmax > hi[i]. -inf/+inf bounds never alarm.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __STATUSSCAN_H
+#define __STATUSSCAN_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define STATUSSCAN_SCALAR 0
+#define STATUSSCAN_SSE2 1
+#define STATUSSCAN_AVX2 2
+
+/* countalarms: counts[0] is the number of clients with any alarm bit, counts[1+b] is for bit b */
+#define STATUSSCAN_BITS 8
+#define STATUSSCAN_COUNTERS (STATUSSCAN_BITS + 1)
+
+/* threshold verdict bits */
+#define STATUSSCAN_LOW 1
+#define STATUSSCAN_HIGH 2
+
+/*
+**  the rolling window statistics of every client, one array per field.
+**  an unused or empty client has sumN == 0, winmin == lastmin == +BIG, winmax == lastmax == -BIG
+*/
+struct statusscan_window {
+    double * sumN;     /* number of measurements in the window */
+    double * sumx;
+    double * sumxx;
+    double * winmin;   /* min of the window */
+    double * winmax;   /* max of the window */
+    double * lastmin;  /* min of the latest datablock */
+    double * lastmax;  /* max of the latest datablock */
+};
+
+struct statusscan_total {
+    double sumN, sumx, sumxx, minx, maxx;
+};
+
+
+int statusscan_init(void);
+int statusscan_select(int implementation);
+void statusscan_countalarms(const uint32_t * alarm, size_t n, unsigned int * counts);
+void statusscan_threshold(const struct statusscan_window * wp, size_t n, double factor, double minimumcount,
+                          uint8_t * verdict, struct statusscan_total * tp);
+void statusscan_bounds(const struct statusscan_window * wp, const double * lo, const double * hi, size_t n, uint8_t * verdict);
+
+#endif /* __STATUSSCAN_H */
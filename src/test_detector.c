@@ -0,0 +1,198 @@
+/*
+** test_detector.c
+**
+**  detector functionality testing: the median against a sorted copy (odd, even, duplicated and
+**  constant values), the MAD of a known set, the robustness of the mad bounds against extreme
+**  datablocks, the meanstd bounds, and the drift detector on a creep and on a burst.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "detector.h"
+
+#define MAXN 200
+
+
+static int cmpfloat(const void * a, const void * b)
+{
+    float x = *(const float *) a, y = *(const float *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+
+int main(int argc, char * argv[])
+{
+    float v[MAXN], sorted[MAXN], mins[MAXN], maxs[MAXN];
+    float set[] = { 1.0, 2.0, 3.0, 4.0, 100.0 };
+    double median, mad, lo, hi, lo2, hi2, x;
+    struct drift dr;
+    struct profile pr;
+    int alarmed;
+    size_t n, i;
+    int round;
+    int errors = 0;
+
+    puts("test_detector");
+
+    if( DETECTOR_MEANSTD != detector_parse("meanstd") || DETECTOR_MAD != detector_parse("mad")
+        || -1 != detector_parse("median") || 0 != strcmp("mad", detector_name(DETECTOR_MAD))){
+        puts("Error: detector names");
+        errors ++;
+    }
+
+    /* median == the lower middle of the sorted values */
+    srandom(1);
+    for( round=0; round < 2000; round++){
+        n = 1 + random() % MAXN;
+        for( i=0; i < n; i++){
+            /* few distinct values in every 3rd round: many duplicates */
+            v[i] = (0 == round % 3) ? (float)(random() % 4) : (float)(random() / (double) RAND_MAX * 10.0 - 5.0);
+            if( 0 == round % 7){
+                v[i] = 1.5;  /* constant */
+            }
+        }
+        memcpy(sorted, v, n * sizeof(float));
+        qsort(sorted, n, sizeof(float), cmpfloat);
+        median = detector_median(v, n);
+        if( median != sorted[(n - 1) / 2]){
+            printf("Error: median of %lu values is %f instead of %f (round %d)\n", n, median, sorted[(n - 1) / 2], round);
+            errors ++;
+        }
+        qsort(v, n, sizeof(float), cmpfloat);
+        if( 0 != memcmp(v, sorted, n * sizeof(float))){
+            printf("Error: the values changed, not only reordered (round %d)\n", round);
+            errors ++;
+        }
+        if( errors > 10){
+            return 2;
+        }
+    }
+
+    /* 1 2 3 4 100: median 3, deviations 2 1 0 1 97: MAD 1 */
+    detector_mad(set, 5, &median, &mad);
+    printf("median: %f mad: %f\n", median, mad);
+    if( 3.0 != median || 1.0 != mad){
+        puts("Error: wrong median or MAD");
+        errors ++;
+    }
+
+    /* the mad bounds do not move much if a few datablocks are extreme, the meanstd ones do */
+    for( i=0; i < 60; i++){
+        mins[i] = -1.0 + 0.01 * (i % 10);
+        maxs[i] = 1.0 + 0.01 * (i % 10);
+    }
+    detector_mad_bounds(mins, maxs, 60, 10.0, 0.0, &lo, &hi);
+    for( i=0; i < 60; i++){
+        mins[i] = -1.0 + 0.01 * (i % 10);
+        maxs[i] = (i < 3) ? 9.0 : 1.0 + 0.01 * (i % 10);  /* 3 hanging operations */
+    }
+    detector_mad_bounds(mins, maxs, 60, 10.0, 0.0, &lo2, &hi2);
+    printf("mad bounds: %f %f, with extremes: %f %f\n", lo, hi, lo2, hi2);
+    if( lo != lo2 || fabs(hi - hi2) > 0.2 || hi < 1.09 || hi > 2.0 || lo > -1.0 || lo < -2.0){
+        puts("Error: wrong mad bounds");
+        errors ++;
+    }
+    /* constant window: the minscale keeps the bounds apart */
+    for( i=0; i < 60; i++){
+        mins[i] = maxs[i] = 0.5;
+    }
+    detector_mad_bounds(mins, maxs, 60, 10.0, 0.4, &lo, &hi);
+    if( fabs(lo - (0.5 - 4.0)) > 1e-6 || fabs(hi - (0.5 + 4.0)) > 1e-6){
+        printf("Error: wrong minscale bounds %f %f\n", lo, hi);
+        errors ++;
+    }
+
+    /* 4 measurements 1 2 3 4: mean 2.5, std 1.290994 */
+    if( 0 != detector_meanstd_bounds(4.0, 10.0, 30.0, 2.0, &lo, &hi) || fabs(hi - (2.5 + 2.0 * 1.290994)) > 1e-5
+        || fabs(lo - (2.5 - 2.0 * 1.290994)) > 1e-5 || -1 != detector_meanstd_bounds(1.0, 1.0, 1.0, 2.0, &lo, &hi)){
+        puts("Error: wrong meanstd bounds");
+        errors ++;
+    }
+
+    /* drift: a 3x creep over 600 datablocks is found in 10 minutes, a 10x burst of 5 datablocks is not */
+    for( round=0; round < 3; round++){
+        drift_init(&dr);
+        alarmed = -1;
+        for( i=0; i < 3600; i++){
+            x = 0.5 + 0.1 * (random() / (double) RAND_MAX - 0.5);
+            if( 1 == round && i >= 1000){
+                x += i < 1600 ? log(3.0) * (i - 1000) / 600.0 : log(3.0);  /* creep, then stays */
+            }
+            if( 2 == round && i >= 1000 && i < 1005){
+                x += log(10.0);
+            }
+            if( drift_update(&dr, x, log(2.0)) && -1 == alarmed){
+                alarmed = i;
+            }
+        }
+        printf("drift round %d: alarmed at %d, at the end: %d\n", round, alarmed, dr.alarmed);
+        if( (1 == round) != (-1 != alarmed) || (1 == round && (alarmed < 1300 || alarmed > 1700))){
+            puts("Error: wrong drift alarm");
+            errors ++;
+        }
+    }
+
+    /* profile: uniform 0-1 for an hour, then 2.0 for 3 half-lives: the old hour is less than 10% */
+    profile_init(&pr);
+    for( i=0; i < 3600; i++){
+        /* the whole warmup is PROFILE_NONE, the data processor leaves its bounds alone then */
+        if( (i < PROFILE_WARMUP) != (PROFILE_NONE == profile_quantile(&pr, 0.5))
+            || (i < PROFILE_WARMUP) != (PROFILE_NONE == profile_quantile(&pr, 0.999))){
+            printf("Error: immature profile %s at datablock %zu\n", i < PROFILE_WARMUP ? "used" : "kept", i);
+            errors ++;
+            break;
+        }
+        profile_add(&pr, (i % 100) / 100.0);
+    }
+    lo = profile_quantile(&pr, 0.5);
+    hi = profile_quantile(&pr, 0.9);
+    for( i=0; i < 3 * PROFILE_HALFLIFE; i++){
+        profile_add(&pr, 2.0);
+    }
+    lo2 = profile_quantile(&pr, 0.05);
+    hi2 = profile_quantile(&pr, 0.5);
+    printf("profile: p50 %f p90 %f, later p5 %f p50 %f\n", lo, hi, lo2, hi2);
+    if( fabs(lo - 0.5) > PROFILE_BINWIDTH || fabs(hi - 0.9) > PROFILE_BINWIDTH || lo2 > 1.0 || hi2 < 2.0 || hi2 > 2.0 + PROFILE_BINWIDTH){
+        puts("Error: wrong profile quantiles");
+        errors ++;
+    }
+    /* more than 100 hours: rescaled, the out of range values in the end bins */
+    for( i=0; i < 400000; i++){
+        profile_add(&pr, (i % 2) ? 100.0 : -100.0);
+    }
+    lo = profile_quantile(&pr, 0.25);
+    hi = profile_quantile(&pr, 0.75);
+    printf("profile after rescale: p25 %f p75 %f weight %g total %g\n", lo, hi, pr.weight, pr.total);
+    if( pr.weight > 1e30 || !isfinite(pr.total) || lo > PROFILE_LOW + PROFILE_BINWIDTH
+        || hi < PROFILE_LOW + (PROFILE_BINS - 1) * PROFILE_BINWIDTH || hi > PROFILE_LOW + PROFILE_BINS * PROFILE_BINWIDTH){
+        puts("Error: wrong profile after rescale");
+        errors ++;
+    }
+
+    if( errors){
+        return 2;
+    }
+    printf("Last line\n");
+    return 0;
+}
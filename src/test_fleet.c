@@ -0,0 +1,137 @@
+/*
+** test_fleet.c
+**
+**  fleet functionality testing: the sketch quantiles against the exact ones, the merge,
+**  and the top-K against sorting, with duplicates and fewer values than K.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fleet.h"
+
+#define MAXN 10000
+
+
+static int cmpdouble(const void * a, const void * b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+
+int main(int argc, char * argv[])
+{
+    static double v[MAXN], sorted[MAXN];
+    struct fleet_sketch whole, half1, half2;
+    struct fleet_topk top;
+    struct fleet_topk_entry out[FLEET_TOPK_MAX];
+    double q[] = { 0.5, 0.9, 0.99 };
+    double approx;
+    int n, i, j, k, round, below, above;
+    int errors = 0;
+
+    puts("test_fleet");
+
+    srandom(1);
+    for( round=0; round < 100; round++){
+        n = 1 + random() % MAXN;
+        fleet_sketch_init(&whole);
+        fleet_sketch_init(&half1);
+        fleet_sketch_init(&half2);
+        for( i=0; i < n; i++){
+            /* lognormal latencies around 1-7 ms, some clients far slower */
+            v[i] = random() / (double) RAND_MAX * 2.0 + ((0 == random() % 50) ? 3.0 : 0.0);
+            fleet_sketch_add(&whole, v[i]);
+            fleet_sketch_add(i % 2 ? &half1 : &half2, v[i]);
+        }
+        fleet_sketch_merge(&half1, &half2);
+        if( 0 != memcmp(&half1, &whole, sizeof(whole))){
+            printf("Error: the merged sketch differs (round %d)\n", round);
+            errors ++;
+        }
+        memcpy(sorted, v, n * sizeof(double));
+        qsort(sorted, n, sizeof(double), cmpdouble);
+        for( j=0; j < 3; j++){
+            approx = fleet_sketch_quantile(&whole, q[j]);
+            /* the exact rank is between the ranks one bin below and above */
+            below = above = 0;
+            for( i=0; i < n; i++){
+                below += sorted[i] < approx - FLEET_BINWIDTH;
+                above += sorted[i] <= approx + FLEET_BINWIDTH;
+            }
+            if( below > q[j] * n || above < q[j] * n){
+                printf("Error: quantile %f of %d values is %f, ranks %d-%d (round %d)\n", q[j], n, approx, below, above, round);
+                errors ++;
+            }
+        }
+
+        /* top-K of the same values, some duplicates */
+        k = 1 + round % FLEET_TOPK_MAX;
+        fleet_topk_init(&top, k);
+        for( i=0; i < n; i++){
+            fleet_topk_offer(&top, i, (0 == i % 3) ? floor(v[i]) : v[i]);
+            sorted[i] = (0 == i % 3) ? floor(v[i]) : v[i];
+        }
+        fleet_topk_offer(&top, -1, NAN);
+        qsort(sorted, n, sizeof(double), cmpdouble);
+        if( fleet_topk_sorted(&top, out) != (n < k ? n : k)){
+            printf("Error: top-%d of %d values has %d entries (round %d)\n", k, n, top.n, round);
+            errors ++;
+        }
+        for( i=0; i < top.n; i++){
+            if( out[i].score != sorted[n - 1 - i] || out[i].id < 0 || out[i].id >= n
+                || out[i].score != ((0 == out[i].id % 3) ? floor(v[out[i].id]) : v[out[i].id])){
+                printf("Error: top-%d entry %d is %d:%f instead of %f (round %d)\n", k, i, out[i].id, out[i].score, sorted[n - 1 - i], round);
+                errors ++;
+                break;
+            }
+        }
+        if( errors > 10){
+            return 2;
+        }
+    }
+
+    /* empty, and out of range values in the end bins */
+    fleet_sketch_init(&whole);
+    if( 0.0 != fleet_sketch_quantile(&whole, 0.5)){
+        puts("Error: the quantile of an empty sketch");
+        errors ++;
+    }
+    fleet_sketch_add(&whole, -100.0);
+    fleet_sketch_add(&whole, 100.0);
+    fleet_sketch_add(&whole, NAN);
+    approx = fleet_sketch_quantile(&whole, 1.0);
+    printf("out of range: p0 %f p100 %f\n", fleet_sketch_quantile(&whole, 0.0), approx);
+    if( fleet_sketch_quantile(&whole, 0.0) != FLEET_LOW || approx < FLEET_LOW + (FLEET_BINS - 1) * FLEET_BINWIDTH
+        || approx > FLEET_LOW + FLEET_BINS * FLEET_BINWIDTH + 1e-9){
+        puts("Error: wrong out of range quantiles");
+        errors ++;
+    }
+
+    if( errors){
+        return 2;
+    }
+    printf("Last line\n");
+    return 0;
+}
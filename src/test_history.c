@@ -0,0 +1,239 @@
+/*
+** test_history.c
+**
+**  history functionality testing: interleaved clients with gaps, clock steps and empty seconds
+**  decoded back from the chunks, the recycling of a small pool, the time range of find, the chain
+**  of a readded client and the chains followed in batches, the heads of many short lived keys,
+**  and the compressed size of latency like values.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "history.h"
+
+#define CLIENTS 3
+#define SAMPLES 100000
+#define MAXCHUNKS 100000
+
+static struct history_sample input[CLIENTS][SAMPLES];
+static struct history_sample output[SAMPLES + HISTORY_CHUNK_SAMPLES];
+static uint64_t epochs[MAXCHUNKS];
+
+
+static double gauss(void)
+{
+    return sqrt(-2.0 * log((random() + 1.0) / (RAND_MAX + 2.0))) * cos(2.0 * M_PI * random() / RAND_MAX);
+}
+
+
+/* a datablock of 10 measurements like ln(ms) of a healthy disk, sometimes an empty one */
+static void sample(struct history_sample * sp, uint32_t time)
+{
+    double x, min = 1e9, max = -1e9, sum = 0.0;
+    int i;
+
+    sp->time = time;
+    if( 0 == random() % 500){
+        sp->value[0] = sp->value[1] = sp->value[2] = NAN;
+        return;
+    }
+    for( i=0; i < 10; i++){
+        x = 0.3 * gauss() - 1.0;
+        min = x < min ? x : min;
+        max = x > max ? x : max;
+        sum += x;
+    }
+    sp->value[0] = min;
+    sp->value[1] = max;
+    sp->value[2] = sum / 10;
+}
+
+
+/* the samples of key from..to, oldest first, into output. The chain is followed 7 chunks at a time. Returns their number */
+static int readback(const struct history * hp, uint64_t key, uint32_t from, uint32_t to)
+{
+    struct history_sample chunk[HISTORY_CHUNK_SAMPLES];
+    uint64_t cursor = 0;
+    size_t nchunks = 0, c;
+    int n = 0, m, i;
+
+    do {
+        nchunks += history_find(hp, key, &cursor, from, to, epochs + nchunks, 7);
+    } while( 0 != cursor && nchunks + 7 <= MAXCHUNKS);
+    for( c=nchunks; c > 0; c--){
+        m = history_decode(hp->chunks + HISTORY_INDEX(hp, epochs[c - 1]), chunk);
+        for( i=0; i < m; i++){
+            if( chunk[i].time >= from && chunk[i].time <= to){
+                output[n ++] = chunk[i];
+            }
+        }
+    }
+    return n;
+}
+
+
+/* the same as the input within the rounding of the mantissa */
+static int compare(const struct history_sample * in, const struct history_sample * out, int n, const char * what)
+{
+    int i, v;
+
+    for( i=0; i < n; i++){
+        if( in[i].time != out[i].time){
+            printf("Error: %s sample %d: time %u instead of %u\n", what, i, out[i].time, in[i].time);
+            return 1;
+        }
+        for( v=0; v < HISTORY_VALUES; v++){
+            if( isnan(in[i].value[v]) ? !isnan(out[i].value[v])
+                : fabsf(out[i].value[v] - in[i].value[v]) > fabsf(in[i].value[v]) / (2 << HISTORY_MANTISSA_BITS)){
+                printf("Error: %s sample %d value %d: %g instead of %g\n", what, i, v, out[i].value[v], in[i].value[v]);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+
+int main(int argc, char * argv[])
+{
+    struct history h;
+    struct history_writer w[CLIENTS];
+    uint32_t time[CLIENTS];
+    size_t bits = 0, c;
+    int n, i, k, first;
+    int errors = 0;
+
+    puts("test_history");
+    srandom(1);
+
+    /* interleaved clients in a pool large enough for all */
+    if( 0 != history_init(&h, (size_t) 64 * 1024 * 1024)){
+        puts("Error: cannot init");
+        return 2;
+    }
+    for( k=0; k < CLIENTS; k++){
+        history_writer_init(w + k, 1000 + k);
+        time[k] = 1700000000 + k;
+    }
+    for( i=0; i < SAMPLES; i++){
+        for( k=0; k < CLIENTS; k++){
+            if( 0 == random() % 1000){
+                time[k] += random() % 5000;     /* the agent was stopped */
+            } else if( 0 == random() % 20000){
+                time[k] -= random() % 100 + 1;  /* the clock of the agent stepped back */
+            }
+            time[k] ++;
+            if( 2 == k && SAMPLES / 2 == i){
+                history_writer_init(w + k, 1000 + k); /* forgotten and readded: the chain goes on */
+            }
+            sample(input[k] + i, time[k]);
+            history_add(&h, w + k, time[k], input[k][i].value);
+        }
+    }
+    for( k=0; k < CLIENTS; k++){
+        n = readback(&h, 1000 + k, 0, UINT32_MAX);
+        if( SAMPLES != n){
+            printf("Error: client %d: %d samples instead of %d\n", k, n, SAMPLES);
+            errors ++;
+        } else {
+            errors += compare(input[k], output, n, "all");
+        }
+    }
+    for( c=0; c < h.epoch; c++){
+        bits += h.chunks[c].nbits;
+    }
+    printf("%lu chunks, %.1f bits per sample in the chunks, %.1f with the headers\n", h.epoch,
+        (double) bits / (CLIENTS * SAMPLES), (double) h.epoch * HISTORY_CHUNK_SIZE * 8 / (CLIENTS * SAMPLES));
+
+    /* a time range in the middle: no time step there */
+    for( first = SAMPLES / 2; input[1][first + 1000].time - input[1][first].time != 1000; first ++){
+        ;
+    }
+    n = readback(&h, 1001, input[1][first].time, input[1][first + 1000].time);
+    if( 1001 != n){
+        printf("Error: range: %d samples instead of 1001\n", n);
+        errors ++;
+    } else {
+        errors += compare(input[1] + first, output, n, "range");
+    }
+    if( 0 != readback(&h, 999, 0, UINT32_MAX)){
+        puts("Error: samples of an unknown key");
+        errors ++;
+    }
+    free(h.chunks);
+    free(h.heads);
+
+    /* a small pool: only the newest samples of the clients remain, without holes */
+    if( 0 != history_init(&h, 20 * sizeof(struct history_chunk))){
+        puts("Error: cannot init the small pool");
+        return 2;
+    }
+    for( k=0; k < 2; k++){
+        history_writer_init(w + k, 1000 + k);
+    }
+    for( i=0; i < SAMPLES; i++){
+        for( k=0; k < 2; k++){
+            input[k][i].time = 1700000000 + i;
+            sample(input[k] + i, input[k][i].time);
+            history_add(&h, w + k, input[k][i].time, input[k][i].value);
+        }
+    }
+    for( k=0; k < 2; k++){
+        n = readback(&h, 1000 + k, 0, UINT32_MAX);
+        if( n < 5 * 40 || n > 10 * HISTORY_CHUNK_SAMPLES){
+            printf("Error: small pool client %d: %d samples\n", k, n);
+            errors ++;
+        } else {
+            errors += compare(input[k] + SAMPLES - n, output, n, "small pool");
+        }
+    }
+
+    /* a key for every chunk: the heads of the recycled keys are removed, the table never fills up */
+    for( i=0; i < SAMPLES; i++){
+        history_writer_init(w, 5000 + i);
+        history_add(&h, w, 1700000000 + i, input[0][i].value);
+    }
+    for( i=0; i < SAMPLES; i++){
+        n = readback(&h, 5000 + i, 0, UINT32_MAX);
+        if( (i >= SAMPLES - (int) h.n) != (1 == n)){
+            printf("Error: key per chunk %d: %d samples\n", i, n);
+            errors ++;
+            break;
+        }
+    }
+    for( c=0, n=0; c <= h.mask; c++){
+        n += 0 != h.heads[c].key;
+    }
+    if( n != (int) h.n){
+        printf("Error: %d heads for %lu chunks\n", n, h.n);
+        errors ++;
+    }
+    free(h.chunks);
+    free(h.heads);
+
+    if( errors){
+        return 2;
+    }
+    printf("Last line\n");
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+** test_logring.c
+**
+**  logring functionality testing: concurrent producers and the writer thread into a file,
+**  then every written line is read back and checked.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "logring.h"
+
+static struct logring lr;
+static int outfd;
+static unsigned long lines;  /* per producer */
+
+
+void * producer(void * arg)
+{
+    long thread = (long) arg;
+    unsigned long i;
+
+    for( i=0; i < lines; i++){
+        logring_printf(&lr, outfd, "thread %ld line %lu check %lu\n", thread, i, i * 7 + thread);
+    }
+    return NULL;
+}
+
+
+/* wait for the writer thread */
+void drain(unsigned long total)
+{
+    while( __atomic_load_n(&(lr.written), __ATOMIC_ACQUIRE) + __atomic_load_n(&(lr.dropped), __ATOMIC_ACQUIRE) < total){
+        nanosleep(&(struct timespec){0, 1000000}, NULL);
+    }
+}
+
+
+int main(int argc, char * argv[])
+{
+    int producers;
+    long t;
+    size_t capacity;
+    pthread_t writer;
+    pthread_t * threads;
+    long * last;  /* last line number per producer */
+    FILE * fp;
+    char line[LOGRING_TEXTLEN + 1];
+    char longline[2 * LOGRING_TEXTLEN];
+    long thread;
+    unsigned long number, check, total;
+    unsigned long readback = 0;
+    int errors = 0;
+
+    if( argc != 4){
+        puts("Incorrect number of parameters. Usage:");
+        puts("  test_logring  <capacity> <producer_threads> <lines_per_thread>");
+        return 2;
+    }
+    capacity = atol(argv[1]);
+    producers = atoi(argv[2]);
+    lines = atol(argv[3]);
+    total = producers * lines;
+
+    printf("test_logring %lu %d %lu\n", capacity, producers, lines);
+    if( 0 == logring_init(&lr, capacity + 1)){
+        puts("Error: init accepted a capacity that is not a power of 2");
+        return 2;
+    }
+    printf("init returns: %d\n", logring_init(&lr, capacity));
+    fp = tmpfile();
+    outfd = fileno(fp);
+
+    threads = (pthread_t *) malloc(producers * sizeof(pthread_t));
+    last = (long *) malloc(producers * sizeof(long));
+    pthread_create(&writer, NULL, &logring_writer_loop, &lr);
+    for( t=0; t < producers; t++){
+        last[t] = -1;
+        pthread_create(threads + t, NULL, &producer, (void *) t);
+    }
+    for( t=0; t < producers; t++){
+        pthread_join(threads[t], NULL);
+    }
+    drain(total);
+    /* a too long one, into the empty ring */
+    memset(longline, 'x', sizeof(longline) - 1);
+    longline[sizeof(longline) - 1] = '\0';
+    logring_printf(&lr, outfd, "%s\n", longline);
+    total ++;
+    drain(total);
+    printf("written: %lu dropped: %lu truncated: %lu\n", lr.written, lr.dropped, lr.truncated);
+    if( lr.written + lr.dropped != total || lr.truncated != 1){
+        puts("Error: counters mismatch");
+        return 2;
+    }
+
+    /* every line must be whole, and the lines of a producer must be in order */
+    rewind(fp);
+    while( NULL != fgets(line, sizeof(line), fp)){
+        readback ++;
+        if( 'x' == line[0]){
+            if( strlen(line) != LOGRING_TEXTLEN - 1 || '\n' != line[LOGRING_TEXTLEN - 2]){
+                printf("Error: bad truncated line, length %lu\n", strlen(line));
+                errors ++;
+            }
+            continue;
+        }
+        if( 3 != sscanf(line, "thread %ld line %lu check %lu", &thread, &number, &check)
+            || thread < 0 || thread >= producers || check != number * 7 + thread){
+            printf("Error: corrupted line: %s", line);
+            errors ++;
+        } else if( (long) number <= last[thread]){
+            printf("Error: out of order line: %s", line);
+            errors ++;
+        } else {
+            last[thread] = number;
+        }
+        if( errors > 10){
+            return 2;
+        }
+    }
+    if( readback != lr.written){
+        printf("Error: %lu lines in the file, %lu written\n", readback, lr.written);
+        errors ++;
+    }
+    if( errors){
+        return 2;
+    }
+    printf("Last line\n");
+    return 0;
+}
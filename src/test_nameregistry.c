@@ -1,7 +1,7 @@
 /*
 ** test_nameregistry.c
 **
-**  nameregistry functionality testing
+**  nameregistry functionality testing: add, find, grow, churn, and the readers of a held seqlock
 **
 ** Copyright by Adam Maulis maulis@andrews.hu 2025
 
@@ -55,7 +55,7 @@ int main(int argc, char * argv[])
     name = (char *) malloc(namelen);
 
     printf("test_nameregistry %lu %lu\n", size, namelen);
-    retval = nameregistry_init(&nr, size, namelen);
+    retval = nameregistry_init_growable(&nr, size, size * 2, namelen);
     printf("init returns: %d\n", retval);
     i = 0;
     while((nr.used < nr.size) && (i < size * 60)){
@@ -84,6 +84,29 @@ int main(int argc, char * argv[])
         }
     }
 
+    /* growing: the old IDs remain, the new ones can be added */
+    retval = nameregistry_getbyid(&nr, size - 1, name);
+    if( -1 == retval || 0 != nameregistry_grow(&nr, size + size / 2 + 1)){
+        printf("Error: cannot grow the registry\n");
+        return 2;
+    }
+    if( (int)(size - 1) != nameregistry_find(&nr, name)){
+        printf("Error: ID changed after growing\n");
+        return 2;
+    }
+    while( nr.used < nr.size){
+        randomstring(name, namelen);
+        if( -1 == nameregistry_findadd(&nr, name)){
+            printf("Error: cannot add after growing. size=%lu used=%lu\n", nr.size, nr.used);
+            return 2;
+        }
+    }
+    if( -1 != nameregistry_grow(&nr, size * 2 + 1)){
+        printf("Error: grown over maxsize\n");
+        return 2;
+    }
+    size = nr.size;
+
     for(i=0; i < size * 60; i++){
         retval = nameregistry_getbyid(&nr, random() % size, name);
         if( 0 == memcmp(name, ".........................................", namelen<40?namelen:40) ){
@@ -111,6 +134,30 @@ int main(int argc, char * argv[])
         }
     }/* end for i */
 
+    /* the hash index must be consistent after the churn */
+    for(i=0; i < nr.used; i++){
+        nameregistry_getbyid(&nr, nr.freelist[i], name);
+        if( (int) nr.freelist[i] != nameregistry_find(&nr, name) || 1 != nameregistry_check(&nr, nr.freelist[i], name)){
+            printf("Error: ID=%lu is not found by its name after churn\n", nr.freelist[i]);
+            return 2;
+        }
+    }
+    /* a writer stopped in its write section (preempted): the readers do not spin, they go to the mutex */
+    nameregistry_getbyid(&nr, nr.freelist[0], name);
+    __atomic_add_fetch(&(nr.seq), 1, __ATOMIC_RELEASE);
+    if( (int) nr.freelist[0] != nameregistry_find(&nr, name) || 1 != nameregistry_check(&nr, nr.freelist[0], name)){
+        printf("Error: not found while the seqlock is held\n");
+        return 2;
+    }
+    __atomic_add_fetch(&(nr.seq), 1, __ATOMIC_RELEASE);
+
+    retval = nameregistry_getbyid(&nr, nr.freelist[0], name);
+    nameregistry_removebyid(&nr, retval);
+    if( 0 != nameregistry_check(&nr, retval, name) || -1 != nameregistry_find(&nr, name)){
+        printf("Error: removed name is still found. ID=%d\n", retval);
+        return 2;
+    }
+
     printf("Last line\n");
     return 0;
 
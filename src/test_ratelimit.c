@@ -0,0 +1,145 @@
+/*
+** test_ratelimit.c
+**
+**  ratelimit functionality testing: bursts, the steady rate, the unlimited limit,
+**  a flooding source next to well-behaving ones in a sourcelimit table, and a shared bucket
+**  that passes the same packets as a token bucket.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ratelimit.h"
+
+#define TICKS 10  /* per second, like the data processor */
+
+
+/* passed packets of count tries at the same tick */
+static int take_many(const struct ratelimit * rlp, struct tokenbucket * tbp, uint64_t now, int count)
+{
+    int passed = 0;
+
+    while( count-- > 0){
+        passed += ratelimit_take(rlp, tbp, now);
+    }
+    return passed;
+}
+
+
+int main(int argc, char * argv[])
+{
+    struct ratelimit limit;
+    struct tokenbucket bucket;
+    struct sharedbucket shared;
+    struct sourcelimit sl;
+    uint64_t now = 1000000;
+    uint32_t good, flooder;
+    int passed, goodpassed, i, t;
+    int errors = 0;
+
+    puts("test_ratelimit");
+
+    /* a zeroed bucket is full: burst, then nothing */
+    ratelimit_init(&limit, 5, 10, TICKS);
+    memset(&bucket, 0, sizeof(bucket));
+    passed = take_many(&limit, &bucket, now, 15);
+    printf("burst: %d of 15\n", passed);
+    if( 10 != passed){
+        errors ++;
+    }
+    /* 1 sec later 5 tokens, 0.1 sec later the half of a token: nothing */
+    if( 5 != take_many(&limit, &bucket, now + TICKS, 8) || 0 != take_many(&limit, &bucket, now + TICKS + 1, 1)){
+        puts("Error: refill");
+        errors ++;
+    }
+    /* steady 1 try per tick (10/s) for 100 sec: 5/s passes, no rounding loss */
+    now += 2 * TICKS;
+    ratelimit_fill(&limit, &bucket, now);
+    take_many(&limit, &bucket, now, 10);
+    passed = 0;
+    for( t=1; t <= 100 * TICKS; t++){
+        passed += ratelimit_take(&limit, &bucket, now + t);
+    }
+    printf("steady: %d of %d\n", passed, 100 * TICKS);
+    if( 500 != passed){
+        errors ++;
+    }
+    /* a long idle time does not overflow, the bucket is full again */
+    if( 10 != take_many(&limit, &bucket, now + 1000000000000ULL, 20)){
+        puts("Error: after idle");
+        errors ++;
+    }
+    /* unlimited */
+    ratelimit_init(&limit, 0, 1, TICKS);
+    if( 1000 != take_many(&limit, &bucket, now, 1000)){
+        puts("Error: unlimited");
+        errors ++;
+    }
+
+    /* a source flooding 1000/s next to 100 sources sending 1/s, limit 20/s */
+    if( 0 == sourcelimit_init(&sl, 1000, 20, 40, TICKS)){
+        puts("Error: init accepted a size that is not a power of 2");
+        errors ++;
+    }
+    if( 0 != sourcelimit_init(&sl, 4096, 20, 40, TICKS)){
+        puts("Error: init");
+        return 2;
+    }
+    flooder = 0x0a0000fe;
+    passed = goodpassed = 0;
+    for( t=0; t < 60 * TICKS; t++){
+        for( i=0; i < 100; i++){
+            passed += sourcelimit_take(&sl, flooder, now + t);
+        }
+        if( 0 == t % TICKS){
+            for( good = 0x0a000001; good <= 0x0a000064; good++){
+                goodpassed += sourcelimit_take(&sl, good, now + t);
+            }
+        }
+    }
+    printf("flooder: %d of %d, good sources: %d of %d\n", passed, 60 * TICKS * 100, goodpassed, 60 * 100);
+    if( passed != 40 + (60 * TICKS - 1) * 20 / TICKS || goodpassed < 60 * 100 - 60){ /* a good one may share the bucket of the flooder */
+        errors ++;
+    }
+
+    /* a shared bucket: the same decisions as a token bucket, tries at random ticks */
+    ratelimit_init(&limit, 5, 10, TICKS);
+    memset(&bucket, 0, sizeof(bucket));
+    memset(&shared, 0, sizeof(shared));
+    passed = goodpassed = 0;
+    for( t=0, i=0; i < 10000; i++){
+        t += random() % 4;
+        passed += ratelimit_take(&limit, &bucket, now + t);
+        goodpassed += ratelimit_take_shared(&limit, &shared, now + t);
+        if( passed != goodpassed){
+            printf("Error: shared bucket: %d passed instead of %d at try %d\n", goodpassed, passed, i);
+            errors ++;
+            break;
+        }
+    }
+    printf("shared: %d of 10000\n", goodpassed);
+
+    if( errors){
+        return 2;
+    }
+    printf("Last line\n");
+    return 0;
+}
@@ -0,0 +1,160 @@
+/*
+** test_rules.c
+**
+**  rules functionality testing: a rules file with comments and partial settings, the defaults
+**  of the missing settings, the lowest thresholds, the first match of the zero padded names,
+**  and the line numbers of the wrong files.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "rules.h"
+
+#define FILENAME "test_rules.tmp"
+
+static const struct rules_profile defaults = { 3.0, 10.0, 10, 60 };
+
+
+/* the content into FILENAME, then the result of rules_read */
+static int readfile(struct rules * rp, const char * content)
+{
+    FILE * fp;
+
+    fp = fopen(FILENAME, "w");
+    if( NULL == fp){
+        return -2;
+    }
+    fputs(content, fp);
+    fclose(fp);
+    rules_init(rp, &defaults);
+    return rules_read(rp, FILENAME);
+}
+
+
+/* the profile of the zero padded names like a msgview */
+static int match(const struct rules * rp, const char * hostname, const char * text)
+{
+    char h[RULES_PREFIX_LEN];
+    char t[RULES_PREFIX_LEN];
+
+    memset(h, 0, sizeof(h));
+    memset(t, 0, sizeof(t));
+    strncpy(h, hostname, sizeof(h));
+    strncpy(t, text, sizeof(t));
+    return rules_match(rp, h, t);
+}
+
+
+int main(int argc, char * argv[])
+{
+    static const char * wrongs[] = {
+        "# fine\nhost db\nfile x\n",                                   /* unknown field */
+        "text\n",                                                      /* no prefix */
+        "\n\nhost db latencythresholdfactor=0\n",                      /* not positive */
+        "host db madthresholdfactor=x\n",                              /* not a number */
+        "host db\nhost web minimummeasurementcount=2.5\n",             /* not an integer */
+        "host db rollingwindow=61\n",                                  /* longer than the default */
+        "host db rollingwindow=7 minimummeasurementcount=5\n",         /* too short */
+        "host db rollingwindow=10 minimummeasurementcount=82\n",       /* never enough measurements */
+        "host db speed=1\n",                                           /* unknown setting */
+        "host db latencythresholdfactor\n",                            /* no value */
+        "host 12345678901234567890123456789012345678901234567890123456789012345\n", /* long prefix */
+    };
+    static const int wronglines[] = { 3, 1, 3, 1, 2, 1, 1, 1, 1, 1, 1 };
+    struct rules r;
+    char content[RULES_MAX * 20];
+    int i, retval;
+    int errors = 0;
+
+    puts("test_rules");
+
+    /* without a file only the defaults */
+    rules_init(&r, &defaults);
+    if( 1 != r.n || 0 != match(&r, "db01", "/data")){
+        puts("Error: defaults");
+        errors ++;
+    }
+    if( -1 != rules_read(&r, "/nonexistent/rules")){
+        puts("Error: a missing file is read");
+        errors ++;
+    }
+
+    retval = readfile(&r,
+        "# the database servers are more sensitive\n"
+        "\n"
+        "host db latencythresholdfactor=2 minimummeasurementcount=5\n"
+        "   text /scratch  madthresholdfactor=20 rollingwindow=30\t\n"
+        "host db-archive latencythresholdfactor=6\n"   /* never matches: the db rule is the first */
+        "host 0123456789012345678901234567890123456789012345678901234567890123 rollingwindow=8 minimummeasurementcount=63\n"
+        "# trailing comment\n");
+    if( 0 != retval || 5 != r.n){
+        printf("Error: read %d with %d profiles\n", retval, r.n);
+        return 2;
+    }
+    if( 2.0 != r.profile[1].latencythresholdfactor || 10.0 != r.profile[1].madthresholdfactor
+        || 5 != r.profile[1].minimummeasurementcount || 60 != r.profile[1].rollingwindow
+        || 3.0 != r.profile[2].latencythresholdfactor || 20.0 != r.profile[2].madthresholdfactor
+        || 10 != r.profile[2].minimummeasurementcount || 30 != r.profile[2].rollingwindow
+        || 8 != r.profile[4].rollingwindow){
+        puts("Error: settings of the profiles");
+        errors ++;
+    }
+    if( 2.0 != r.min.latencythresholdfactor || 5 != r.min.minimummeasurementcount){
+        printf("Error: min %g %d\n", r.min.latencythresholdfactor, r.min.minimummeasurementcount);
+        errors ++;
+    }
+    if( 1 != match(&r, "db01", "/data") || 1 != match(&r, "db-archive", "/scratch")
+        || 2 != match(&r, "web01", "/scratch/tmp") || 0 != match(&r, "web01", "/data")
+        || 0 != match(&r, "d", "/scr") || 0 != match(&r, "", "")
+        || 4 != match(&r, "0123456789012345678901234567890123456789012345678901234567890123", "")){
+        puts("Error: match");
+        errors ++;
+    }
+
+    /* the wrong files */
+    for( i=0; i < sizeof(wrongs) / sizeof(wrongs[0]); i++){
+        retval = readfile(&r, wrongs[i]);
+        if( wronglines[i] != retval){
+            printf("Error: wrong file %d: %d instead of line %d\n", i, retval, wronglines[i]);
+            errors ++;
+        }
+    }
+
+    /* too many rules */
+    content[0] = '\0';
+    for( i=0; i < RULES_MAX; i++){
+        sprintf(content + strlen(content), "host h%02d-\n", i);
+    }
+    retval = readfile(&r, content);
+    if( RULES_MAX != retval || RULES_MAX != r.n || RULES_MAX - 1 != match(&r, "h62-x", "")){
+        printf("Error: too many rules: %d, %d profiles\n", retval, r.n);
+        errors ++;
+    }
+    unlink(FILENAME);
+
+    if( errors){
+        return 2;
+    }
+    printf("Last line\n");
+    return 0;
+}
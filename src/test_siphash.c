@@ -0,0 +1,98 @@
+/*
+** test_siphash.c
+**
+**  SipHash-2-4 testing with the test vectors of the reference implementation
+**  (key 00 01 .. 0f, message 00 01 .. len-1), and the key file reading.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "siphash.h"
+
+static const struct {
+    size_t len;
+    uint64_t mac;
+} vectors[] = {
+    { 0, 0x726fdb47dd0e0e31ULL},
+    { 1, 0x74f839c593dc67fdULL},
+    { 7, 0xab0200f58b01d137ULL},
+    { 8, 0x93f5f5799a932462ULL},
+    { 15, 0xa129ca6149be45e5ULL},
+    { 63, 0x958a324ceb064572ULL},
+};
+
+
+int main(int argc, char * argv[])
+{
+    uint8_t key[SIPHASH_KEY_LEN];
+    uint8_t readkey[SIPHASH_KEY_LEN];
+    uint8_t message[64];
+    char filename[] = "/tmp/test_siphash.XXXXXX";
+    uint64_t mac;
+    int i;
+    int fd;
+    int errors = 0;
+
+    puts("test_siphash");
+    for( i=0; i < SIPHASH_KEY_LEN; i++){
+        key[i] = i;
+    }
+    for( i=0; i < sizeof(message); i++){
+        message[i] = i;
+    }
+    for( i=0; i < sizeof(vectors) / sizeof(vectors[0]); i++){
+        mac = siphash24(message, vectors[i].len, key);
+        if( mac != vectors[i].mac){
+            printf("Error: len=%lu mac=%016lx expected=%016lx\n", vectors[i].len, mac, vectors[i].mac);
+            errors ++;
+        }
+    }
+
+    /* the key file: 32 hex digits, a newline, anything */
+    fd = mkstemp(filename);
+    dprintf(fd, "000102030405060708090a0B0c0d0e0F\nignored\n");
+    close(fd);
+    if( 0 != siphash_readkey(filename, readkey) || 0 != memcmp(key, readkey, SIPHASH_KEY_LEN)){
+        puts("Error: key file read");
+        errors ++;
+    }
+    fd = open(filename, O_WRONLY | O_TRUNC);
+    dprintf(fd, "0001020304\n");
+    close(fd);
+    if( 0 == siphash_readkey(filename, readkey)){
+        puts("Error: short key file accepted");
+        errors ++;
+    }
+    unlink(filename);
+    if( 0 == siphash_readkey(filename, readkey)){
+        puts("Error: missing key file accepted");
+        errors ++;
+    }
+
+    if( errors){
+        return 2;
+    }
+    printf("Last line\n");
+    return 0;
+}
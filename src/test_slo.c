@@ -0,0 +1,110 @@
+/*
+** test_slo.c
+**
+**  slo functionality testing: the sums of the rings against a recount of all the seconds,
+**  with gaps, late seconds, a restart of the minutes long after, and a full minute.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slo.h"
+
+#define MAXSECONDS 400000
+
+static uint32_t minutes[MAXSECONDS];
+static char bads[MAXSECONDS];
+
+
+int main(int argc, char * argv[])
+{
+    struct slo s;
+    uint32_t minute = 1000, latest = 0;
+    uint32_t total1h, bad1h, total24h, bad24h;
+    int n = 0, i, sec, round, inminute = 0;
+    int errors = 0;
+
+    puts("test_slo");
+
+    slo_init(&s);
+    srandom(1);
+    for( sec=0; sec < MAXSECONDS; sec++){
+        round = random() % 1000;
+        if( round < 20 || ++ inminute >= 200){
+            minute ++;  /* about 50 seconds a minute, less than a full one */
+            inminute = 0;
+        } else if( 0 == round){
+            minute += random() % 200;  /* a gap of minutes or hours */
+        } else if( 1 == round && sec > MAXSECONDS / 2){
+            minute += 30 * 60;  /* half a day */
+        }
+        /* every 50th one is a late second, sometimes too late */
+        minutes[n] = (0 == sec % 50 && minute > 70) ? minute - random() % 70 : minute;
+        bads[n] = 0 == random() % 7;
+        latest = minutes[n] > latest ? minutes[n] : latest;
+        slo_add(&s, minutes[n], bads[n]);
+        if( latest - minutes[n] < SLO_MINUTES){
+            n ++;  /* counted */
+        }
+        if( 0 == sec % 997){
+            total1h = bad1h = total24h = bad24h = 0;
+            for( i=0; i < n; i++){
+                if( latest - minutes[i] < SLO_MINUTES){
+                    total1h ++;
+                    bad1h += bads[i];
+                }
+                if( latest / 60 - minutes[i] / 60 < SLO_HOURS){
+                    total24h ++;
+                    bad24h += bads[i];
+                }
+            }
+            if( total1h != s.total1h || bad1h != s.bad1h || total24h != s.total24h || bad24h != s.bad24h){
+                printf("Error: second %d: 1h %u/%u instead of %u/%u, 24h %u/%u instead of %u/%u\n", sec,
+                    s.bad1h, s.total1h, bad1h, total1h, s.bad24h, s.total24h, bad24h, total24h);
+                if( ++ errors > 10){
+                    return 2;
+                }
+            }
+        }
+    }
+    printf("1h: %u seconds %.3f%%, 24h: %u seconds %.3f%%\n", s.total1h, slo_compliance(s.total1h, s.bad1h),
+        s.total24h, slo_compliance(s.total24h, s.bad24h));
+
+    /* a full minute: the seconds over 255 are not counted */
+    slo_init(&s);
+    for( sec=0; sec < 300; sec++){
+        slo_add(&s, 5, sec < 100);
+    }
+    if( 255 != s.total1h || 100 != s.bad1h || 255 != s.total24h || 100 != s.bad24h){
+        printf("Error: full minute %u/%u %u/%u\n", s.bad1h, s.total1h, s.bad24h, s.total24h);
+        errors ++;
+    }
+    if( 100.0 != slo_compliance(0, 0) || 75.0 != slo_compliance(4, 1)){
+        puts("Error: wrong compliance");
+        errors ++;
+    }
+
+    if( errors){
+        return 2;
+    }
+    printf("Last line\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+/*
+** test_timerwheel.c
+**
+**  timerwheel functionality testing
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timerwheel.h"
+
+static struct timerwheel tw;
+static uint64_t * expected;  /* expected expiration tick, 0 if not armed */
+static int errors = 0;
+static unsigned long firedcount = 0;
+
+
+/* arm and remember when it should fire. Expired ones fire at the next tick. */
+void arm(size_t id, uint64_t expire)
+{
+    expected[id] = expire < tw.now ? tw.now : expire;
+    timerwheel_arm(&tw, id, expire);
+}
+
+
+void checker(size_t id, void * arg)
+{
+    uint64_t tick = tw.now - 1; /* the tick under processing */
+
+    if( 0 == expected[id]){
+        printf("Error: not armed timer fired id=%lu tick=%lu\n", id, tick);
+        errors ++;
+    } else if( expected[id] != tick){
+        printf("Error: timer fired at wrong time id=%lu expected=%lu tick=%lu\n", id, expected[id], tick);
+        errors ++;
+    }
+    expected[id] = 0;
+    firedcount ++;
+    if( 0 == random() % 4){  /* re-arm from the callback, like a periodic timer */
+        arm(id, tick + random() % 5000);
+    }
+}
+
+
+int main(int argc, char * argv[])
+{
+    int retval;
+    size_t size;
+    size_t i, id;
+    unsigned long steps;
+    uint64_t now;
+
+    if( argc != 3){
+        puts("Incorrect number of parameters. Usage:");
+        puts("  test_timerwheel  <timer_number> <steps>");
+        return 2;
+    }
+
+    size = atol(argv[1]);
+    steps = atol(argv[2]);
+    expected = (uint64_t *) calloc(size, sizeof(uint64_t));
+
+    printf("test_timerwheel %lu %lu\n", size, steps);
+    now = 1000003; /* not aligned to any level */
+    retval = timerwheel_init(&tw, size, now);
+    printf("init returns: %d\n", retval);
+
+    for( i=0; i < steps; i++){
+        /* some random arm, rearm and cancel */
+        id = random() % size;
+        switch( random() % 3){
+            case 0:
+                arm(id, now + random() % 300000); /* crosses levels 0,1,2 */
+                break;
+            case 1:
+                arm(id, now + random() % 64);
+                break;
+            default:
+                expected[id] = 0;
+                timerwheel_cancel(&tw, id);
+                break;
+        }
+        if( timerwheel_isarmed(&tw, id) != (0 != expected[id])){
+            printf("Error: isarmed mismatch id=%lu\n", id);
+            return 2;
+        }
+        now += random() % 100;
+        timerwheel_advance(&tw, now, &checker, NULL);
+        if( errors > 10){
+            return 2;
+        }
+    }
+
+    /* drain: every armed timer must fire */
+    timerwheel_advance(&tw, now + 400000, &checker, NULL);
+    for( id=0; id < size; id++){
+        if( 0 != expected[id] && expected[id] <= now + 400000){
+            printf("Error: timer did not fire id=%lu expected=%lu\n", id, expected[id]);
+            errors ++;
+        }
+    }
+    if( errors){
+        return 2;
+    }
+
+    printf("fired: %lu\n", firedcount);
+    printf("Last line\n");
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*
+** timerwheel.c
+**
+** hierarchical timer wheel implementations. See timerwheel.h
+**
+**  The cascading algorithm is the classic one (see the old Linux kernel timer.c):
+**  the level 0 slots hold the timers expiring within 64 ticks, with 1 tick resolution.
+**  When the level 0 index wraps around to 0, the next slot of level 1 is redistributed
+**  to the lower levels, and so on.
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <pthread.h>
+#include "timerwheel.h"
+
+#define TIMERWHEEL_WORKLIST (TIMERWHEEL_LEVELS * TIMERWHEEL_SLOTS)
+
+
+/* list primitives. Must be called under the lock */
+
+static inline void node_link(struct timerwheel * twp, int32_t id, int32_t slot)
+{
+    struct timerwheel_node * np = twp->nodes + id;
+
+    np->slot = slot;
+    np->prev = -1;
+    np->next = twp->heads[slot];
+    if( -1 != np->next){
+        twp->nodes[np->next].prev = id;
+    }
+    twp->heads[slot] = id;
+}
+
+static inline void node_unlink(struct timerwheel * twp, int32_t id)
+{
+    struct timerwheel_node * np = twp->nodes + id;
+
+    if( -1 == np->prev){
+        twp->heads[np->slot] = np->next;
+    } else {
+        twp->nodes[np->prev].next = np->next;
+    }
+    if( -1 != np->next){
+        twp->nodes[np->next].prev = np->prev;
+    }
+    np->slot = -1;
+    np->next = np->prev = -1;
+}
+
+
+/* put the node to the proper slot according to its expire and the current time */
+static void node_place(struct timerwheel * twp, int32_t id)
+{
+    struct timerwheel_node * np = twp->nodes + id;
+    uint64_t delta;
+    int level;
+
+    if( np->expire < twp->now){  /* already expired: process at the next tick */
+        node_link(twp, id, (int32_t)(twp->now & TIMERWHEEL_MASK));
+        return;
+    }
+    delta = np->expire - twp->now;
+    if( delta > TIMERWHEEL_MAXDELAY){
+        np->expire = twp->now + TIMERWHEEL_MAXDELAY;
+        delta = TIMERWHEEL_MAXDELAY;
+    }
+    for( level = 0; level < TIMERWHEEL_LEVELS - 1; level++){
+        if( delta < (1ull << ((level + 1) * TIMERWHEEL_BITS))){
+            break;
+        }
+    }
+    node_link(twp, id, (int32_t)(level * TIMERWHEEL_SLOTS +
+        ((np->expire >> (level * TIMERWHEEL_BITS)) & TIMERWHEEL_MASK)));
+}
+
+
+/* redistribute a slot of a higher level. Returns the slot index. */
+static int cascade(struct timerwheel * twp, int level, int index)
+{
+    int32_t id, next;
+    int32_t slot = level * TIMERWHEEL_SLOTS + index;
+
+    id = twp->heads[slot];
+    twp->heads[slot] = -1;
+    while( -1 != id){
+        next = twp->nodes[id].next;
+        node_place(twp, id);
+        id = next;
+    }
+    return index;
+}
+
+
+int timerwheel_init(struct timerwheel * twp, size_t size, uint64_t now)
+{
+    return timerwheel_init_growable(twp, size, size, now);
+}
+
+
+int timerwheel_init_growable(struct timerwheel * twp, size_t size, size_t maxsize, uint64_t now)
+{
+    size_t i;
+
+    if( maxsize > INT32_MAX || size > maxsize){
+        return -1;
+    }
+    twp->size = 0;
+    twp->now = now;
+    if( 0 != arena_init(&(twp->nodearena), maxsize * sizeof(struct timerwheel_node))){
+        return -1;
+    }
+    twp->nodes = (struct timerwheel_node *) twp->nodearena.base;
+    for( i=0; i <= TIMERWHEEL_WORKLIST; i++){
+        twp->heads[i] = -1;
+    }
+    pthread_mutex_init(&(twp->mutex), 0);
+    return timerwheel_grow(twp, size);
+}
+
+
+int timerwheel_grow(struct timerwheel * twp, size_t newsize)
+{
+    size_t i;
+
+    pthread_mutex_lock(&(twp->mutex));
+    if( newsize <= twp->size){
+        pthread_mutex_unlock(&(twp->mutex));
+        return 0;
+    }
+    if( 0 != arena_commit(&(twp->nodearena), newsize * sizeof(struct timerwheel_node))){
+        pthread_mutex_unlock(&(twp->mutex));
+        return -1;
+    }
+    for( i=twp->size; i < newsize; i++){
+        twp->nodes[i] = (struct timerwheel_node) {-1, -1, -1, 0};
+    }
+    twp->size = newsize;
+    pthread_mutex_unlock(&(twp->mutex));
+    return 0;
+}
+
+
+int timerwheel_free(struct timerwheel * twp)
+{
+    twp->size = 0;
+    arena_free(&(twp->nodearena));
+    twp->nodes = NULL;
+    pthread_mutex_destroy(&(twp->mutex));
+    return 0;
+}
+
+
+int timerwheel_arm(struct timerwheel * twp, size_t id, uint64_t expire)
+{
+    if( id >= twp->size){
+        return -1;
+    }
+    pthread_mutex_lock(&(twp->mutex));
+    if( -1 != twp->nodes[id].slot){
+        node_unlink(twp, (int32_t) id);
+    }
+    twp->nodes[id].expire = expire;
+    node_place(twp, (int32_t) id);
+    pthread_mutex_unlock(&(twp->mutex));
+    return 0;
+}
+
+
+int timerwheel_cancel(struct timerwheel * twp, size_t id)
+{
+    if( id >= twp->size){
+        return -1;
+    }
+    pthread_mutex_lock(&(twp->mutex));
+    if( -1 != twp->nodes[id].slot){
+        node_unlink(twp, (int32_t) id);
+    }
+    pthread_mutex_unlock(&(twp->mutex));
+    return 0;
+}
+
+
+int timerwheel_isarmed(struct timerwheel * twp, size_t id)
+{
+    int retval;
+
+    if( id >= twp->size){
+        return 0;
+    }
+    pthread_mutex_lock(&(twp->mutex));
+    retval = (-1 != twp->nodes[id].slot);
+    pthread_mutex_unlock(&(twp->mutex));
+    return retval;
+}
+
+
+int timerwheel_advance(struct timerwheel * twp, uint64_t now, void (*callback)(size_t id, void * arg), void * arg)
+{
+    int fired = 0;
+    int index;
+    int level;
+    int32_t id;
+
+    pthread_mutex_lock(&(twp->mutex));
+    while( twp->now <= now){
+        index = (int)(twp->now & TIMERWHEEL_MASK);
+        for( level = 1; 0 == index && level < TIMERWHEEL_LEVELS; level++){
+            index = cascade(twp, level, (int)((twp->now >> (level * TIMERWHEEL_BITS)) & TIMERWHEEL_MASK));
+        }
+        index = (int)(twp->now & TIMERWHEEL_MASK);
+        /* move the expired slot to the work list */
+        twp->heads[TIMERWHEEL_WORKLIST] = twp->heads[index];
+        twp->heads[index] = -1;
+        for( id = twp->heads[TIMERWHEEL_WORKLIST]; -1 != id; id = twp->nodes[id].next){
+            twp->nodes[id].slot = TIMERWHEEL_WORKLIST;
+        }
+        twp->now ++;
+        /* the callback may arm or cancel any timer (even the ones in the work list) */
+        while( -1 != (id = twp->heads[TIMERWHEEL_WORKLIST])){
+            node_unlink(twp, id);
+            pthread_mutex_unlock(&(twp->mutex));
+            callback((size_t) id, arg);
+            fired ++;
+            pthread_mutex_lock(&(twp->mutex));
+        }
+    }
+    pthread_mutex_unlock(&(twp->mutex));
+    return fired;
+}
@@ -0,0 +1,96 @@
+/*
+** timerwheel.h
+**
+** hierarchical timer wheel structure definitions
+**
+**  A fixed set of timers, each identified by a small integer ID (0 <= ID < size).
+**  A timer is armed with an absolute expiration time measured in ticks.
+**  The caller defines the length of a tick (the server uses 100 msec).
+**  Arming, re-arming and cancelling are O(1). Advancing the wheel costs
+**  O(expired timers) plus an amortized cascade, independent of the number of timers.
+**
+**  4 levels x 64 slots. Level 0 has 1 tick resolution, level N has 64**N ticks.
+**  The maximal delay is 64**4-1 ticks (at 100 msec tick: ~19 days). Longer delays are truncated.
+**
+** multithread safe (internal mutex). The callback is called without holding the mutex,
+** so the callback may arm/cancel any timer.
+**
+**  functions:
+**      - init     the constructor
+**      - init_growable  the constructor of a wheel that can grow up to maxsize timers
+**      - grow     add new (disarmed) timers. The IDs of the existing ones do not change.
+**      - free     the destructor
+**      - arm      (re)arm a timer with an absolute expiration tick.
+**      - cancel   disarm a timer. No error if not armed.
+**      - isarmed  returns 1 if the timer is armed (waiting for expiration)
+**      - advance  move the wheel to the given tick and call the callback for every expired timer.
+**                 An expired timer is disarmed before its callback is called.
+**  attributes:
+**      - size      number of timers
+**      - now       the next tick to be processed
+**
+**
+** Copyright by Adam Maulis maulis@andrews.hu 2025
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __TIMERWHEEL_H
+#define __TIMERWHEEL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "arena.h"
+
+#define TIMERWHEEL_LEVELS 4
+#define TIMERWHEEL_BITS 6
+#define TIMERWHEEL_SLOTS (1 << TIMERWHEEL_BITS)
+#define TIMERWHEEL_MASK (TIMERWHEEL_SLOTS - 1)
+#define TIMERWHEEL_MAXDELAY ((1ull << (TIMERWHEEL_LEVELS * TIMERWHEEL_BITS)) - 1)
+
+/*
+**  nodes are linked into the slot lists by index (doubly linked, -1 terminated)
+**  node.slot is the index of the list head in 'heads'. -1 if the timer is not armed.
+**  the last list head (index TIMERWHEEL_LEVELS*TIMERWHEEL_SLOTS) is the work list of advance()
+*/
+
+struct timerwheel_node {
+    int32_t next;
+    int32_t prev;
+    int32_t slot;
+    uint64_t expire;
+};
+
+struct timerwheel {
+    size_t size;
+    uint64_t now;
+    struct timerwheel_node * nodes;
+    struct arena nodearena;
+    int32_t heads[TIMERWHEEL_LEVELS * TIMERWHEEL_SLOTS + 1];
+    pthread_mutex_t mutex;
+};
+
+
+int timerwheel_init(struct timerwheel * twp, size_t size, uint64_t now);
+int timerwheel_init_growable(struct timerwheel * twp, size_t size, size_t maxsize, uint64_t now);
+int timerwheel_grow(struct timerwheel * twp, size_t newsize);
+int timerwheel_free(struct timerwheel * twp);
+int timerwheel_arm(struct timerwheel * twp, size_t id, uint64_t expire);
+int timerwheel_cancel(struct timerwheel * twp, size_t id);
+int timerwheel_isarmed(struct timerwheel * twp, size_t id);
+int timerwheel_advance(struct timerwheel * twp, uint64_t now, void (*callback)(size_t id, void * arg), void * arg);
+
+#endif /* __TIMERWHEEL_H */